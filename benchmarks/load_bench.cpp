@@ -0,0 +1,659 @@
+/*
+ * load_bench.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ *
+ * End-to-end load benchmark: a static file server on loopback driven by an
+ * in-process keep-alive load generator. Results are written as JSON so
+ * that runs of different releases can be diffed.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/asio/use_future.hpp>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+#include <webdonkey/contextual.hpp>
+#include <webdonkey/defs.hpp>
+#include <webdonkey/http.hpp>
+#include <webdonkey/metrics.hpp>
+#include <webdonkey/sharded_listener.hpp>
+#include <webdonkey/static_responder.hpp>
+#include <webdonkey/tcp_listener.hpp>
+#include <webdonkey/tls.hpp>
+
+using namespace webdonkey;
+
+using clock_type = std::chrono::steady_clock;
+using thread_pool = asio::thread_pool;
+
+struct bench_context {};
+
+struct bench_options {
+	std::chrono::seconds duration{5};
+	std::chrono::seconds warmup{1};
+	std::size_t connections = 32;
+	std::size_t client_threads =
+		std::max(1u, std::thread::hardware_concurrency() / 2);
+	std::size_t server_threads =
+		std::max(1u, std::thread::hardware_concurrency() / 2);
+	std::size_t small_size = 1024;
+	std::size_t large_size = 1024 * 1024;
+	std::vector<std::string> only;
+	std::string output;
+
+	// Kernel TLS on the server, TLS 1.2 with AES-GCM on the clients
+	bool kernel_tls = false;
+};
+
+struct scenario {
+	std::string name;
+	std::string target;
+	bool tls = false;
+
+	// One request per connection if false
+	bool keep_alive = true;
+
+	// Requests written back to back before reading the responses
+	std::size_t pipeline = 1;
+
+	// Offer the session of the previous connection
+	bool resume = false;
+
+	// Served by sharded_listener rather than tcp_listener
+	bool sharded = false;
+};
+
+const std::vector<scenario> scenarios = {
+	{"http_small_keepalive", "/small.bin"},
+	{"http_small_pipelined", "/small.bin", false, true, 16},
+	{"http_large_keepalive", "/large.bin"},
+	{"http_small_new_connection", "/small.bin", false, false},
+	{"https_small_keepalive", "/small.bin", true},
+	{"https_large_keepalive", "/large.bin", true},
+	{"https_full_handshake", "/small.bin", true, false, 1, false},
+	{"https_resumed_handshake", "/small.bin", true, false, 1, true},
+	{"http_small_keepalive_sharded", "/small.bin", false, true, 1, false,
+	 true},
+	{"http_small_new_connection_sharded", "/small.bin", false, false, 1, false,
+	 true},
+};
+
+/**
+ * Counts of a single client connection loop; only its own coroutine
+ * writes to it.
+ */
+struct worker_stats {
+	latency_histogram latency;
+	std::uint64_t requests = 0;
+	std::uint64_t bytes = 0;
+	std::uint64_t errors = 0;
+	std::uint64_t connections = 0;
+	std::uint64_t resumed = 0;
+	SSL_SESSION *session = nullptr;
+
+	~worker_stats() {
+		if (session != nullptr)
+			SSL_SESSION_free(session);
+	}
+};
+
+struct run_window {
+	tcp::endpoint endpoint;
+	ssl::context *tls = nullptr;
+	clock_type::time_point measure_from;
+	clock_type::time_point stop_at;
+};
+
+//==============================================================================
+
+/**
+ * Self-signed P-256 certificate, so that the benchmark needs no files.
+ */
+void use_generated_certificate(ssl::context &ctx) {
+	EVP_PKEY *key = EVP_EC_gen("P-256");
+	X509 *cert = X509_new();
+	if ((key == nullptr) || (cert == nullptr))
+		throw std::runtime_error{"Failed to generate a certificate."};
+
+	X509_set_version(cert, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+	X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+	X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 60 * 60);
+	X509_set_pubkey(cert, key);
+
+	X509_NAME *name = X509_get_subject_name(cert);
+	X509_NAME_add_entry_by_txt(
+		name, "CN", MBSTRING_ASC,
+		reinterpret_cast<const unsigned char *>("localhost"), -1, -1, 0);
+	X509_set_issuer_name(cert, name);
+	X509_sign(cert, key, EVP_sha256());
+
+	const bool loaded =
+		(SSL_CTX_use_certificate(ctx.native_handle(), cert) == 1) &&
+		(SSL_CTX_use_PrivateKey(ctx.native_handle(), key) == 1);
+	X509_free(cert);
+	EVP_PKEY_free(key);
+
+	if (!loaded)
+		throw std::runtime_error{"Failed to load the certificate."};
+}
+
+void write_file(const std::filesystem::path &path, std::size_t size) {
+	std::string content(size, '\0');
+	for (std::size_t i = 0; i < size; ++i)
+		content[i] = static_cast<char>('a' + i % 26);
+
+	std::ofstream{path, std::ios::binary}.write(content.data(),
+												 content.size());
+}
+
+//==============================================================================
+
+/*
+ * Writes a batch of requests and reads their responses. Latency runs from
+ * started, or from the write if started is unset.
+ */
+template <class stream_type>
+awaitable<void> exchange(stream_type &stream, beast::flat_buffer &buffer,
+						 const std::string &requests, std::size_t count,
+						 const run_window &window, worker_stats &stats,
+						 std::optional<clock_type::time_point> started = {}) {
+	const clock_type::time_point sent = started.value_or(clock_type::now());
+	co_await asio::async_write(stream, asio::buffer(requests),
+							   asio::use_awaitable);
+
+	char scratch[64 * 1024];
+	for (std::size_t i = 0; i < count; ++i) {
+		beast::http::response_parser<beast::http::buffer_body> parser;
+		parser.body_limit(std::numeric_limits<std::uint64_t>::max());
+		co_await beast::http::async_read_header(stream, buffer, parser,
+												asio::use_awaitable);
+
+		std::uint64_t body_size = 0;
+		while (!parser.is_done()) {
+			parser.get().body().data = scratch;
+			parser.get().body().size = sizeof(scratch);
+
+			beast::error_code ec;
+			co_await beast::http::async_read(
+				stream, buffer, parser,
+				asio::redirect_error(asio::use_awaitable, ec));
+			if (ec && (ec != beast::http::error::need_buffer))
+				throw boost::system::system_error{ec};
+
+			body_size += sizeof(scratch) - parser.get().body().size;
+		}
+
+		const clock_type::time_point done = clock_type::now();
+		if ((sent < window.measure_from) || (done > window.stop_at))
+			continue;
+
+		if (parser.get().result() != beast::http::status::ok) {
+			++stats.errors;
+			continue;
+		}
+
+		stats.latency.record(done - sent);
+		++stats.requests;
+		stats.bytes += body_size;
+	}
+}
+
+template <class stream_type>
+awaitable<void> converse(stream_type &stream, const scenario &sc,
+						 const run_window &window, worker_stats &stats,
+						 clock_type::time_point connected) {
+	beast::flat_buffer buffer;
+	if (!sc.keep_alive) {
+		const std::string request = "GET " + sc.target +
+									" HTTP/1.1\r\n"
+									"Host: localhost\r\n"
+									"Connection: close\r\n\r\n";
+		co_await exchange(stream, buffer, request, 1, window, stats,
+						  connected);
+		co_return;
+	}
+
+	std::string requests;
+	for (std::size_t i = 0; i < sc.pipeline; ++i)
+		requests += "GET " + sc.target +
+					" HTTP/1.1\r\n"
+					"Host: localhost\r\n\r\n";
+
+	while (clock_type::now() < window.stop_at)
+		co_await exchange(stream, buffer, requests, sc.pipeline, window, stats);
+}
+
+/*
+ * Resets rather than closes, so that new connection scenarios do not run
+ * out of ports to TIME_WAIT.
+ */
+void abort_connection(tcp::socket &socket) {
+	beast::error_code ec;
+	socket.set_option(asio::socket_base::linger(true, 0), ec);
+	socket.close(ec);
+}
+
+awaitable<void> run_worker(const scenario &sc, const run_window &window,
+						   worker_stats &stats) {
+	auto executor = co_await asio::this_coro::executor;
+	while (clock_type::now() < window.stop_at) {
+		const clock_type::time_point connected = clock_type::now();
+		tcp_stream tcp{executor};
+		try {
+			co_await tcp.async_connect(window.endpoint, asio::use_awaitable);
+			tcp.socket().set_option(tcp::no_delay(true));
+
+			if (!sc.tls) {
+				co_await converse(tcp, sc, window, stats, connected);
+				abort_connection(tcp.socket());
+				++stats.connections;
+				continue;
+			}
+
+			ssl_stream stream{std::move(tcp), *window.tls};
+			if (sc.resume && (stats.session != nullptr))
+				SSL_set_session(stream.native_handle(), stats.session);
+
+			co_await stream.async_handshake(ssl::stream_base::client,
+											asio::use_awaitable);
+			if (SSL_session_reused(stream.native_handle()))
+				++stats.resumed;
+
+			co_await converse(stream, sc, window, stats, connected);
+
+			/*
+			 * TLS 1.3 tickets arrive after the handshake. Sessions of
+			 * connections freed without a close_notify are not resumable.
+			 */
+			SSL_set_shutdown(stream.native_handle(),
+							 SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+			if (sc.resume) {
+				SSL_SESSION *session = SSL_get1_session(stream.native_handle());
+				if (stats.session != nullptr)
+					SSL_SESSION_free(stats.session);
+				stats.session = session;
+			}
+
+			abort_connection(beast::get_lowest_layer(stream).socket());
+			++stats.connections;
+		} catch (std::exception &) {
+			++stats.errors;
+		}
+	}
+}
+
+//==============================================================================
+
+struct scenario_result {
+	std::uint64_t requests = 0;
+	std::uint64_t bytes = 0;
+	std::uint64_t errors = 0;
+	std::uint64_t connections = 0;
+	std::uint64_t resumed = 0;
+	std::uint64_t served_tls = 0;
+	std::uint64_t offloaded = 0;
+	std::vector<std::uint64_t> buckets;
+	std::uint64_t sum_ns = 0;
+};
+
+scenario_result run_scenario(const scenario &sc, const bench_options &options,
+							 const tcp::endpoint &endpoint,
+							 ssl::context &client_tls) {
+	thread_pool clients{options.client_threads};
+
+	run_window window;
+	window.endpoint = endpoint;
+	window.tls = &client_tls;
+	window.measure_from = clock_type::now() + options.warmup;
+	window.stop_at = window.measure_from + options.duration;
+
+	std::vector<std::unique_ptr<worker_stats>> stats;
+	std::vector<std::future<void>> done;
+	for (std::size_t i = 0; i < options.connections; ++i) {
+		stats.push_back(std::make_unique<worker_stats>());
+		done.push_back(asio::co_spawn(asio::make_strand(clients),
+									  run_worker(sc, window, *stats.back()),
+									  asio::use_future));
+	}
+
+	for (std::future<void> &worker : done)
+		worker.get();
+
+	clients.join();
+
+	scenario_result result;
+	result.buckets.assign(latency_histogram::bucket_count, 0);
+	for (const std::unique_ptr<worker_stats> &worker : stats) {
+		result.requests += worker->requests;
+		result.bytes += worker->bytes;
+		result.errors += worker->errors;
+		result.connections += worker->connections;
+		result.resumed += worker->resumed;
+		worker->latency.merge_into(result.buckets, result.sum_ns);
+	}
+
+	return result;
+}
+
+std::string to_json(const scenario &sc, const scenario_result &result,
+					const bench_options &options) {
+	const double seconds = static_cast<double>(options.duration.count());
+	std::uint64_t max_us = 0;
+	for (std::size_t b = result.buckets.size(); b > 0; --b)
+		if (result.buckets[b - 1] > 0) {
+			max_us = latency_histogram::bucket_limit(b - 1);
+			break;
+		}
+
+	const double mean_us =
+		(result.requests > 0)
+			? static_cast<double>(result.sum_ns) / 1e3 /
+				  static_cast<double>(result.requests)
+			: 0.0;
+
+	char json[1024];
+	std::snprintf(
+		json, sizeof(json),
+		"    {\n"
+		"      \"name\": \"%s\",\n"
+		"      \"target\": \"%s\",\n"
+		"      \"tls\": %s,\n"
+		"      \"keep_alive\": %s,\n"
+		"      \"pipeline\": %zu,\n"
+		"      \"sharded\": %s,\n"
+		"      \"requests\": %llu,\n"
+		"      \"errors\": %llu,\n"
+		"      \"connections\": %llu,\n"
+		"      \"resumed_connections\": %llu,\n"
+		"      \"server_tls_connections\": %llu,\n"
+		"      \"offloaded_connections\": %llu,\n"
+		"      \"seconds\": %.3f,\n"
+		"      \"requests_per_second\": %.1f,\n"
+		"      \"bytes_per_second\": %.1f,\n"
+		"      \"latency_us\": {\"mean\": %.1f, \"p50\": %llu, \"p90\": %llu, "
+		"\"p99\": %llu, \"p999\": %llu, \"max\": %llu}\n"
+		"    }",
+		sc.name.c_str(), sc.target.c_str(), sc.tls ? "true" : "false",
+		sc.keep_alive ? "true" : "false", sc.pipeline,
+		sc.sharded ? "true" : "false",
+		static_cast<unsigned long long>(result.requests),
+		static_cast<unsigned long long>(result.errors),
+		static_cast<unsigned long long>(result.connections),
+		static_cast<unsigned long long>(result.resumed),
+		static_cast<unsigned long long>(result.served_tls),
+		static_cast<unsigned long long>(result.offloaded), seconds,
+		static_cast<double>(result.requests) / seconds,
+		static_cast<double>(result.bytes) / seconds, mean_us,
+		static_cast<unsigned long long>(
+			latency_histogram::quantile(result.buckets, 0.5)),
+		static_cast<unsigned long long>(
+			latency_histogram::quantile(result.buckets, 0.9)),
+		static_cast<unsigned long long>(
+			latency_histogram::quantile(result.buckets, 0.99)),
+		static_cast<unsigned long long>(
+			latency_histogram::quantile(result.buckets, 0.999)),
+		static_cast<unsigned long long>(max_us));
+	return json;
+}
+
+//==============================================================================
+
+void usage() {
+	std::cerr
+		<< "Usage: load_bench [options]" << std::endl
+		<< "    --duration <seconds>     measured time per scenario (5)"
+		<< std::endl
+		<< "    --warmup <seconds>       unmeasured time per scenario (1)"
+		<< std::endl
+		<< "    --connections <n>        concurrent client connections (32)"
+		<< std::endl
+		<< "    --client-threads <n>     load generator threads" << std::endl
+		<< "    --server-threads <n>     server threads" << std::endl
+		<< "    --scenario <name>        run only this scenario, repeatable"
+		<< std::endl
+		<< "    --output <file>          JSON report, standard output if unset"
+		<< std::endl
+		<< "    --ktls                   offload TLS transmission to the kernel"
+		<< std::endl
+		<< "    --list                   list scenarios" << std::endl;
+}
+
+bool parse_options(int argc, char **argv, bench_options &options) {
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg{argv[i]};
+		if (arg == "--list") {
+			for (const scenario &sc : scenarios)
+				std::cout << sc.name << std::endl;
+			std::exit(EXIT_SUCCESS);
+		}
+
+		if (arg == "--ktls") {
+			options.kernel_tls = true;
+			continue;
+		}
+
+		if (i + 1 == argc)
+			return false;
+
+		std::string value{argv[++i]};
+		if (arg == "--duration")
+			options.duration = std::chrono::seconds{std::stoul(value)};
+		else if (arg == "--warmup")
+			options.warmup = std::chrono::seconds{std::stoul(value)};
+		else if (arg == "--connections")
+			options.connections = std::stoul(value);
+		else if (arg == "--client-threads")
+			options.client_threads = std::stoul(value);
+		else if (arg == "--server-threads")
+			options.server_threads = std::stoul(value);
+		else if (arg == "--scenario")
+			options.only.push_back(value);
+		else if (arg == "--output")
+			options.output = value;
+		else
+			return false;
+	}
+
+	return (options.duration.count() > 0) && (options.connections > 0) &&
+		   (options.client_threads > 0) && (options.server_threads > 0);
+}
+
+int main(int argc, char **argv) {
+	bench_options options;
+	try {
+		if (!parse_options(argc, argv, options)) {
+			usage();
+			return EXIT_FAILURE;
+		}
+	} catch (std::exception &) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if (options.kernel_tls && !kernel_tls_built) {
+		std::cerr << "Kernel TLS is not built in, configure with "
+					 "-DWEBDONKEY_KERNEL_TLS=ON"
+				  << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const std::filesystem::path doc_root =
+		std::filesystem::temp_directory_path() /
+		("webdonkey-bench-" + std::to_string(::getpid()));
+	std::filesystem::create_directories(doc_root);
+	write_file(doc_root / "small.bin", options.small_size);
+	write_file(doc_root / "large.bin", options.large_size);
+
+	shared_object<bench_context, thread_pool> server_pool{
+		std::make_shared<thread_pool>(options.server_threads)};
+
+	ssl::context server_tls{ssl::context::tls_server};
+	use_generated_certificate(server_tls);
+	enable_session_resumption(server_tls);
+
+	ssl::context client_tls{ssl::context::tls_client};
+	client_tls.set_verify_mode(ssl::verify_none);
+
+	// Only TLS 1.2 with AES-GCM can be offloaded
+	if (options.kernel_tls) {
+		enable_kernel_tls(server_tls);
+		client_tls.set_options(ssl::context::no_tlsv1_3);
+		SSL_CTX_set_cipher_list(client_tls.native_handle(),
+								"ECDHE-ECDSA-AES128-GCM-SHA256:"
+								"ECDHE-ECDSA-AES256-GCM-SHA384");
+	}
+
+	/*
+	 * TLS connections served, counted at their first request, and those
+	 * among them which the kernel encrypts for.
+	 */
+	std::atomic<std::uint64_t> served_tls = 0;
+	std::atomic<std::uint64_t> offloaded = 0;
+	const int counted_index =
+		SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+	auto count_connection = [&](ssl_stream &stream) {
+		SSL *ssl = stream.native_handle();
+		if (SSL_get_ex_data(ssl, counted_index) != nullptr)
+			return;
+
+		SSL_set_ex_data(ssl, counted_index, &served_tls);
+		++served_tls;
+		if (kernel_tls(stream))
+			++offloaded;
+	};
+
+	static_responder_options static_options;
+	static_options.cache = std::make_shared<file_cache>();
+	static_responder serve_static{doc_root, "index.html", "webdonkey bench",
+								  static_options};
+
+	auto server = [&](auto &ctx) -> awaitable<http_response> {
+		if constexpr (std::is_same_v<std::remove_reference_t<
+										 decltype(ctx.stream())>,
+									 ssl_stream>)
+			count_connection(ctx.stream());
+
+		expected_response response_or = serve_static(ctx, ctx.target());
+		if (response_or.has_value())
+			co_return std::move(response_or.value());
+
+		beast::http::response<beast::http::empty_body> res{
+			response_or.error().status, ctx.request().version()};
+		res.keep_alive(ctx.request().keep_alive());
+		res.prepare_payload();
+		co_return std::move(res);
+	};
+
+	const tcp::endpoint loopback{asio::ip::make_address("127.0.0.1"), 0};
+
+	tcp_listener<bench_context, thread_pool> http_listener{
+		loopback, [&](tcp::socket &socket) -> awaitable<void> {
+			try {
+				co_await http(socket, server);
+			} catch (std::exception &) {
+				// Clients reset connections when done
+			}
+		}};
+
+	tcp_listener<bench_context, thread_pool> https_listener{
+		loopback, [&](tcp::socket &socket) -> awaitable<void> {
+			try {
+				co_await https(socket, server_tls, server);
+			} catch (std::exception &) {
+			}
+		}};
+
+	// As many shards as server threads, for comparison with http_listener
+	sharded_listener sharded_http_listener{
+		loopback,
+		[&](tcp::socket &socket) -> awaitable<void> {
+			try {
+				co_await http(socket, server);
+			} catch (std::exception &) {
+			}
+		},
+		options.server_threads};
+
+	std::string report = "{\n  \"benchmark\": \"webdonkey_load\",\n";
+	char config[512];
+	std::snprintf(config, sizeof(config),
+				  "  \"config\": {\"duration_s\": %lld, \"warmup_s\": %lld, "
+				  "\"connections\": %zu, \"client_threads\": %zu, "
+				  "\"server_threads\": %zu, \"small_size\": %zu, "
+				  "\"large_size\": %zu, \"kernel_tls\": %s},\n",
+				  static_cast<long long>(options.duration.count()),
+				  static_cast<long long>(options.warmup.count()),
+				  options.connections, options.client_threads,
+				  options.server_threads, options.small_size,
+				  options.large_size, options.kernel_tls ? "true" : "false");
+	report += config;
+	report += "  \"scenarios\": [\n";
+
+	bool first = true;
+	for (const scenario &sc : scenarios) {
+		if (!options.only.empty() &&
+			(std::find(options.only.begin(), options.only.end(), sc.name) ==
+			 options.only.end()))
+			continue;
+
+		std::cerr << "Running " << sc.name << std::endl;
+		tcp::endpoint endpoint = http_listener.local_endpoint();
+		if (sc.tls)
+			endpoint = https_listener.local_endpoint();
+		else if (sc.sharded)
+			endpoint = sharded_http_listener.local_endpoint();
+		const std::uint64_t served_before = served_tls;
+		const std::uint64_t offloaded_before = offloaded;
+		scenario_result result =
+			run_scenario(sc, options, endpoint, client_tls);
+		result.served_tls = served_tls - served_before;
+		result.offloaded = offloaded - offloaded_before;
+
+		if (!first)
+			report += ",\n";
+		report += to_json(sc, result, options);
+		first = false;
+
+		// Let the server notice the resets before the next scenario
+		std::this_thread::sleep_for(std::chrono::milliseconds{200});
+	}
+
+	report += "\n  ]\n}\n";
+
+	if (options.output.empty())
+		std::cout << report;
+	else
+		std::ofstream{options.output} << report;
+
+	http_listener.stop();
+	https_listener.stop();
+	sharded_http_listener.stop();
+	sharded_http_listener.join();
+	server_pool->stop();
+	server_pool->join();
+
+	std::error_code ec;
+	std::filesystem::remove_all(doc_root, ec);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,521 @@
+/*
+ * micro_bench.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ *
+ * Microbenchmarks of helpers run once or more per request: context
+ * resolution, routing and MIME type lookup, and of whole requests on a
+ * keep-alive connection. Besides time per operation, every benchmark
+ * reports heap allocations per operation.
+ *
+ * --save-baseline=<file> records the results; --baseline=<file> compares
+ * against recorded results and fails if any benchmark got slower by more
+ * than --max-regression (a fraction, 0.1 by default) or allocates more.
+ */
+
+#include <array>
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <webdonkey/contextual.hpp>
+#include <webdonkey/http.hpp>
+#include <webdonkey/router.hpp>
+#include <webdonkey/utils.hpp>
+
+//==============================================================================
+// Allocation counting
+
+namespace {
+
+// Per thread, so that threads of a benchmark count only their own
+thread_local std::uint64_t allocations = 0;
+
+} // namespace
+
+void *operator new(std::size_t size) {
+	++allocations;
+	if (void *p = std::malloc(size == 0 ? 1 : size))
+		return p;
+
+	throw std::bad_alloc{};
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete[](void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+using namespace webdonkey;
+
+namespace {
+
+/*
+ * Counts allocations of the calling thread from construction on. Counters
+ * of all threads of a benchmark are summed up and divided by the total
+ * number of iterations.
+ */
+class allocation_counter {
+public:
+	explicit allocation_counter(benchmark::State &state) :
+		_state{state}, _start{allocations} {}
+
+	~allocation_counter() {
+		_state.counters["allocs/op"] =
+			benchmark::Counter(static_cast<double>(allocations - _start),
+							   benchmark::Counter::kAvgIterations);
+	}
+
+private:
+	benchmark::State &_state;
+	std::uint64_t _start;
+};
+
+struct bench_context {};
+
+struct resolved_service {
+	int value = 42;
+};
+
+shared_object<bench_context, resolved_service> service{
+	std::make_shared<resolved_service>()};
+
+//==============================================================================
+// contextual.hpp
+
+void registry_instance(benchmark::State &state) {
+	allocation_counter counter{state};
+	for (auto _ : state) {
+		managed_ptr<bench_context, resolved_service> ptr =
+			shared_registry<bench_context>::shared()
+				.instance<resolved_service>();
+		benchmark::DoNotOptimize(ptr);
+	}
+}
+
+BENCHMARK(registry_instance)->ThreadRange(1, 8)->UseRealTime();
+
+// Lazy resolution on first use, as in every new listener or connection
+void managed_ptr_lazy(benchmark::State &state) {
+	allocation_counter counter{state};
+	for (auto _ : state) {
+		managed_ptr<bench_context, resolved_service> ptr;
+		benchmark::DoNotOptimize(ptr.get());
+	}
+}
+
+BENCHMARK(managed_ptr_lazy)->ThreadRange(1, 8)->UseRealTime();
+
+void managed_ptr_get_shared(benchmark::State &state) {
+	managed_ptr<bench_context, resolved_service> ptr;
+	ptr.get();
+
+	allocation_counter counter{state};
+	for (auto _ : state)
+		benchmark::DoNotOptimize(ptr->value);
+}
+
+BENCHMARK(managed_ptr_get_shared)->ThreadRange(1, 8)->UseRealTime();
+
+void managed_ptr_get_local(benchmark::State &state) {
+	managed_ptr<bench_context, resolved_service> ptr{
+		std::make_shared<resolved_service>()};
+
+	allocation_counter counter{state};
+	for (auto _ : state)
+		benchmark::DoNotOptimize(ptr->value);
+}
+
+BENCHMARK(managed_ptr_get_local);
+
+void managed_ptr_pinned(benchmark::State &state) {
+	managed_ptr<bench_context, resolved_service> ptr;
+	pinned_ptr<resolved_service> pinned = ptr.pin();
+
+	allocation_counter counter{state};
+	for (auto _ : state)
+		benchmark::DoNotOptimize(pinned->value);
+}
+
+BENCHMARK(managed_ptr_pinned)->ThreadRange(1, 8)->UseRealTime();
+
+//==============================================================================
+// Routing
+
+const std::regex static_prefix{"^/static/"};
+
+void prefix_matching_hit(benchmark::State &state) {
+	allocation_counter counter{state};
+	for (auto _ : state)
+		benchmark::DoNotOptimize(
+			prefix_matching("/static/css/site.css", static_prefix));
+}
+
+BENCHMARK(prefix_matching_hit);
+
+void prefix_matching_miss(benchmark::State &state) {
+	allocation_counter counter{state};
+	for (auto _ : state)
+		benchmark::DoNotOptimize(
+			prefix_matching("/api/v1/users/17", static_prefix));
+}
+
+BENCHMARK(prefix_matching_miss);
+
+/*
+ * Responders are invoked with a context of an unconnected stream; the
+ * upstream responders here do not touch it.
+ */
+struct routing_fixture {
+	asio::io_context io;
+	tcp_stream stream{io};
+	request_context<tcp_stream> ctx{stream};
+
+	static expected_response empty(request_context<tcp_stream> &,
+								   std::string_view) {
+		return http_response{};
+	}
+};
+
+void route_regex(benchmark::State &state) {
+	routing_fixture fixture;
+	auto routed = route<tcp_stream>(static_prefix, &routing_fixture::empty);
+
+	allocation_counter counter{state};
+	for (auto _ : state)
+		benchmark::DoNotOptimize(routed(fixture.ctx, "/static/css/site.css"));
+}
+
+BENCHMARK(route_regex);
+
+void route_literal(benchmark::State &state) {
+	routing_fixture fixture;
+	auto routed = route("/static/", &routing_fixture::empty);
+
+	allocation_counter counter{state};
+	for (auto _ : state)
+		benchmark::DoNotOptimize(routed(fixture.ctx, "/static/css/site.css"));
+}
+
+BENCHMARK(route_literal);
+
+void route_chain(benchmark::State &state) {
+	routing_fixture fixture;
+	auto routed = route("/api/", &routing_fixture::empty) |
+				  route("/assets/", &routing_fixture::empty) |
+				  route("/static/", &routing_fixture::empty);
+
+	allocation_counter counter{state};
+	for (auto _ : state)
+		benchmark::DoNotOptimize(routed(fixture.ctx, "/static/css/site.css"));
+}
+
+BENCHMARK(route_chain);
+
+void router_lookup(benchmark::State &state) {
+	routing_fixture fixture;
+	router<tcp_stream> routes;
+	routes.add("/api/users/{id}", &routing_fixture::empty);
+	routes.add("/api/orders/{id}/items", &routing_fixture::empty);
+	routes.add("/assets/*", &routing_fixture::empty);
+	routes.add("/static/*", &routing_fixture::empty);
+
+	allocation_counter counter{state};
+	for (auto _ : state) {
+		fixture.ctx.params().clear();
+		benchmark::DoNotOptimize(
+			routes(fixture.ctx, "/api/orders/17/items?page=2"));
+	}
+}
+
+BENCHMARK(router_lookup);
+
+//==============================================================================
+// MIME types
+
+void mime_type_lookup(benchmark::State &state) {
+	const std::vector<std::filesystem::path> paths = {
+		"/srv/htdocs/index.html", "/srv/htdocs/css/site.css",
+		"/srv/htdocs/js/app.min.js", "/srv/htdocs/img/logo.PNG",
+		"/srv/htdocs/fonts/body.woff2", "/srv/htdocs/README"};
+
+	allocation_counter counter{state};
+	std::size_t i = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(mime_type(paths[i]));
+		i = (i + 1 == paths.size()) ? 0 : i + 1;
+	}
+}
+
+BENCHMARK(mime_type_lookup);
+
+//==============================================================================
+// Request cycle
+
+/*
+ * A keep-alive connection over loopback, served on the benchmark thread.
+ * Every round trip writes a request and polls the server until the whole
+ * response has arrived, so allocations of the server are counted.
+ */
+class connection_fixture {
+public:
+	static constexpr std::string_view request_text =
+		"GET /index.html HTTP/1.1\r\nHost: localhost\r\n"
+		"User-Agent: micro_bench\r\nAccept: */*\r\n\r\n";
+
+	template <typename responder_type>
+	explicit connection_fixture(responder_type responder) {
+		tcp::acceptor acceptor{
+			_io, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+		_client.connect(acceptor.local_endpoint());
+		acceptor.accept(_server);
+		asio::co_spawn(_io, http(_server, responder), asio::detached);
+
+		// Responses are all alike; the first one tells their size
+		asio::write(_client, asio::buffer(request_text));
+		std::string head;
+		while (head.find("\r\n\r\n") == std::string::npos) {
+			_io.poll();
+			head.append(_response.data(), receive());
+		}
+
+		const std::size_t header_size = head.find("\r\n\r\n") + 4;
+		const std::size_t length_at = head.find("Content-Length: ") + 16;
+		_response_size = header_size + std::stoul(head.substr(length_at));
+		for (std::size_t received = head.size(); received < _response_size;) {
+			_io.poll();
+			received += receive();
+		}
+	}
+
+	~connection_fixture() {
+		_client.close();
+		_io.run();
+	}
+
+	void round_trip() {
+		asio::write(_client, asio::buffer(request_text));
+		for (std::size_t received = 0; received < _response_size;) {
+			_io.poll();
+			received += receive();
+		}
+	}
+
+private:
+	std::size_t receive() {
+		if (_client.available() == 0)
+			return 0;
+
+		return _client.read_some(asio::buffer(_response));
+	}
+
+	asio::io_context _io;
+	tcp::socket _client{_io};
+	tcp::socket _server{_io};
+	std::array<char, 4096> _response;
+	std::size_t _response_size = 0;
+};
+
+string_response hello_response() {
+	string_response res{beast::http::status::ok, 11};
+	res.set(beast::http::field::content_type, "text/html");
+	res.body() = "<html><body>Hello</body></html>";
+	res.prepare_payload();
+	return res;
+}
+
+// The responder writes to the stream itself and returns null
+void keep_alive_write(benchmark::State &state) {
+	auto response = hello_response();
+	connection_fixture connection{
+		[&](request_context<tcp_stream> &ctx) -> awaitable<http_response> {
+			co_await ctx.write(response);
+			co_return nullptr;
+		}};
+
+	allocation_counter counter{state};
+	for (auto _ : state)
+		connection.round_trip();
+}
+
+BENCHMARK(keep_alive_write);
+
+void keep_alive_response(benchmark::State &state) {
+	const auto response = hello_response();
+	connection_fixture connection{
+		[&](request_context<tcp_stream> &) -> awaitable<http_response> {
+			co_return string_response{response};
+		}};
+
+	allocation_counter counter{state};
+	for (auto _ : state)
+		connection.round_trip();
+}
+
+BENCHMARK(keep_alive_response);
+
+void keep_alive_canned(benchmark::State &state) {
+	const canned_response response{hello_response()};
+	connection_fixture connection{
+		[&](request_context<tcp_stream> &ctx) -> awaitable<http_response> {
+			co_return response(ctx.request());
+		}};
+
+	allocation_counter counter{state};
+	for (auto _ : state)
+		connection.round_trip();
+}
+
+BENCHMARK(keep_alive_canned);
+
+//==============================================================================
+// Baselines
+
+struct measurement {
+	double ns_per_op = 0;
+	double allocs_per_op = 0;
+};
+
+/**
+ * Collects results while printing them as usual.
+ */
+class collecting_reporter : public benchmark::ConsoleReporter {
+public:
+	void ReportRuns(const std::vector<Run> &runs) override {
+		ConsoleReporter::ReportRuns(runs);
+		for (const Run &run : runs) {
+			if (run.error_occurred || (run.run_type != Run::RT_Iteration))
+				continue;
+
+			measurement &m = results[run.benchmark_name()];
+			m.ns_per_op = run.GetAdjustedRealTime() *
+						  benchmark::GetTimeUnitMultiplier(benchmark::kNanosecond) /
+						  benchmark::GetTimeUnitMultiplier(run.time_unit);
+			auto allocs = run.counters.find("allocs/op");
+			if (allocs != run.counters.end())
+				m.allocs_per_op = allocs->second.value;
+		}
+	}
+
+	std::map<std::string, measurement> results;
+};
+
+std::map<std::string, measurement>
+load_baseline(const std::filesystem::path &path) {
+	std::map<std::string, measurement> baseline;
+	std::ifstream in{path};
+	if (!in)
+		throw std::runtime_error{"Cannot read baseline " + path.string()};
+
+	std::string line;
+	while (std::getline(in, line)) {
+		std::istringstream fields{line};
+		std::string name;
+		measurement m;
+		if (fields >> name >> m.ns_per_op >> m.allocs_per_op)
+			baseline[name] = m;
+	}
+
+	return baseline;
+}
+
+void save_baseline(const std::filesystem::path &path,
+				   const std::map<std::string, measurement> &results) {
+	std::ofstream out{path};
+	for (const auto &[name, m] : results)
+		out << name << " " << m.ns_per_op << " " << m.allocs_per_op << "\n";
+}
+
+/*
+ * @return the number of benchmarks which regressed.
+ */
+int compare(const std::map<std::string, measurement> &baseline,
+			const std::map<std::string, measurement> &results,
+			double max_regression) {
+	int regressions = 0;
+	for (const auto &[name, m] : results) {
+		auto before = baseline.find(name);
+		if (before == baseline.end())
+			continue;
+
+		const double ratio = m.ns_per_op / before->second.ns_per_op;
+		const bool slower = ratio > 1.0 + max_regression;
+
+		// Fractional counts come from one-off allocations in short runs
+		const bool allocating =
+			m.allocs_per_op > before->second.allocs_per_op + 0.5;
+
+		if (slower || allocating) {
+			++regressions;
+			std::fprintf(stderr,
+						 "REGRESSION %s: %.2f ns/op (baseline %.2f, %+.1f%%), "
+						 "%.2f allocs/op (baseline %.2f)\n",
+						 name.c_str(), m.ns_per_op, before->second.ns_per_op,
+						 (ratio - 1.0) * 100.0, m.allocs_per_op,
+						 before->second.allocs_per_op);
+		}
+	}
+
+	return regressions;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	std::string baseline_path;
+	std::string save_path;
+	double max_regression = 0.1;
+
+	// Take out our own flags before Google Benchmark sees them
+	std::vector<char *> args;
+	for (int i = 0; i < argc; ++i) {
+		std::string_view arg{argv[i]};
+		if (arg.starts_with("--baseline="))
+			baseline_path = arg.substr(11);
+		else if (arg.starts_with("--save-baseline="))
+			save_path = arg.substr(16);
+		else if (arg.starts_with("--max-regression="))
+			max_regression = std::stod(std::string{arg.substr(17)});
+		else
+			args.push_back(argv[i]);
+	}
+
+	int bench_argc = static_cast<int>(args.size());
+	benchmark::Initialize(&bench_argc, args.data());
+	if (benchmark::ReportUnrecognizedArguments(bench_argc, args.data()))
+		return EXIT_FAILURE;
+
+	collecting_reporter reporter;
+	benchmark::RunSpecifiedBenchmarks(&reporter);
+	benchmark::Shutdown();
+
+	if (!save_path.empty())
+		save_baseline(save_path, reporter.results);
+
+	if (baseline_path.empty())
+		return EXIT_SUCCESS;
+
+	const int regressions =
+		compare(load_baseline(baseline_path), reporter.results, max_regression);
+	if (regressions > 0) {
+		std::fprintf(stderr, "%d benchmark(s) regressed by more than %.0f%%\n",
+					 regressions, max_regression * 100.0);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
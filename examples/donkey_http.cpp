@@ -15,9 +15,14 @@
 #include <boost/beast/http/string_body_fwd.hpp>
 #include <exception>
 #include <iostream>
+#include <webdonkey/access_log.hpp>
 #include <webdonkey/contextual.hpp>
 #include <webdonkey/http.hpp>
+#include <webdonkey/metrics.hpp>
+#include <webdonkey/metrics_responder.hpp>
+#include <webdonkey/router.hpp>
 #include <webdonkey/static_responder.hpp>
+#include <webdonkey/websocket.hpp>
 
 struct server_context {};
 
@@ -38,44 +43,137 @@ int main(int argc, char **argv) {
 	shared_object<server_context, thread_pool> shared_pool{
 		std::make_shared<thread_pool>(8)};
 
+	access_log_ptr access = std::make_shared<access_log>();
+	metrics_ptr metrics = std::make_shared<metrics_registry>();
+
+	connection_options connection;
+	connection.log = access;
+	connection.metrics = metrics;
+
 	std::filesystem::path doc_root{argv[1]};
 	std::string version = "webdonkey HTTP example";
 
-	static_responder serve_static{doc_root, "index.html", version};
+	/*
+	 * Variants are compressed, and large uploads written to disk, aside
+	 * from the threads serving requests
+	 */
+	thread_pool background_pool{2};
 
-	auto simple_server =
-		[&](request_context<tcp_stream> &ctx) -> awaitable<response_ptr> {
-		std::cout << "Serving " + ctx.method_string() + " " + ctx.target() +
-						 "\n";
-		expected_response response_or = serve_static(ctx, ctx.target());
-		if (response_or.has_value())
-			co_return response_or.value();
+	static_responder_options static_options;
+	static_options.cache = std::make_shared<file_cache>();
+	static_options.precompressed = true;
+	static_options.compression =
+		std::make_shared<compression_cache>(background_pool.get_executor());
+	static_options.metrics = metrics;
+
+	static_responder serve_static{doc_root, "index.html", version,
+								  static_options};
+
+	router<tcp_stream> routes;
+	routes.add("/metrics", metrics_responder{metrics});
+	routes.add("/*", metered(metrics, "static", serve_static));
+
+	spool_options spool;
+	spool.file_executor = background_pool.get_executor();
+
+	// Reads the request body before answering, hence a coroutine
+	auto upload =
+		[&](request_context<tcp_stream> &ctx,
+			std::string_view target) -> awaitable<expected_response> {
+		if (!target.empty() ||
+			ctx.request().method() != beast::http::verb::post)
+			co_return std::unexpected{
+				protocol_error{beast::http::status::not_found, ""}};
+
+		spooled_body body;
+		try {
+			body = co_await ctx.spool_body(spool);
+		} catch (boost::system::system_error &err) {
+			if (err.code() != beast::http::error::body_limit)
+				throw;
+
+			co_return std::unexpected{protocol_error{
+				beast::http::status::payload_too_large, "", false}};
+		}
 
-		std::cerr << "[HTTP error] " + response_or.error().message + "\n";
 		beast::http::response<beast::http::string_body> res{
-			response_or.error().status, ctx.request().version()};
+			beast::http::status::ok, ctx.request().version()};
 		res.set(boost::beast::http::field::server, version);
-		res.set(boost::beast::http::field::content_type, "text/html");
+		res.set(boost::beast::http::field::content_type, "text/plain");
 		res.keep_alive(ctx.request().keep_alive());
-		res.body() = response_or.error().message;
+		res.body() = std::to_string(body.size) + " bytes received\n";
 		res.prepare_payload();
-		co_return std::make_shared<response_generator>(std::move(res));
+		co_return std::move(res);
+	};
+
+	// Every subscriber gets the same message, shared rather than copied
+	websocket_channel_ptr clock = std::make_shared<websocket_channel>();
+	boost::asio::co_spawn(
+		shared_pool->get_executor(),
+		[clock]() -> awaitable<void> {
+			boost::asio::steady_timer timer{
+				co_await boost::asio::this_coro::executor};
+			for (;;) {
+				timer.expires_after(std::chrono::seconds(1));
+				co_await timer.async_wait(boost::asio::use_awaitable);
+				clock->publish(
+					websocket_message{std::string{current_http_date()}});
+			}
+		},
+		boost::asio::detached);
+
+	websocket_responder live{
+		[clock](auto &connection) -> awaitable<void> {
+			connection.subscribe(clock);
+			co_await connection.read_until_closed();
+		}};
+
+	auto site = route("/live", live) | route("/upload", upload) | routes;
+
+	// Error pages differ only in status and message
+	empty_response error_header{beast::http::status::not_found, 11};
+	error_header.set(boost::beast::http::field::server, version);
+	error_header.set(boost::beast::http::field::content_type, "text/html");
+	const canned_response error_page{error_header};
+
+	auto simple_server =
+		[&](request_context<tcp_stream> &ctx) -> awaitable<http_response> {
+		expected_response response_or =
+			co_await site(ctx, ctx.target());
+		if (response_or.has_value())
+			co_return std::move(response_or.value());
+
+		if (!response_or.error().message.empty())
+			access->message("[HTTP error] " + response_or.error().message);
+
+		canned_fields fields;
+		fields.status = response_or.error().status;
+		fields.body = std::move(response_or.error().message);
+		co_return error_page(ctx.request(), std::move(fields));
 	};
 
+	/*
+	 * Everything is registered; lookups from here on need no lock. Frozen
+	 * before the listeners start accepting on the pool.
+	 */
+	shared_registry<server_context>::shared().freeze();
+
 	auto const address = boost::asio::ip::make_address("0.0.0.0");
 	boost::asio::ip::tcp::endpoint http_endpoint{address, 80};
 
 	tcp_listener<server_context, thread_pool> http_listener{
 		http_endpoint, [&](tcp::socket &socket) -> awaitable<void> {
 			try {
-				co_await http(socket, simple_server);
+				co_await http(socket, simple_server, connection);
 			} catch (std::exception &err) {
-				std::cerr << std::string{err.what()} + "\n";
+				access->message(err.what());
 			} catch (...) {
-				std::cerr << "Unknown error occurred.\n";
+				access->message("Unknown error occurred.");
 			}
 		}};
 
+	watch_admission(*metrics, http_listener.admission());
+
 	shared_pool->join();
 
 	return 0;
@@ -17,10 +17,14 @@
 #include <boost/beast/http/string_body_fwd.hpp>
 #include <exception>
 #include <iostream>
-#include <sstream>
+#include <webdonkey/access_log.hpp>
+#include <webdonkey/metrics.hpp>
+#include <webdonkey/metrics_responder.hpp>
 #include <webdonkey/contextual.hpp>
 #include <webdonkey/http.hpp>
 #include <webdonkey/static_responder.hpp>
+#include <webdonkey/tls.hpp>
+#include <webdonkey/websocket.hpp>
 
 struct server_context {};
 
@@ -121,10 +125,11 @@ int main(int argc, char **argv) {
 	using namespace webdonkey;
 
 	// Check command line arguments.
-	if (argc != 2) {
-		std::cerr << "Usage: donkey_http <doc_root>" << std::endl
+	if ((argc < 2) || (argc > 3) ||
+		((argc == 3) && (std::string_view{argv[2]} != "--ktls"))) {
+		std::cerr << "Usage: donkey_https <doc_root> [--ktls]" << std::endl
 				  << "Example:" << std::endl
-				  << "    donkey_http /path/to/htdocs" << std::endl;
+				  << "    donkey_https /path/to/htdocs --ktls" << std::endl;
 		return EXIT_FAILURE;
 	}
 
@@ -133,70 +138,121 @@ int main(int argc, char **argv) {
 
 	ssl::context ssl_ctx{ssl::context::tlsv12};
 	load_server_certificate(ssl_ctx);
+	enable_session_resumption(ssl_ctx);
+	enable_http2(ssl_ctx);
+
+	// Kernel TLS, if available, for connections which can use it
+	if (argc == 3) {
+		if (!kernel_tls_built) {
+			std::cerr << "Kernel TLS is not built in, configure with "
+						 "-DWEBDONKEY_KERNEL_TLS=ON"
+					  << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		enable_kernel_tls(ssl_ctx);
+	}
+
+	access_log_ptr access = std::make_shared<access_log>();
+	metrics_ptr metrics = std::make_shared<metrics_registry>();
+
+	connection_options connection;
+	connection.log = access;
+	connection.metrics = metrics;
 
 	std::filesystem::path doc_root{argv[1]};
 	std::string version = "webdonkey HTTP example";
 
-	static_responder serve_static{doc_root, "index.html", version};
+	// Variants are compressed aside from the threads serving requests
+	thread_pool compression_pool{2};
+
+	static_responder_options static_options;
+	static_options.cache = std::make_shared<file_cache>();
+	static_options.precompressed = true;
+	static_options.compression =
+		std::make_shared<compression_cache>(compression_pool.get_executor());
+	static_options.metrics = metrics;
+
+	static_responder serve_static{doc_root, "index.html", version,
+								  static_options};
+
+	// Sends every message back; generic over plain and kernel TLS
+	websocket_responder echo{
+		[](auto &connection) -> awaitable<void> {
+			beast::flat_buffer buffer;
+			for (;;) {
+				const bool open = co_await connection.read(buffer);
+				if (!open)
+					break;
+
+				connection.send(websocket_message{
+					beast::buffers_to_string(buffer.data()),
+					connection.stream().got_binary()});
+				buffer.consume(buffer.size());
+			}
+		}};
+
+	auto secure_routes = route("/echo", echo) |
+						 route("/metrics", metrics_responder{metrics}) |
+						 metered(metrics, "static", serve_static);
+
+	// Error pages differ only in status and message
+	empty_response error_header{beast::http::status::not_found, 11};
+	error_header.set(boost::beast::http::field::server, version);
+	error_header.set(boost::beast::http::field::content_type, "text/html");
+	const canned_response error_page{error_header};
 
-	auto secure_server =
-		[&](request_context<ssl_stream> &ctx) -> awaitable<response_ptr> {
-		std::cout << "Serving " + ctx.method_string() + " " + ctx.target() +
-						 "\n";
-		expected_response response_or = serve_static(ctx, ctx.target());
+	// Generic, so that it serves HTTP/2 streams as well
+	auto secure_server = [&](auto &ctx) -> awaitable<http_response> {
+		expected_response response_or =
+			co_await secure_routes(ctx, ctx.target());
 		if (response_or.has_value())
-			co_return response_or.value();
-
-		std::stringstream err_stream;
-		err_stream << "[HTTP " << static_cast<int>(response_or.error().status)
-				   << "] " << response_or.error().message << std::endl;
-		std::cerr << err_stream.str();
-
-		beast::http::response<beast::http::string_body> res{
-			response_or.error().status, ctx.request().version()};
-		res.set(boost::beast::http::field::server, version);
-		res.set(boost::beast::http::field::content_type, "text/html");
-		res.keep_alive(ctx.request().keep_alive());
-		res.body() = response_or.error().message;
-		res.prepare_payload();
-		co_return std::make_shared<response_generator>(std::move(res));
+			co_return std::move(response_or.value());
+
+		if (!response_or.error().message.empty())
+			access->message("[HTTP error] " + response_or.error().message);
+
+		canned_fields fields;
+		fields.status = response_or.error().status;
+		fields.body = std::move(response_or.error().message);
+		co_return error_page(ctx.request(), std::move(fields));
 	};
 
+	/*
+	 * Everything is registered; lookups from here on need no lock. Frozen
+	 * before the listeners start accepting on the pool.
+	 */
+	shared_registry<server_context>::shared().freeze();
+
 	auto const address = boost::asio::ip::make_address("0.0.0.0");
 	boost::asio::ip::tcp::endpoint https_endpoint{address, 443};
 
 	tcp_listener<server_context, thread_pool> https_listener{
 		https_endpoint, [&](tcp::socket &socket) -> awaitable<void> {
 			try {
-				co_await https(socket, ssl_ctx, secure_server);
+				co_await https(socket, ssl_ctx, secure_server, connection);
 			} catch (std::exception &err) {
-				std::cerr << std::string{err.what()} + "\n";
+				access->message(err.what());
 			} catch (...) {
-				std::cerr << "Unknown error occurred.\n";
+				access->message("Unknown error occurred.");
 			}
 		}};
 
+	empty_response redirect{beast::http::status::moved_permanently, 11};
+	redirect.set(boost::beast::http::field::server, version);
+	redirect.set(boost::beast::http::field::content_type, "text/html");
+	const canned_response moved{redirect};
+
 	auto redirect_server =
-		[&](request_context<tcp_stream> &ctx) -> awaitable<response_ptr> {
-		beast::http::response<beast::http::empty_body> res{
-			beast::http::status::moved_permanently, ctx.request().version()};
-		res.set(boost::beast::http::field::server, version);
-		res.set(boost::beast::http::field::content_type, "text/html");
-
-		std::stringstream url_builder;
-		url_builder << "https://" << ctx.request()[beast::http::field::host]
-					<< ctx.target();
-		std::string redirect_url = url_builder.str();
-
-		std::stringstream log_stream;
-		log_stream << "Redirect " << ctx.method_string() << " " << ctx.target()
-				   << " to " << redirect_url << std::endl;
-		std::cout << log_stream.str();
-
-		res.set(beast::http::field::location, redirect_url);
-		res.keep_alive(true);
-		res.prepare_payload();
-		co_return std::make_shared<response_generator>(std::move(res));
+		[&](request_context<tcp_stream> &ctx) -> awaitable<http_response> {
+		const beast::string_view host =
+			ctx.request()[beast::http::field::host];
+		const std::string_view target = ctx.target();
+
+		canned_fields fields;
+		fields.location.reserve(8 + host.size() + target.size());
+		fields.location.append("https://").append(host).append(target);
+		co_return moved(ctx.request(), std::move(fields));
 	};
 
 	boost::asio::ip::tcp::endpoint http_endpoint{address, 80};
@@ -204,14 +260,18 @@ int main(int argc, char **argv) {
 	tcp_listener<server_context, thread_pool> http_listener{
 		http_endpoint, [&](tcp::socket &socket) -> awaitable<void> {
 			try {
-				co_await http(socket, redirect_server);
+				co_await http(socket, redirect_server, connection);
 			} catch (std::exception &err) {
-				std::cerr << std::string{err.what()} + "\n";
+				access->message(err.what());
 			} catch (...) {
-				std::cerr << "Unknown error occurred.\n";
+				access->message("Unknown error occurred.");
 			}
 		}};
 
+	watch_admission(*metrics, https_listener.admission(),
+					"listener=\"https\"");
+	watch_admission(*metrics, http_listener.admission(), "listener=\"http\"");
+
 	shared_pool->join();
 
 	return 0;
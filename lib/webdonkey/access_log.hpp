@@ -0,0 +1,402 @@
+/*
+ * access_log.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_ACCESS_LOG_HPP_
+#define LIB_WEBDONKEY_ACCESS_LOG_HPP_
+
+#include <webdonkey/defs.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace webdonkey {
+
+/**
+ * Fixed-size log entry; the binary log format is a sequence of these in
+ * native layout.
+ */
+struct access_record {
+	static constexpr std::size_t text_capacity = 192;
+
+	enum class kind : std::uint8_t { request, message };
+
+	// Nanoseconds since the epoch
+	std::int64_t time = 0;
+
+	// Nanoseconds from the request header to the response
+	std::int64_t latency = 0;
+
+	std::uint64_t bytes = 0;
+
+	// IPv4 addresses take the first 4 bytes
+	std::array<std::uint8_t, 16> address{};
+	std::uint16_t port = 0;
+	std::uint8_t address_family = 0;
+
+	kind type = kind::request;
+	std::uint16_t status = 0;
+	beast::http::verb method = beast::http::verb::unknown;
+
+	// Request target or message, possibly truncated
+	std::uint16_t text_size = 0;
+	char text[text_capacity]{};
+
+	void set_text(std::string_view value) {
+		text_size = static_cast<std::uint16_t>(
+			std::min(value.size(), text_capacity));
+		std::copy_n(value.data(), text_size, text);
+	}
+
+	std::string_view get_text() const { return {text, text_size}; }
+
+	void set_peer(const tcp::endpoint &peer) {
+		port = peer.port();
+		if (peer.address().is_v4()) {
+			address_family = 4;
+			auto bytes = peer.address().to_v4().to_bytes();
+			std::copy(bytes.begin(), bytes.end(), address.begin());
+		} else {
+			address_family = 6;
+			auto bytes = peer.address().to_v6().to_bytes();
+			std::copy(bytes.begin(), bytes.end(), address.begin());
+		}
+	}
+};
+
+/**
+ * Single-producer single-consumer ring of log records.
+ */
+class access_ring {
+public:
+	explicit access_ring(std::size_t capacity) :
+		_slots(std::bit_ceil(std::max<std::size_t>(capacity, 2))),
+		_mask{_slots.size() - 1} {}
+
+	access_ring(const access_ring &) = delete;
+	access_ring(access_ring &&) = delete;
+	access_ring &operator=(const access_ring &) = delete;
+	access_ring &operator=(access_ring &&) = delete;
+
+	/**
+	 * Called by the owning thread only. Drops the record if the ring is
+	 * full.
+	 */
+	bool push(const access_record &record) {
+		const std::size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _head.load(std::memory_order_acquire) > _mask) {
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		_slots[tail & _mask] = record;
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Called by the draining thread only.
+	 */
+	template <typename consumer_type> std::size_t drain(consumer_type consume) {
+		const std::size_t head = _head.load(std::memory_order_relaxed);
+		const std::size_t tail = _tail.load(std::memory_order_acquire);
+		for (std::size_t i = head; i != tail; ++i)
+			consume(_slots[i & _mask]);
+
+		_head.store(tail, std::memory_order_release);
+		return tail - head;
+	}
+
+	std::uint64_t dropped() const {
+		return _dropped.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::vector<access_record> _slots;
+	const std::size_t _mask;
+	alignas(64) std::atomic<std::size_t> _head = 0;
+	alignas(64) std::atomic<std::size_t> _tail = 0;
+	std::atomic<std::uint64_t> _dropped = 0;
+};
+
+struct access_log_options {
+	enum class format { text, binary };
+
+	// Appended to; standard output if empty
+	std::filesystem::path path;
+
+	format output_format = format::text;
+
+	// Records buffered per logging thread
+	std::size_t ring_capacity = 1024;
+
+	std::chrono::milliseconds flush_interval{100};
+};
+
+/**
+ * Access log written by a background thread. Every thread which logs gets
+ * its own lock-free ring, so logging never blocks on I/O or on other
+ * threads; records which do not fit in a full ring are dropped and
+ * counted instead.
+ */
+class access_log {
+public:
+	explicit access_log(const access_log_options &options = {}) :
+		_options{options}, _id{next_id()} {
+		if (options.path.empty())
+			_fd = STDOUT_FILENO;
+		else {
+			_fd = ::open(options.path.c_str(),
+						 O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+			if (_fd < 0)
+				throw boost::system::system_error{
+					errno, boost::system::system_category()};
+		}
+
+		_writer = std::thread{[this]() { run(); }};
+	}
+
+	access_log(const access_log &) = delete;
+	access_log(access_log &&) = delete;
+	access_log &operator=(const access_log &) = delete;
+	access_log &operator=(access_log &&) = delete;
+
+	/**
+	 * Writes out whatever is still buffered.
+	 */
+	~access_log() {
+		{
+			std::lock_guard<std::mutex> lock{_mutex};
+			_stopping = true;
+		}
+
+		_wakeup.notify_one();
+		_writer.join();
+
+		if (_fd != STDOUT_FILENO)
+			::close(_fd);
+	}
+
+	bool log(const access_record &record) { return local_ring().push(record); }
+
+	/**
+	 * Logs a free-form line, e.g. an error.
+	 */
+	bool message(std::string_view text) {
+		access_record record;
+		record.type = access_record::kind::message;
+		record.time = now();
+		record.set_text(text);
+		return log(record);
+	}
+
+	// Records dropped because a ring was full
+	std::uint64_t dropped() const {
+		std::lock_guard<std::mutex> lock{_mutex};
+		std::uint64_t total = 0;
+		for (const std::shared_ptr<access_ring> &ring : _rings)
+			total += ring->dropped();
+
+		return total;
+	}
+
+	// Records written so far
+	std::uint64_t written() const {
+		return _written.load(std::memory_order_relaxed);
+	}
+
+	static std::int64_t now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				   std::chrono::system_clock::now().time_since_epoch())
+			.count();
+	}
+
+private:
+	static std::uint64_t next_id() {
+		static std::atomic<std::uint64_t> counter = 0;
+		return ++counter;
+	}
+
+	access_ring &local_ring();
+
+	void run();
+
+	void drain();
+
+	void format(const access_record &record);
+
+	void write_out();
+
+	access_log_options _options;
+	const std::uint64_t _id;
+	int _fd = -1;
+
+	std::vector<std::shared_ptr<access_ring>> _rings;
+	mutable std::mutex _mutex;
+	std::condition_variable _wakeup;
+	bool _stopping = false;
+
+	// Used by the writer thread only
+	std::string _output;
+	std::atomic<std::uint64_t> _written = 0;
+
+	std::thread _writer;
+};
+
+using access_log_ptr = std::shared_ptr<access_log>;
+
+//==============================================================================
+
+inline access_ring &access_log::local_ring() {
+	/*
+	 * Rings are keyed by log id rather than address, and shared with the
+	 * log, so that neither may dangle.
+	 */
+	thread_local std::vector<
+		std::pair<std::uint64_t, std::shared_ptr<access_ring>>>
+		local_rings;
+
+	for (auto &entry : local_rings)
+		if (entry.first == _id)
+			return *entry.second;
+
+	std::shared_ptr<access_ring> ring =
+		std::make_shared<access_ring>(_options.ring_capacity);
+	{
+		std::lock_guard<std::mutex> lock{_mutex};
+		_rings.push_back(ring);
+	}
+
+	local_rings.emplace_back(_id, ring);
+	return *ring;
+}
+
+inline void access_log::run() {
+	std::unique_lock<std::mutex> lock{_mutex};
+	while (!_stopping) {
+		_wakeup.wait_for(lock, _options.flush_interval,
+						 [this]() { return _stopping; });
+		lock.unlock();
+		drain();
+		lock.lock();
+	}
+}
+
+inline void access_log::drain() {
+	std::vector<std::shared_ptr<access_ring>> rings;
+	{
+		std::lock_guard<std::mutex> lock{_mutex};
+		rings = _rings;
+	}
+
+	std::uint64_t count = 0;
+	for (std::shared_ptr<access_ring> &ring : rings)
+		count += ring->drain([this](const access_record &record) {
+			format(record);
+			if (_output.size() >= 64 * 1024)
+				write_out();
+		});
+
+	write_out();
+	_written.fetch_add(count, std::memory_order_relaxed);
+}
+
+inline void access_log::format(const access_record &record) {
+	if (_options.output_format == access_log_options::format::binary) {
+		_output.append(reinterpret_cast<const char *>(&record), sizeof(record));
+		return;
+	}
+
+	char line[128];
+	char *end = line + sizeof(line);
+
+	std::time_t seconds = static_cast<std::time_t>(record.time / 1000000000);
+	std::tm tm;
+	gmtime_r(&seconds, &tm);
+	char *pos = line + std::strftime(line, sizeof(line), "%Y-%m-%dT%H:%M:%S",
+									 &tm);
+	pos += std::snprintf(pos, end - pos, ".%03dZ ",
+						 static_cast<int>(record.time / 1000000 % 1000));
+
+	if (record.type == access_record::kind::message) {
+		_output.append(line, pos);
+		_output.append(record.get_text());
+		_output.push_back('\n');
+		return;
+	}
+
+	if (record.address_family == 4) {
+		pos += std::snprintf(pos, end - pos, "%u.%u.%u.%u:%u ",
+							 record.address[0], record.address[1],
+							 record.address[2], record.address[3], record.port);
+	} else if (record.address_family == 6) {
+		asio::ip::address_v6::bytes_type bytes;
+		std::copy_n(record.address.begin(), bytes.size(), bytes.begin());
+		std::string address = asio::ip::address_v6{bytes}.to_string();
+		pos += std::snprintf(pos, end - pos, "[%s]:%u ", address.c_str(),
+							 record.port);
+	} else
+		pos += std::snprintf(pos, end - pos, "- ");
+
+	std::string_view method = beast::http::to_string(record.method);
+	_output.append(line, pos);
+	_output.push_back('"');
+	_output.append(method.data(), method.size());
+	_output.push_back(' ');
+	_output.append(record.get_text());
+	_output.append("\" ");
+
+	pos = line;
+	if (record.status != 0)
+		pos += std::snprintf(pos, end - pos, "%u ", record.status);
+	else
+		pos += std::snprintf(pos, end - pos, "- ");
+
+	pos += std::snprintf(pos, end - pos, "%llu %.3fms\n",
+						 static_cast<unsigned long long>(record.bytes),
+						 static_cast<double>(record.latency) / 1e6);
+	_output.append(line, pos);
+}
+
+inline void access_log::write_out() {
+	std::size_t offset = 0;
+	while (offset < _output.size()) {
+		ssize_t written =
+			::write(_fd, _output.data() + offset, _output.size() - offset);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+
+			// Nothing sensible to do about a failing log
+			break;
+		}
+
+		offset += static_cast<std::size_t>(written);
+	}
+
+	_output.clear();
+}
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_ACCESS_LOG_HPP_ */
@@ -0,0 +1,308 @@
+/*
+ * admission.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_ADMISSION_HPP_
+#define LIB_WEBDONKEY_ADMISSION_HPP_
+
+#include <webdonkey/defs.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/write.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace webdonkey {
+
+struct admission_options {
+	// Connections served at once; zero means no limit
+	std::size_t max_connections = 0;
+
+	// New connections beyond this many get a 503; zero means never
+	std::size_t shed_threshold = 0;
+
+	// Connections accepted per second; zero means no limit
+	double max_accept_rate = 0;
+
+	// Connections which may be accepted at once ahead of the rate
+	std::size_t accept_burst = 1;
+
+	// At max_connections, leave new connections in the kernel backlog
+	// instead of accepting and closing them
+	bool pause_accepting = true;
+
+	std::chrono::seconds retry_after{1};
+
+	// Shed connections get a plain text HTTP/1.1 503 instead of just being
+	// closed. Only for plain HTTP listeners: on TLS it would be written
+	// into the handshake.
+	bool plain_http = false;
+};
+
+/**
+ * Connection counters and limits shared by the acceptors of a listener.
+ * Shards may share one instance. Counting is lock-free; a lock is only
+ * taken to pause accepting at capacity and to resume it.
+ */
+class admission_control {
+public:
+	using clock = std::chrono::steady_clock;
+
+	enum class verdict { admit, shed, reject };
+
+	explicit admission_control(const admission_options &options = {}) :
+		_options{options},
+		_shed_response{"HTTP/1.1 503 Service Unavailable\r\n"
+					   "Retry-After: " +
+					   std::to_string(options.retry_after.count()) +
+					   "\r\n"
+					   "Content-Length: 0\r\n"
+					   "Connection: close\r\n\r\n"} {
+		if (options.max_accept_rate > 0)
+			_accept_interval = std::chrono::duration_cast<clock::duration>(
+				std::chrono::duration<double>{1.0 / options.max_accept_rate});
+	}
+
+	admission_control(const admission_control &) = delete;
+	admission_control(admission_control &&) = delete;
+	admission_control &operator=(const admission_control &) = delete;
+	admission_control &operator=(admission_control &&) = delete;
+
+	const admission_options &options() const { return _options; }
+
+	// Connections currently served
+	std::size_t active() const { return _active.load(); }
+
+	// Totals since start
+	std::uint64_t admitted() const { return _admitted.load(); }
+	std::uint64_t shed() const { return _shed.load(); }
+	std::uint64_t rejected() const { return _rejected.load(); }
+
+	bool at_capacity() const {
+		return (_options.max_connections > 0) &&
+			   (active() >= _options.max_connections);
+	}
+
+	/**
+	 * Waits until the next connection may be accepted: while at capacity
+	 * if accepting is paused, until release() frees a slot, and for the
+	 * turn of the connection under the accept rate.
+	 */
+	awaitable<void> throttle();
+
+	/**
+	 * Decides the fate of an accepted connection. An admitted connection is
+	 * counted as active until release() is called.
+	 */
+	verdict admit();
+
+	void release() {
+		_active.fetch_sub(1);
+		if (_paused.load() > 0)
+			resume_accepting();
+	}
+
+	// Canned response for shed connections
+	std::string_view shed_response() const { return _shed_response; }
+
+private:
+	// Accept loop paused at capacity
+	struct paused_loop {
+		explicit paused_loop(const asio::any_io_executor &executor) :
+			timer{executor, clock::time_point::max()} {}
+
+		// Timer operations and woken are guarded by _paused_mutex
+		asio::steady_timer timer;
+		bool woken = false;
+	};
+
+	using paused_ptr = std::shared_ptr<paused_loop>;
+
+	// Reserves the next accept slot under the rate limit (GCRA)
+	clock::duration reserve_accept();
+
+	awaitable<void> pause_accepting();
+
+	// Wakes all paused loops, which recheck the capacity
+	void resume_accepting();
+
+	admission_options _options;
+	std::string _shed_response;
+	clock::duration _accept_interval = clock::duration::zero();
+
+	std::atomic<std::size_t> _active = 0;
+	std::atomic<std::uint64_t> _admitted = 0;
+	std::atomic<std::uint64_t> _shed = 0;
+	std::atomic<std::uint64_t> _rejected = 0;
+
+	// Theoretical arrival time of the next connection
+	std::atomic<clock::rep> _next_accept = 0;
+
+	std::atomic<std::size_t> _paused = 0;
+	std::vector<paused_ptr> _paused_loops;
+	std::mutex _paused_mutex;
+};
+
+using admission_ptr = std::shared_ptr<admission_control>;
+
+/**
+ * Keeps an admitted connection counted for as long as it lives.
+ */
+class connection_ticket {
+public:
+	explicit connection_ticket(admission_ptr admission) :
+		_admission{std::move(admission)} {}
+
+	connection_ticket(const connection_ticket &) = delete;
+	connection_ticket(connection_ticket &&) = default;
+	connection_ticket &operator=(const connection_ticket &) = delete;
+	connection_ticket &operator=(connection_ticket &&) = delete;
+
+	~connection_ticket() {
+		if (_admission)
+			_admission->release();
+	}
+
+private:
+	admission_ptr _admission;
+};
+
+//==============================================================================
+
+inline admission_control::clock::duration admission_control::reserve_accept() {
+	if (_accept_interval == clock::duration::zero())
+		return clock::duration::zero();
+
+	const clock::rep now = clock::now().time_since_epoch().count();
+	const clock::rep interval = _accept_interval.count();
+	const clock::rep tolerance =
+		interval *
+		static_cast<clock::rep>(std::max<std::size_t>(_options.accept_burst, 1) -
+								1);
+
+	clock::rep next = _next_accept.load();
+	clock::rep arrival;
+	do {
+		arrival = std::max(next, now);
+	} while (!_next_accept.compare_exchange_weak(next, arrival + interval));
+
+	return clock::duration{std::max<clock::rep>(arrival - tolerance - now, 0)};
+}
+
+inline awaitable<void> admission_control::pause_accepting() {
+	paused_ptr loop =
+		std::make_shared<paused_loop>(co_await asio::this_coro::executor);
+	{
+		std::lock_guard<std::mutex> lock{_paused_mutex};
+		_paused_loops.push_back(loop);
+	}
+
+	/*
+	 * Counted after being listed and before the capacity is checked
+	 * again, while release() frees a slot before looking at the count, so
+	 * that either the slot is seen here or the loop is woken.
+	 */
+	_paused.fetch_add(1);
+	if (at_capacity()) {
+		// The wait is started under the lock, so no wakeup goes unnoticed
+		auto wait = [this, loop](auto handler) {
+			std::lock_guard<std::mutex> lock{_paused_mutex};
+			if (loop->woken)
+				loop->timer.expires_after(clock::duration::zero());
+
+			loop->timer.async_wait(std::move(handler));
+		};
+
+		beast::error_code ec;
+		auto token = asio::redirect_error(asio::use_awaitable, ec);
+		co_await asio::async_initiate<decltype(token),
+									  void(beast::error_code)>(wait, token);
+	}
+
+	_paused.fetch_sub(1);
+	std::lock_guard<std::mutex> lock{_paused_mutex};
+	std::erase(_paused_loops, loop);
+}
+
+inline void admission_control::resume_accepting() {
+	std::lock_guard<std::mutex> lock{_paused_mutex};
+	for (const paused_ptr &loop : _paused_loops) {
+		loop->woken = true;
+		loop->timer.cancel();
+	}
+
+	_paused_loops.clear();
+}
+
+inline awaitable<void> admission_control::throttle() {
+	if (_options.pause_accepting)
+		while (at_capacity())
+			co_await pause_accepting();
+
+	clock::duration delay = reserve_accept();
+	if (delay > clock::duration::zero()) {
+		asio::steady_timer timer{co_await asio::this_coro::executor};
+		timer.expires_after(delay);
+		co_await timer.async_wait(asio::use_awaitable);
+	}
+}
+
+inline admission_control::verdict admission_control::admit() {
+	const std::size_t count = _active.fetch_add(1) + 1;
+	if ((_options.max_connections > 0) && (count > _options.max_connections)) {
+		_active.fetch_sub(1);
+		_rejected.fetch_add(1);
+		return verdict::reject;
+	}
+
+	if ((_options.shed_threshold > 0) && (count > _options.shed_threshold)) {
+		_active.fetch_sub(1);
+		_shed.fetch_add(1);
+		return verdict::shed;
+	}
+
+	_admitted.fetch_add(1);
+	return verdict::admit;
+}
+
+/**
+ * Answers a shed connection with a 503 and closes it.
+ */
+inline awaitable<void> shed_connection(tcp::socket socket,
+									   admission_ptr admission) {
+	beast::error_code ec;
+	if (admission->options().plain_http) {
+		co_await asio::async_write(socket,
+								   asio::buffer(admission->shed_response()),
+								   asio::redirect_error(asio::use_awaitable, ec));
+		socket.shutdown(tcp::socket::shutdown_send, ec);
+
+		// Unread request bytes would turn the close into a reset which
+		// may destroy the response before the client reads it.
+		char discard[4096];
+		std::size_t pending = socket.available(ec);
+		while (!ec && (pending > 0)) {
+			pending -= std::min(pending, socket.read_some(
+											 asio::buffer(discard), ec));
+		}
+	}
+
+	socket.close(ec);
+}
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_ADMISSION_HPP_ */
@@ -0,0 +1,317 @@
+/*
+ * canned_response.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_CANNED_RESPONSE_HPP_
+#define LIB_WEBDONKEY_CANNED_RESPONSE_HPP_
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <ctime>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <webdonkey/conditional.hpp>
+#include <webdonkey/defs.hpp>
+
+namespace webdonkey {
+
+/**
+ * Current date in IMF-fixdate format. Formatted at most once per second
+ * on each thread.
+ */
+inline std::string_view current_http_date() {
+	thread_local std::time_t formatted_at = -1;
+	thread_local std::string date;
+
+	const std::time_t now = std::time(nullptr);
+	if (now != formatted_at) {
+		date = http_date(now);
+		formatted_at = now;
+	}
+
+	return date;
+}
+
+/**
+ * Per-response parts of a canned response.
+ */
+struct canned_fields {
+	// Replaces the canned status, e.g. of an error page shared by statuses
+	std::optional<beast::http::status> status;
+
+	// Value of the Location field; the field is omitted if empty
+	std::string location;
+
+	// Replaces the canned body
+	std::optional<std::string> body;
+
+	/*
+	 * Replaces the canned body with immutable content kept alive by
+	 * content_owner, e.g. that of a cached file. Used if the owner is set.
+	 */
+	asio::const_buffer content;
+	std::shared_ptr<const void> content_owner;
+};
+
+/*
+ * Serialized parts of a canned response shared by all messages made
+ * from it.
+ */
+struct canned_text {
+	beast::http::status status;
+
+	// "HTTP/1.1 <status> <reason>\r\n"
+	std::string status_line;
+
+	// Fixed fields, each followed by CRLF, and then the name of Date
+	std::string fields;
+
+	std::string body;
+};
+
+/**
+ * One response made from a canned_response, written as a list of
+ * buffers: the shared status line, fields and body, with the few fields
+ * set per response in between.
+ */
+class canned_message {
+public:
+	// Most buffers a message consists of
+	static constexpr std::size_t max_buffers = 10;
+
+	bool is_done() const { return _written == _size; }
+
+	/**
+	 * Stores the buffers of the unsent part of the message in out, which
+	 * must have room for max_buffers of them.
+	 *
+	 * @return the number of buffers stored.
+	 */
+	std::size_t prepare(std::span<asio::const_buffer> out) const {
+		std::array<asio::const_buffer, max_buffers> all;
+		const std::size_t count = buffers(all);
+
+		std::size_t skip = _written;
+		std::size_t stored = 0;
+		for (std::size_t i = 0; i < count; ++i) {
+			if (skip >= all[i].size()) {
+				skip -= all[i].size();
+				continue;
+			}
+
+			out[stored++] = all[i] + skip;
+			skip = 0;
+		}
+
+		return stored;
+	}
+
+	void consume(std::size_t n) { _written += n; }
+
+private:
+	friend class canned_response;
+
+	static constexpr std::string_view close = "\r\nConnection: close";
+	static constexpr std::string_view keep_alive =
+		"\r\nConnection: keep-alive";
+
+	canned_message(std::shared_ptr<const canned_text> text,
+				   canned_fields &&fields, std::string_view connection,
+				   bool head_only) :
+		_text{std::move(text)}, _location{std::move(fields.location)},
+		_connection{connection},
+		_content_owner{std::move(fields.content_owner)} {
+		const std::string_view date = current_http_date();
+		date.copy(_date.data(), _date.size());
+
+		beast::http::status status = _text->status;
+		if (fields.status.has_value() && (fields.status != status)) {
+			status = fields.status.value();
+
+			// Standard reasons are at most 31 characters long
+			const beast::string_view reason =
+				beast::http::obsolete_reason(status);
+			char *end = std::copy_n("HTTP/1.1 ", 9, _status_line.data());
+			end = std::to_chars(end, end + 3, static_cast<unsigned>(status))
+					  .ptr;
+			*end++ = ' ';
+			end = std::copy(reason.begin(), reason.end(), end);
+			end = std::copy_n("\r\n", 2, end);
+			_status_line_size = end - _status_line.data();
+		}
+
+		if (_content_owner)
+			_content = fields.content;
+		else if (fields.body.has_value()) {
+			_body = std::move(fields.body.value());
+			_own_body = true;
+		}
+
+		// See RFC 9110, section 8.6
+		const unsigned code = static_cast<unsigned>(status);
+		if ((code >= 200) && (code != 204) && (code != 304))
+			_length_size = std::to_chars(_length.data(),
+										 _length.data() + _length.size(),
+										 content().size())
+							   .ptr -
+						   _length.data();
+
+		_send_body = !head_only && (_length_size > 0);
+
+		std::array<asio::const_buffer, max_buffers> all;
+		_size = beast::buffer_bytes(
+			std::span<const asio::const_buffer>{all.data(), buffers(all)});
+	}
+
+	std::size_t
+	buffers(std::array<asio::const_buffer, max_buffers> &out) const {
+		static constexpr std::string_view location = "\r\nLocation: ";
+		static constexpr std::string_view content_length =
+			"\r\nContent-Length: ";
+		static constexpr std::string_view end = "\r\n\r\n";
+
+		std::size_t count = 0;
+		if (_status_line_size > 0)
+			out[count++] = asio::buffer(_status_line.data(), _status_line_size);
+		else
+			out[count++] = asio::buffer(_text->status_line);
+
+		out[count++] = asio::buffer(_text->fields);
+		out[count++] = asio::buffer(_date);
+		if (!_location.empty()) {
+			out[count++] = asio::buffer(location);
+			out[count++] = asio::buffer(_location);
+		}
+
+		if (_length_size > 0) {
+			out[count++] = asio::buffer(content_length);
+			out[count++] = asio::buffer(_length.data(), _length_size);
+		}
+
+		if (!_connection.empty())
+			out[count++] = asio::buffer(_connection);
+
+		out[count++] = asio::buffer(end);
+		if (_send_body && (content().size() > 0))
+			out[count++] = content();
+
+		return count;
+	}
+
+	// An owned body moves along with the message, so its buffer is made anew
+	asio::const_buffer content() const {
+		if (_content_owner)
+			return _content;
+
+		return asio::buffer(_own_body ? _body : _text->body);
+	}
+
+	std::shared_ptr<const canned_text> _text;
+	std::array<char, 29> _date;
+	std::array<char, 64> _status_line;
+	std::size_t _status_line_size = 0;
+	std::array<char, 20> _length;
+	std::size_t _length_size = 0;
+	std::string _location;
+	std::string_view _connection;
+	std::string _body;
+	bool _own_body = false;
+	std::shared_ptr<const void> _content_owner;
+	asio::const_buffer _content;
+	bool _send_body = false;
+	std::size_t _size = 0;
+	std::size_t _written = 0;
+};
+
+/**
+ * Response serialized once and sent any number of times. The status line,
+ * the fixed fields and the body are kept as immutable text shared by all
+ * responses made from it; only Date, Location, Content-Length and
+ * Connection are set per response, next to the shared text rather than
+ * in a copy of it. A response goes out as a single scatter-gather write,
+ * i.e. one writev(2) on plain TCP.
+ *
+ * Canned responses are immutable and may be used from any thread. Copies
+ * share the serialized text.
+ */
+class canned_response {
+public:
+	/**
+	 * Takes the status, fields and body of message. Its Date, Location,
+	 * Content-Length, Transfer-Encoding and connection fields are dropped,
+	 * as these are set per response.
+	 */
+	template <class body>
+	explicit canned_response(const beast::http::response<body> &message) {
+		static_assert(std::is_same_v<body, beast::http::empty_body> ||
+						  std::is_same_v<body, beast::http::string_body>,
+					  "Only empty and string bodies can be canned");
+
+		auto text = std::make_shared<canned_text>();
+		text->status = message.result();
+		text->status_line.append("HTTP/1.1 ")
+			.append(std::to_string(message.result_int()))
+			.append(" ")
+			.append(message.reason())
+			.append("\r\n");
+
+		for (const auto &field : message) {
+			switch (field.name()) {
+			case beast::http::field::date:
+			case beast::http::field::location:
+			case beast::http::field::content_length:
+			case beast::http::field::transfer_encoding:
+			case beast::http::field::connection:
+			case beast::http::field::keep_alive:
+				continue;
+			default:
+				break;
+			}
+
+			text->fields.append(field.name_string())
+				.append(": ")
+				.append(field.value())
+				.append("\r\n");
+		}
+
+		text->fields.append("Date: ");
+		if constexpr (std::is_same_v<body, beast::http::string_body>)
+			text->body = message.body();
+
+		_text = std::move(text);
+	}
+
+	/**
+	 * Makes the response to req. The connection stays open as req asks;
+	 * responses to HEAD requests have no body.
+	 */
+	template <class body, class fields_type>
+	canned_message operator()(const beast::http::request<body, fields_type> &req,
+							  canned_fields fields = {}) const {
+		std::string_view connection;
+		if (!req.keep_alive())
+			connection = canned_message::close;
+		else if (req.version() < 11)
+			connection = canned_message::keep_alive;
+
+		return canned_message{_text, std::move(fields), connection,
+							  req.method() == beast::http::verb::head};
+	}
+
+	beast::http::status status() const { return _text->status; }
+
+private:
+	std::shared_ptr<const canned_text> _text;
+};
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_CANNED_RESPONSE_HPP_ */
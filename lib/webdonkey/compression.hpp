@@ -0,0 +1,292 @@
+/*
+ * compression.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_COMPRESSION_HPP_
+#define LIB_WEBDONKEY_COMPRESSION_HPP_
+
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <boost/crc.hpp>
+#include <charconv>
+#include <fcntl.h>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+#include <webdonkey/conditional.hpp>
+#include <webdonkey/defs.hpp>
+#include <webdonkey/file_cache.hpp>
+
+namespace webdonkey {
+
+/**
+ * Precompressed siblings looked up next to a file, in order of preference.
+ */
+struct precompressed_variant {
+	std::string_view suffix;
+	std::string_view coding;
+};
+
+inline constexpr precompressed_variant precompressed_variants[] = {
+	{".br", "br"}, {".zst", "zstd"}, {".gz", "gzip"}};
+
+/**
+ * True for MIME types which usually shrink considerably when compressed.
+ */
+inline bool compressible(std::string_view content_type) {
+	return content_type.starts_with("text/") ||
+		   (content_type == "application/javascript") ||
+		   (content_type == "application/json") ||
+		   (content_type == "application/xml") ||
+		   (content_type == "image/svg+xml");
+}
+
+/**
+ * Checks whether an Accept-Encoding value admits a content coding.
+ * Codings with q=0 are refused, "*" covers codings not listed explicitly.
+ */
+inline bool accepts_encoding(std::string_view accept_encoding,
+							 std::string_view coding) {
+	std::optional<bool> wildcard;
+	while (!accept_encoding.empty()) {
+		std::size_t comma = accept_encoding.find(',');
+		std::string_view item = accept_encoding.substr(0, comma);
+		accept_encoding = (comma == std::string_view::npos)
+							  ? std::string_view{}
+							  : accept_encoding.substr(comma + 1);
+
+		std::size_t semicolon = item.find(';');
+		std::string_view name = item.substr(0, semicolon);
+		std::size_t first = name.find_first_not_of(" \t");
+		if (first == std::string_view::npos)
+			continue;
+		name = name.substr(first, name.find_last_not_of(" \t") - first + 1);
+
+		bool allowed = true;
+		if (semicolon != std::string_view::npos) {
+			std::string_view params = item.substr(semicolon + 1);
+			std::size_t q = params.find("q=");
+			if (q != std::string_view::npos) {
+				params = params.substr(q + 2);
+				double weight = 1.0;
+				std::from_chars(params.data(), params.data() + params.size(),
+								weight);
+				allowed = (weight > 0.0);
+			}
+		}
+
+		if (beast::iequals(name, coding))
+			return allowed;
+
+		if (name == "*")
+			wildcard = allowed;
+	}
+
+	return wildcard.value_or(false);
+}
+
+/**
+ * Compresses data into the gzip format (RFC 1952).
+ */
+inline std::string gzip(std::string_view data, int level = 6) {
+	namespace zlib = beast::zlib;
+
+	static constexpr char header[] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3};
+	static constexpr std::size_t header_size = sizeof(header);
+
+	zlib::deflate_stream deflater;
+	deflater.reset(level, 15, 8, zlib::Strategy::normal);
+
+	std::size_t bound = deflater.upper_bound(data.size());
+	std::string out(header_size + bound + 8, '\0');
+	std::copy(std::begin(header), std::end(header), out.begin());
+
+	zlib::z_params stream;
+	stream.next_in = data.data();
+	stream.avail_in = data.size();
+	stream.next_out = out.data() + header_size;
+	stream.avail_out = bound;
+
+	beast::error_code ec;
+	deflater.write(stream, zlib::Flush::finish, ec);
+	if (ec && (ec != zlib::error::end_of_stream))
+		throw boost::system::system_error{ec};
+
+	std::size_t size = header_size + stream.total_out;
+	boost::crc_32_type crc;
+	crc.process_bytes(data.data(), data.size());
+
+	std::uint32_t trailer[] = {static_cast<std::uint32_t>(crc.checksum()),
+							   static_cast<std::uint32_t>(data.size())};
+	for (std::uint32_t value : trailer)
+		for (int byte = 0; byte < 4; ++byte)
+			out[size++] = static_cast<char>((value >> (8 * byte)) & 0xff);
+
+	out.resize(size);
+	return out;
+}
+
+struct compression_options {
+	// Total size of compressed content kept in memory
+	std::size_t max_size = 32 * 1024 * 1024;
+
+	// Files outside of these bounds are not compressed
+	std::size_t min_file_size = 256;
+	std::size_t max_file_size = 8 * 1024 * 1024;
+
+	// zlib level; beyond 6 the gain is small for the CPU time spent
+	int level = 6;
+};
+
+/**
+ * Cache of gzip-compressed file variants. A variant is produced once, in
+ * the background, on the first lookup; until it is ready lookups return
+ * null and the file is served as is. Variants of modified files are
+ * dropped and produced again.
+ *
+ * Compression runs on the executor passed in, which should be apart from
+ * the one serving requests, so that it does not hold them up.
+ */
+class compression_cache
+	: public std::enable_shared_from_this<compression_cache> {
+public:
+	static constexpr std::string_view coding = "gzip";
+
+	explicit compression_cache(asio::any_io_executor executor,
+							   const compression_options &options = {}) :
+		_executor{executor}, _options{options} {}
+
+	compression_cache(const compression_cache &) = delete;
+	compression_cache(compression_cache &&) = delete;
+	compression_cache &operator=(const compression_cache &) = delete;
+	compression_cache &operator=(compression_cache &&) = delete;
+
+	/**
+	 * Returns the compressed variant of the file described by st, or
+	 * null if it is not available (yet).
+	 */
+	cached_file_ptr lookup(const std::filesystem::path &path,
+						   const struct stat &st,
+						   std::string_view content_type);
+
+	// Total size of compressed content
+	std::size_t size() const {
+		std::lock_guard<std::mutex> lock{_mutex};
+		return _entries.size();
+	}
+
+private:
+	void compress(const std::string &key, const struct stat &st,
+				  const std::string &content_type);
+
+	void insert(const std::string &key, cached_file_ptr file);
+
+	asio::any_io_executor _executor;
+	compression_options _options;
+	file_cache_internals::entry_table _entries;
+	std::unordered_set<std::string> _scheduled;
+	mutable std::mutex _mutex;
+};
+
+//==============================================================================
+
+inline cached_file_ptr
+compression_cache::lookup(const std::filesystem::path &path,
+						  const struct stat &st,
+						  std::string_view content_type) {
+	if ((static_cast<std::size_t>(st.st_size) < _options.min_file_size) ||
+		(static_cast<std::size_t>(st.st_size) > _options.max_file_size))
+		return nullptr;
+
+	const std::string &key = path.native();
+	{
+		std::lock_guard<std::mutex> lock{_mutex};
+		cached_file_ptr variant = _entries.find(key);
+		if (variant && variant->same_file(st))
+			return variant;
+
+		if (!_scheduled.insert(key).second)
+			return nullptr;
+	}
+
+	std::weak_ptr<compression_cache> weak_self = weak_from_this();
+	asio::post(_executor, [weak_self, key = key, st,
+						   content_type = std::string{content_type}]() {
+		if (std::shared_ptr<compression_cache> self = weak_self.lock())
+			self->compress(key, st, content_type);
+	});
+
+	return nullptr;
+}
+
+inline void compression_cache::compress(const std::string &key,
+										const struct stat &st,
+										const std::string &content_type) {
+	cached_file_ptr variant;
+	int fd = ::open(key.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat current;
+	if ((fd >= 0) && (::fstat(fd, &current) == 0) &&
+		(current.st_ino == st.st_ino) && (current.st_size == st.st_size) &&
+		(current.st_mtim.tv_sec == st.st_mtim.tv_sec) &&
+		(current.st_mtim.tv_nsec == st.st_mtim.tv_nsec)) {
+		std::string content(static_cast<std::size_t>(st.st_size), '\0');
+		std::size_t offset = 0;
+		while (offset < content.size()) {
+			ssize_t n = ::read(fd, content.data() + offset,
+							   content.size() - offset);
+			if (n <= 0)
+				break;
+			offset += static_cast<std::size_t>(n);
+		}
+
+		if (offset == content.size()) {
+			std::string compressed = gzip(content, _options.level);
+
+			// Variants not worth the decompression are not kept
+			if (compressed.size() < content.size()) {
+				std::string etag = entity_tag(st);
+				etag.insert(etag.size() - 1, "-gzip");
+
+				cached_file::header_type header;
+				header.set(beast::http::field::content_type, content_type);
+				header.set(beast::http::field::content_encoding, coding);
+				header.set(beast::http::field::content_length,
+						   std::to_string(compressed.size()));
+				header.set(beast::http::field::etag, etag);
+				header.set(beast::http::field::last_modified,
+						   http_date(st.st_mtim.tv_sec));
+				variant = cached_file::make(std::move(compressed),
+											std::move(header), st);
+			}
+		}
+	}
+
+	if (fd >= 0)
+		::close(fd);
+
+	if (variant)
+		insert(key, variant);
+
+	std::lock_guard<std::mutex> lock{_mutex};
+	_scheduled.erase(key);
+}
+
+inline void compression_cache::insert(const std::string &key,
+									  cached_file_ptr file) {
+	if (file->size() > _options.max_size)
+		return;
+
+	std::lock_guard<std::mutex> lock{_mutex};
+	_entries.insert(key, std::move(file), _options.max_size);
+}
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_COMPRESSION_HPP_ */
@@ -0,0 +1,247 @@
+/*
+ * conditional.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_CONDITIONAL_HPP_
+#define LIB_WEBDONKEY_CONDITIONAL_HPP_
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <vector>
+#include <webdonkey/defs.hpp>
+
+namespace webdonkey {
+
+/**
+ * Builds an entity tag from inode, size and modification time. The tag is
+ * weak if the file was modified within the last second, since it could
+ * change again without its modification time changing.
+ */
+inline std::string entity_tag(const struct stat &st) {
+	char tag[80];
+	int length = std::snprintf(
+		tag, sizeof(tag), "\"%llx-%llx-%llx.%lx\"",
+		static_cast<unsigned long long>(st.st_ino),
+		static_cast<unsigned long long>(st.st_size),
+		static_cast<unsigned long long>(st.st_mtim.tv_sec),
+		static_cast<unsigned long>(st.st_mtim.tv_nsec));
+
+	std::string result{tag, static_cast<std::size_t>(length)};
+	if (std::time(nullptr) - st.st_mtim.tv_sec < 1)
+		result.insert(0, "W/");
+
+	return result;
+}
+
+/**
+ * Formats time as IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+ */
+inline std::string http_date(std::time_t time) {
+	static constexpr const char *days[] = {"Sun", "Mon", "Tue", "Wed",
+										   "Thu", "Fri", "Sat"};
+	static constexpr const char *months[] = {"Jan", "Feb", "Mar", "Apr",
+											 "May", "Jun", "Jul", "Aug",
+											 "Sep", "Oct", "Nov", "Dec"};
+	std::tm tm;
+	gmtime_r(&time, &tm);
+
+	char date[32];
+	int length = std::snprintf(date, sizeof(date),
+							   "%s, %02d %s %04d %02d:%02d:%02d GMT",
+							   days[tm.tm_wday], tm.tm_mday, months[tm.tm_mon],
+							   tm.tm_year + 1900, tm.tm_hour, tm.tm_min,
+							   tm.tm_sec);
+	return std::string{date, static_cast<std::size_t>(length)};
+}
+
+/**
+ * Parses an IMF-fixdate. Obsolete date formats are not recognized.
+ */
+inline std::optional<std::time_t> parse_http_date(std::string_view value) {
+	static constexpr std::string_view months = "JanFebMarAprMayJunJulAugSepOct"
+											   "NovDec";
+	if (value.size() != 29)
+		return std::nullopt;
+
+	std::string date{value};
+	std::tm tm{};
+	char month[4] = {};
+	if (std::sscanf(date.c_str(), "%*3s, %2d %3s %4d %2d:%2d:%2d GMT",
+					&tm.tm_mday, month, &tm.tm_year, &tm.tm_hour, &tm.tm_min,
+					&tm.tm_sec) != 6)
+		return std::nullopt;
+
+	std::size_t month_pos = months.find(month);
+	if ((month_pos == std::string_view::npos) || (month_pos % 3 != 0))
+		return std::nullopt;
+
+	tm.tm_mon = static_cast<int>(month_pos / 3);
+	tm.tm_year -= 1900;
+	return timegm(&tm);
+}
+
+/**
+ * Weak comparison of an entity tag against an If-None-Match list.
+ */
+inline bool etag_matches(std::string_view tag_list, std::string_view etag) {
+	auto opaque = [](std::string_view tag) {
+		return tag.starts_with("W/") ? tag.substr(2) : tag;
+	};
+
+	std::string_view tag = opaque(etag);
+	while (!tag_list.empty()) {
+		std::size_t comma = tag_list.find(',');
+		std::string_view item = tag_list.substr(0, comma);
+		tag_list = (comma == std::string_view::npos)
+					   ? std::string_view{}
+					   : tag_list.substr(comma + 1);
+
+		std::size_t first = item.find_first_not_of(" \t");
+		if (first == std::string_view::npos)
+			continue;
+
+		item = item.substr(first, item.find_last_not_of(" \t") - first + 1);
+		if ((item == "*") || (opaque(item) == tag))
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Evaluates If-None-Match and, in its absence, If-Modified-Since.
+ * @return true if a 304 response should be sent.
+ */
+template <class allocator_type>
+bool not_modified(const beast::http::basic_fields<allocator_type> &request,
+				  std::string_view etag, std::time_t modified) {
+	std::string_view if_none_match = request[beast::http::field::if_none_match];
+	if (!if_none_match.empty())
+		return etag_matches(if_none_match, etag);
+
+	std::string_view if_modified_since =
+		request[beast::http::field::if_modified_since];
+	if (if_modified_since.empty())
+		return false;
+
+	std::optional<std::time_t> since = parse_http_date(if_modified_since);
+	return since.has_value() && (modified <= since.value());
+}
+
+/**
+ * Checks the If-Range precondition. Entity tags are compared strongly.
+ * @return true if the Range header should be honored.
+ */
+template <class allocator_type>
+bool range_applies(const beast::http::basic_fields<allocator_type> &request,
+				   std::string_view etag, std::time_t modified) {
+	std::string_view if_range = request[beast::http::field::if_range];
+	if (if_range.empty())
+		return true;
+
+	if (if_range.starts_with('"'))
+		return !etag.starts_with("W/") && (if_range == etag);
+
+	std::optional<std::time_t> date = parse_http_date(if_range);
+	return date.has_value() && (modified == date.value());
+}
+
+struct byte_range {
+	std::uint64_t first;
+	std::uint64_t last;
+
+	std::uint64_t size() const { return last - first + 1; }
+};
+
+/**
+ * Parses a Range header value against a representation of the given size.
+ * @return std::nullopt if the header is malformed and must be ignored,
+ * an empty list if no range is satisfiable.
+ */
+inline std::optional<std::vector<byte_range>>
+parse_ranges(std::string_view value, std::uint64_t size) {
+	static constexpr std::string_view unit = "bytes=";
+	if ((value.size() < unit.size()) ||
+		!beast::iequals(value.substr(0, unit.size()), unit))
+		return std::nullopt;
+
+	auto parse_number =
+		[](std::string_view text) -> std::optional<std::uint64_t> {
+		std::uint64_t number = 0;
+		auto [end, ec] =
+			std::from_chars(text.data(), text.data() + text.size(), number);
+		if ((ec != std::errc{}) || (end != text.data() + text.size()))
+			return std::nullopt;
+		return number;
+	};
+
+	std::vector<byte_range> ranges;
+	bool parsed = false;
+	value.remove_prefix(unit.size());
+	while (!value.empty()) {
+		std::size_t comma = value.find(',');
+		std::string_view spec = value.substr(0, comma);
+		value = (comma == std::string_view::npos) ? std::string_view{}
+												  : value.substr(comma + 1);
+
+		std::size_t first_char = spec.find_first_not_of(" \t");
+		if (first_char == std::string_view::npos)
+			continue;
+
+		spec = spec.substr(first_char,
+						   spec.find_last_not_of(" \t") - first_char + 1);
+		std::size_t dash = spec.find('-');
+		if (dash == std::string_view::npos)
+			return std::nullopt;
+
+		parsed = true;
+		std::string_view first_text = spec.substr(0, dash);
+		std::string_view last_text = spec.substr(dash + 1);
+		if (first_text.empty()) {
+			// Suffix range: the last N bytes
+			std::optional<std::uint64_t> suffix = parse_number(last_text);
+			if (!suffix)
+				return std::nullopt;
+
+			if ((suffix.value() > 0) && (size > 0))
+				ranges.push_back(
+					{size - std::min(suffix.value(), size), size - 1});
+			continue;
+		}
+
+		std::optional<std::uint64_t> first = parse_number(first_text);
+		if (!first)
+			return std::nullopt;
+
+		std::uint64_t last = size - 1;
+		if (!last_text.empty()) {
+			std::optional<std::uint64_t> last_pos = parse_number(last_text);
+			if (!last_pos || (last_pos.value() < first.value()))
+				return std::nullopt;
+
+			last = std::min(last_pos.value(), last);
+		}
+
+		if (first.value() < size)
+			ranges.push_back({first.value(), last});
+	}
+
+	// At least one range-spec is required
+	if (!parsed)
+		return std::nullopt;
+
+	return ranges;
+}
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_CONDITIONAL_HPP_ */
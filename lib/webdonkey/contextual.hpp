@@ -8,23 +8,42 @@
 #ifndef LIB_WEBDONKEY_CONTEXTUAL_HPP_
 #define LIB_WEBDONKEY_CONTEXTUAL_HPP_
 
-#include <any>
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <typeindex>
-#include <unordered_map>
+#include <vector>
 
 namespace webdonkey {
 
 template <class context, typename instance_type> class managed_ptr;
+template <typename instance_type> class pinned_ptr;
 template <class context, typename instance_type> class shared_object;
 template <class context, typename instance_type> class shared_factory;
 
 template <class context, typename instance_type>
 using managed_getter = std::function<managed_ptr<context, instance_type>()>;
 
+/**
+ * Tag allowing registration after the registry has been frozen.
+ */
+struct late_registration_t {
+	explicit late_registration_t() = default;
+};
+
+inline constexpr late_registration_t late_registration{};
+
+/**
+ * Per-context registry of instance getters. Every registered type gets a
+ * slot of its own which is never changed once published, so lookups take
+ * no lock. Shared objects are resolved without calling a type-erased
+ * getter.
+ *
+ * Registration is meant to happen at startup. freeze() closes it, after
+ * which only explicitly late registrations are accepted.
+ */
 template <class context> class shared_registry {
 public:
 	shared_registry(const shared_registry<context> &) = delete;
@@ -45,14 +64,57 @@ public:
 	template <typename instance_type>
 	void register_getter(const managed_getter<context, instance_type> &getter);
 
+	template <typename instance_type>
+	void register_getter(const managed_getter<context, instance_type> &getter,
+						 late_registration_t);
+
+	/**
+	 * Registers a shared object, resolved to a weak reference.
+	 */
+	template <typename instance_type>
+	void register_shared(const std::weak_ptr<instance_type> &instance);
+
+	template <typename instance_type>
+	void register_shared(const std::weak_ptr<instance_type> &instance,
+						 late_registration_t);
+
+	/**
+	 * Closes registration but for late registrations.
+	 */
+	void freeze() { _frozen.store(true, std::memory_order_release); }
+
+	bool frozen() const { return _frozen.load(std::memory_order_acquire); }
+
+	/**
+	 * Lock-free: a single atomic load, and for factories, a call of the
+	 * factory.
+	 */
 	template <typename instance_type>
 	managed_ptr<context, instance_type> instance();
 
 private:
 	shared_registry() = default;
 
-	std::unordered_map<std::type_index, std::any> _getters;
-	std::mutex _getters_mutex;
+	template <typename instance_type> struct entry {
+		// Set for shared objects
+		std::weak_ptr<instance_type> shared;
+
+		// Set for factories
+		managed_getter<context, instance_type> getter;
+	};
+
+	template <typename instance_type> struct slot {
+		static inline std::atomic<const entry<instance_type> *> current =
+			nullptr;
+	};
+
+	template <typename instance_type>
+	void publish(entry<instance_type> &&created);
+
+	// Owns the published entries, which live as long as the registry
+	std::vector<std::shared_ptr<const void>> _entries;
+	std::mutex _registration_mutex;
+	std::atomic<bool> _frozen = false;
 };
 
 template <class context, typename instance_type> class managed_ptr {
@@ -77,8 +139,20 @@ public:
 
 	managed_ptr() = default;
 
+	/**
+	 * For shared objects, every call locks a weak reference, and nothing
+	 * keeps the object alive once it returns. Use pin() to access it
+	 * repeatedly.
+	 */
 	instance_type *get() const { return (this->*_getter)(); }
 
+	/**
+	 * Resolves the instance once and keeps it alive for as long as the
+	 * returned pointer. The pointer is empty if a shared object has
+	 * expired.
+	 */
+	pinned_ptr<instance_type> pin() const;
+
 	instance_type &operator*() const { return *get(); }
 
 	instance_type *operator->() const { return get(); }
@@ -97,6 +171,30 @@ private:
 	std::weak_ptr<instance_type> _shared;
 };
 
+/**
+ * Strong reference to a resolved instance, cheap to dereference.
+ */
+template <typename instance_type> class pinned_ptr {
+public:
+	pinned_ptr() = default;
+
+	explicit pinned_ptr(std::shared_ptr<instance_type> instance) :
+		_instance{std::move(instance)} {}
+
+	instance_type *get() const { return _instance.get(); }
+
+	instance_type &operator*() const { return *_instance; }
+
+	instance_type *operator->() const { return _instance.get(); }
+
+	explicit operator bool() const { return static_cast<bool>(_instance); }
+
+	void reset() { _instance.reset(); }
+
+private:
+	std::shared_ptr<instance_type> _instance;
+};
+
 template <class context, typename instance_type> class shared_object {
 public:
 	using instance_ptr = std::shared_ptr<instance_type>;
@@ -110,7 +208,14 @@ public:
 
 	explicit shared_object(instance_ptr instance) :
 		_instance{instance} {
-		shared_registry<context>::shared().register_getter(getter());
+		shared_registry<context>::shared().register_shared(
+			std::weak_ptr<instance_type>{_instance});
+	}
+
+	shared_object(instance_ptr instance, late_registration_t late) :
+		_instance{instance} {
+		shared_registry<context>::shared().register_shared(
+			std::weak_ptr<instance_type>{_instance}, late);
 	}
 
 	instance_type &operator*() const { return *_instance; }
@@ -135,6 +240,15 @@ public:
 		shared_registry<context>::shared().register_getter(getter());
 	}
 
+	template <typename factory>
+	shared_factory(factory f, late_registration_t late) :
+		_getter{[f]() -> managed_ptr<context, instance_type> {
+			instance_ptr instance = f();
+			return managed_ptr<context, instance_type>{instance};
+		}} {
+		shared_registry<context>::shared().register_getter(getter(), late);
+	}
+
 private:
 	managed_getter<context, instance_type> _getter;
 };
@@ -165,6 +279,19 @@ public:
 	virtual ~missing_getter() = default;
 };
 
+class registry_frozen : public std::runtime_error {
+public:
+	registry_frozen() :
+		std::runtime_error{"Registration after the registry was frozen."} {}
+
+	registry_frozen(const registry_frozen &) = default;
+	registry_frozen(registry_frozen &&) = default;
+	registry_frozen &operator=(const registry_frozen &) = default;
+	registry_frozen &operator=(registry_frozen &&) = default;
+
+	virtual ~registry_frozen() = default;
+};
+
 class lazy_resolution_failure : public std::runtime_error {
 public:
 	lazy_resolution_failure() :
@@ -179,26 +306,78 @@ public:
 	virtual ~lazy_resolution_failure() = default;
 };
 
+template <class context>
+template <typename instance_type>
+void shared_registry<context>::publish(entry<instance_type> &&created) {
+	std::lock_guard<std::mutex> registration_lock{_registration_mutex};
+	if (slot<instance_type>::current.load(std::memory_order_relaxed) !=
+		nullptr)
+		throw duplicate_getter{};
+
+	auto owned = std::make_shared<const entry<instance_type>>(
+		std::move(created));
+	_entries.push_back(owned);
+	slot<instance_type>::current.store(owned.get(), std::memory_order_release);
+}
+
 template <class context>
 template <typename instance_type>
 void shared_registry<context>::register_getter(
 	const managed_getter<context, instance_type> &getter) {
-	std::lock_guard<std::mutex> getters_lock{_getters_mutex};
-	std::type_index id = getter_id<instance_type>();
-	if (_getters.contains(id))
-		throw duplicate_getter{};
-	_getters[id] = getter;
+	if (frozen())
+		throw registry_frozen{};
+
+	register_getter(getter, late_registration);
+}
+
+template <class context>
+template <typename instance_type>
+void shared_registry<context>::register_getter(
+	const managed_getter<context, instance_type> &getter,
+	late_registration_t) {
+	publish(entry<instance_type>{{}, getter});
+}
+
+template <class context>
+template <typename instance_type>
+void shared_registry<context>::register_shared(
+	const std::weak_ptr<instance_type> &instance) {
+	if (frozen())
+		throw registry_frozen{};
+
+	register_shared(instance, late_registration);
+}
+
+template <class context>
+template <typename instance_type>
+void shared_registry<context>::register_shared(
+	const std::weak_ptr<instance_type> &instance, late_registration_t) {
+	publish(entry<instance_type>{instance, {}});
 }
 
 template <class context>
 template <typename instance_type>
 managed_ptr<context, instance_type> shared_registry<context>::instance() {
-	std::lock_guard<std::mutex> getters_lock{_getters_mutex};
-	std::type_index id = getter_id<instance_type>();
-	if (!_getters.contains(id))
+	const entry<instance_type> *found =
+		slot<instance_type>::current.load(std::memory_order_acquire);
+	if (found == nullptr)
 		throw missing_getter{};
-	return (*std::any_cast<managed_getter<context, instance_type>>(
-		&_getters[id]))();
+
+	if (found->getter)
+		return found->getter();
+
+	return managed_ptr<context, instance_type>{found->shared};
+}
+
+template <class context, typename instance_type>
+pinned_ptr<instance_type> managed_ptr<context, instance_type>::pin() const {
+	if (_getter == &managed_ptr<context, instance_type>::get_lazy)
+		get_lazy();
+
+	if (_getter == &managed_ptr<context, instance_type>::get_shared)
+		return pinned_ptr<instance_type>{_shared.lock()};
+
+	return pinned_ptr<instance_type>{_local};
 }
 
 template <class context, typename instance_type>
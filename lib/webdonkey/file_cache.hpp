@@ -0,0 +1,513 @@
+/*
+ * file_cache.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_FILE_CACHE_HPP_
+#define LIB_WEBDONKEY_FILE_CACHE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <system_error>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include <webdonkey/canned_response.hpp>
+#include <webdonkey/conditional.hpp>
+#include <webdonkey/defs.hpp>
+#include <webdonkey/utils.hpp>
+
+namespace webdonkey {
+
+struct file_cache_options {
+	// Total amount of cached content
+	std::size_t max_size = 64 * 1024 * 1024;
+
+	// Files up to this size are copied to memory, larger ones are mapped
+	std::size_t max_inline_size = 64 * 1024;
+
+	// Files larger than this are never cached
+	std::size_t max_entry_size = 16 * 1024 * 1024;
+
+	/*
+	 * Minimum time between two checks of a cached file against the
+	 * file system. Zero means checking on every lookup.
+	 */
+	std::chrono::milliseconds revalidate_interval{1000};
+};
+
+namespace file_cache_internals {
+class entry_table;
+} // namespace file_cache_internals
+
+/**
+ * Immutable content of a cached file along with a response header
+ * prepared for it.
+ */
+class cached_file {
+public:
+	using header_type = beast::http::response_header<>;
+	using clock = std::chrono::steady_clock;
+
+	cached_file(const cached_file &) = delete;
+	cached_file(cached_file &&) = delete;
+	cached_file &operator=(const cached_file &) = delete;
+	cached_file &operator=(cached_file &&) = delete;
+
+	~cached_file() {
+		if (_mapping != nullptr)
+			::munmap(_mapping, _size);
+	}
+
+	const char *data() const { return _data; }
+	std::size_t size() const { return _size; }
+
+	bool mapped() const { return (_mapping != nullptr); }
+
+	/**
+	 * Response header with Content-Type, Content-Length and validators
+	 * already set.
+	 */
+	const header_type &header() const { return _header; }
+
+	const struct stat &file_stat() const { return _stat; }
+
+	/**
+	 * Response header canned for this content by the responder identified
+	 * by owner, if that responder made one.
+	 */
+	std::optional<canned_response> canned(const void *owner) const {
+		std::shared_ptr<const canned_header> header = _canned.load();
+		if (!header || (header->owner != owner))
+			return std::nullopt;
+
+		return header->response;
+	}
+
+	/**
+	 * Keeps a canned response header for this content. Only the last
+	 * responder to set one has it kept.
+	 */
+	void canned(const void *owner, const canned_response &response) const {
+		_canned.store(std::make_shared<const canned_header>(
+			canned_header{owner, response}));
+	}
+
+	/**
+	 * True if st describes the same version of the file this content
+	 * was taken from.
+	 */
+	bool same_file(const struct stat &st) const {
+		return (st.st_ino == _stat.st_ino) && (st.st_dev == _stat.st_dev) &&
+			   (st.st_size == _stat.st_size) &&
+			   (st.st_mtim.tv_sec == _stat.st_mtim.tv_sec) &&
+			   (st.st_mtim.tv_nsec == _stat.st_mtim.tv_nsec);
+	}
+
+	/**
+	 * Loads a regular file. Returns null if the file cannot be opened
+	 * or is larger than options.max_entry_size; ec is only set in
+	 * the former case.
+	 */
+	static std::shared_ptr<cached_file>
+	load(const std::filesystem::path &path, const file_cache_options &options,
+		 std::error_code &ec);
+
+	/**
+	 * Wraps content produced in memory, e.g. a compressed variant of the
+	 * file described by st.
+	 */
+	static std::shared_ptr<cached_file>
+	make(std::string &&content, header_type &&header, const struct stat &st) {
+		std::shared_ptr<cached_file> file{new cached_file{}};
+		file->_content = std::move(content);
+		file->_data = file->_content.data();
+		file->_size = file->_content.size();
+		file->_header = std::move(header);
+		file->_stat = st;
+		return file;
+	}
+
+private:
+	friend class file_cache;
+	friend class compression_cache;
+	friend class file_cache_internals::entry_table;
+
+	struct canned_header {
+		const void *owner;
+		canned_response response;
+	};
+
+	cached_file() = default;
+
+	const char *_data = nullptr;
+	std::size_t _size = 0;
+	void *_mapping = nullptr;
+	std::string _content;
+	header_type _header;
+	struct stat _stat {};
+
+	mutable std::atomic<clock::rep> _checked_at{0};
+	// Set by lookups, cleared by the eviction hand passing by
+	mutable std::atomic<bool> _referenced{true};
+	mutable std::atomic<std::shared_ptr<const canned_header>> _canned;
+};
+
+using cached_file_ptr = std::shared_ptr<const cached_file>;
+
+namespace file_cache_internals {
+
+/*
+ * Cached files keyed by path, with their total size. Entries are evicted
+ * in the manner of CLOCK: a hand sweeps over them, sparing those referenced
+ * since it last passed by and evicting the first one which was not, so
+ * eviction costs O(1) amortized rather than a scan of all entries.
+ * Not synchronized, except that find() may run concurrently with itself.
+ */
+class entry_table {
+public:
+	// Marks the file found as referenced
+	cached_file_ptr find(const std::string &key) const {
+		auto it = _entries.find(key);
+		if (it == _entries.end())
+			return nullptr;
+
+		it->second.file->_referenced.store(true, std::memory_order_relaxed);
+		return it->second.file;
+	}
+
+	void erase(const std::string &key) {
+		auto it = _entries.find(key);
+		if (it != _entries.end())
+			erase(it);
+	}
+
+	// Erases the entry of key only if it still holds file
+	void erase(const std::string &key, const cached_file &file) {
+		auto it = _entries.find(key);
+		if ((it != _entries.end()) && (it->second.file.get() == &file))
+			erase(it);
+	}
+
+	/**
+	 * Adds or replaces the entry of key, evicting others while the total
+	 * size would exceed max_size, which file must not exceed by itself.
+	 */
+	void insert(const std::string &key, cached_file_ptr file,
+				std::size_t max_size) {
+		erase(key);
+		while (_size + file->size() > max_size)
+			evict();
+
+		_size += file->size();
+		auto [it, inserted] =
+			_entries.emplace(key, entry{std::move(file), _ring.size()});
+		_ring.push_back(&*it);
+	}
+
+	void clear() {
+		_entries.clear();
+		_ring.clear();
+		_hand = 0;
+		_size = 0;
+	}
+
+	// Total size of the files
+	std::size_t size() const { return _size; }
+
+private:
+	struct entry {
+		cached_file_ptr file;
+
+		// Position in the ring
+		std::size_t slot;
+	};
+
+	using entry_map = std::unordered_map<std::string, entry>;
+
+	void evict() {
+		for (;;) {
+			if (_hand >= _ring.size())
+				_hand = 0;
+
+			const entry &candidate = _ring[_hand]->second;
+			if (!candidate.file->_referenced.exchange(
+					false, std::memory_order_relaxed)) {
+				erase(_entries.find(_ring[_hand]->first));
+				return;
+			}
+
+			++_hand;
+		}
+	}
+
+	void erase(entry_map::iterator it) {
+		// The last entry of the ring moves to the vacated slot
+		const std::size_t slot = it->second.slot;
+		_ring[slot] = _ring.back();
+		_ring[slot]->second.slot = slot;
+		_ring.pop_back();
+
+		_size -= it->second.file->size();
+		_entries.erase(it);
+	}
+
+	entry_map _entries;
+
+	// Map nodes, which stay in place when the map grows
+	std::vector<entry_map::value_type *> _ring;
+	std::size_t _hand = 0;
+	std::size_t _size = 0;
+};
+
+} // namespace file_cache_internals
+
+/**
+ * Size-limited cache of file contents keyed by path. Entries are checked
+ * against the file system at most once per revalidate_interval and are
+ * dropped as soon as the file changes. Entries not used lately are
+ * evicted when the size limit is reached.
+ *
+ * Mapped files must be replaced atomically (e.g. by rename) rather than
+ * truncated in place while being served.
+ */
+class file_cache {
+public:
+	explicit file_cache(const file_cache_options &options = {}) :
+		_options{options} {}
+
+	file_cache(const file_cache &) = delete;
+	file_cache(file_cache &&) = delete;
+	file_cache &operator=(const file_cache &) = delete;
+	file_cache &operator=(file_cache &&) = delete;
+
+	/**
+	 * Returns cached content of a file, loading it if necessary.
+	 * Returns null if the file cannot be cached.
+	 */
+	cached_file_ptr lookup(const std::filesystem::path &path);
+
+	/**
+	 * True if a lookup within the last revalidate_interval found no
+	 * such file.
+	 */
+	bool missing(const std::filesystem::path &path) const {
+		std::shared_lock<std::shared_mutex> lock{_mutex};
+		auto it = _missing.find(path.native());
+		return (it != _missing.end()) &&
+			   (now() - it->second < revalidate_ticks());
+	}
+
+	void invalidate(const std::filesystem::path &path) {
+		std::unique_lock<std::shared_mutex> lock{_mutex};
+		_entries.erase(path.native());
+	}
+
+	void clear() {
+		std::unique_lock<std::shared_mutex> lock{_mutex};
+		_entries.clear();
+		_missing.clear();
+	}
+
+	// Total size of cached content
+	std::size_t size() const {
+		std::shared_lock<std::shared_mutex> lock{_mutex};
+		return _entries.size();
+	}
+
+	const file_cache_options &options() const { return _options; }
+
+private:
+	// Bound on the number of remembered missing paths
+	static constexpr std::size_t max_missing = 4096;
+
+	static cached_file::clock::rep now() {
+		return cached_file::clock::now().time_since_epoch().count();
+	}
+
+	cached_file::clock::rep revalidate_ticks() const {
+		return std::chrono::duration_cast<cached_file::clock::duration>(
+				   _options.revalidate_interval)
+			.count();
+	}
+
+	bool fresh(const std::string &key, const cached_file &file,
+			   cached_file::clock::rep now);
+
+	void insert(const std::string &key, cached_file_ptr file);
+
+	file_cache_options _options;
+	file_cache_internals::entry_table _entries;
+	std::unordered_map<std::string, cached_file::clock::rep> _missing;
+	mutable std::shared_mutex _mutex;
+};
+
+//==============================================================================
+
+inline std::shared_ptr<cached_file>
+cached_file::load(const std::filesystem::path &path,
+				  const file_cache_options &options, std::error_code &ec) {
+	ec.clear();
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		ec.assign(errno, std::generic_category());
+		return nullptr;
+	}
+
+	std::shared_ptr<cached_file> file{new cached_file{}};
+	if ((::fstat(fd, &file->_stat) != 0) || !S_ISREG(file->_stat.st_mode) ||
+		(static_cast<std::size_t>(file->_stat.st_size) >
+		 options.max_entry_size)) {
+		::close(fd);
+		return nullptr;
+	}
+
+	file->_size = static_cast<std::size_t>(file->_stat.st_size);
+	if (file->_size > options.max_inline_size) {
+		void *mapping =
+			::mmap(nullptr, file->_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (mapping == MAP_FAILED)
+			return nullptr;
+
+		file->_mapping = mapping;
+		file->_data = static_cast<const char *>(mapping);
+	} else {
+		file->_content.resize(file->_size);
+		std::size_t offset = 0;
+		while (offset < file->_size) {
+			ssize_t n = ::read(fd, file->_content.data() + offset,
+							   file->_size - offset);
+			if (n <= 0) {
+				::close(fd);
+				return nullptr;
+			}
+
+			offset += static_cast<std::size_t>(n);
+		}
+
+		::close(fd);
+		file->_data = file->_content.data();
+	}
+
+	file->_header.set(beast::http::field::content_type, mime_type(path));
+	file->_header.set(beast::http::field::content_length,
+					  std::to_string(file->_size));
+	file->_header.set(beast::http::field::etag, entity_tag(file->_stat));
+	file->_header.set(beast::http::field::last_modified,
+					  http_date(file->_stat.st_mtim.tv_sec));
+	file->_header.set(beast::http::field::accept_ranges, "bytes");
+	return file;
+}
+
+inline cached_file_ptr file_cache::lookup(const std::filesystem::path &path) {
+	const std::string &key = path.native();
+	cached_file::clock::rep now = file_cache::now();
+
+	cached_file_ptr file;
+	{
+		std::shared_lock<std::shared_mutex> lock{_mutex};
+		file = _entries.find(key);
+
+		auto missing = _missing.find(key);
+		if ((missing != _missing.end()) &&
+			(now - missing->second < revalidate_ticks()))
+			return nullptr;
+	}
+
+	if (file && fresh(key, *file, now))
+		return file;
+
+	std::error_code ec;
+	std::shared_ptr<cached_file> loaded =
+		cached_file::load(path, _options, ec);
+	if (!loaded) {
+		if (ec == std::errc::no_such_file_or_directory) {
+			std::unique_lock<std::shared_mutex> lock{_mutex};
+			if (_missing.size() >= max_missing)
+				_missing.clear();
+			_missing[key] = now;
+		}
+
+		return nullptr;
+	}
+
+	loaded->_checked_at.store(now, std::memory_order_relaxed);
+	insert(key, loaded);
+	return loaded;
+}
+
+inline bool file_cache::fresh(const std::string &key, const cached_file &file,
+							  cached_file::clock::rep now) {
+	cached_file::clock::rep interval = revalidate_ticks();
+	cached_file::clock::rep checked_at =
+		file._checked_at.load(std::memory_order_relaxed);
+	if ((now - checked_at < interval) ||
+		!file._checked_at.compare_exchange_strong(checked_at, now,
+												  std::memory_order_relaxed))
+		return true;
+
+	struct stat st;
+	if ((::stat(key.c_str(), &st) == 0) && file.same_file(st))
+		return true;
+
+	std::unique_lock<std::shared_mutex> lock{_mutex};
+	_entries.erase(key, file);
+	return false;
+}
+
+inline void file_cache::insert(const std::string &key, cached_file_ptr file) {
+	if (file->size() > _options.max_size)
+		return;
+
+	std::unique_lock<std::shared_mutex> lock{_mutex};
+	_missing.erase(key);
+	_entries.insert(key, std::move(file), _options.max_size);
+}
+
+//==============================================================================
+
+/**
+ * Response body referencing the content of a cached file.
+ */
+struct cached_file_body {
+	using value_type = cached_file_ptr;
+
+	static std::uint64_t size(const value_type &body) { return body->size(); }
+
+	class writer {
+	public:
+		using const_buffers_type = asio::const_buffer;
+
+		template <bool isRequest, class Fields>
+		writer(const beast::http::header<isRequest, Fields> &,
+			   const value_type &body) :
+			_body{body} {}
+
+		void init(beast::error_code &ec) { ec = {}; }
+
+		boost::optional<std::pair<const_buffers_type, bool>>
+		get(beast::error_code &ec) {
+			ec = {};
+			return {{const_buffers_type{_body->data(), _body->size()}, false}};
+		}
+
+	private:
+		const value_type &_body;
+	};
+};
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_FILE_CACHE_HPP_ */
@@ -0,0 +1,474 @@
+/*
+ * hpack.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_HPACK_HPP_
+#define LIB_WEBDONKEY_HPACK_HPP_
+
+#include <webdonkey/defs.hpp>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace webdonkey {
+
+namespace hpack_internals {
+
+struct table_entry {
+	std::string_view name;
+	std::string_view value;
+};
+
+// RFC 7541, appendix A
+inline constexpr std::array<table_entry, 61> static_table = {{
+	{":authority", ""},
+	{":method", "GET"},
+	{":method", "POST"},
+	{":path", "/"},
+	{":path", "/index.html"},
+	{":scheme", "http"},
+	{":scheme", "https"},
+	{":status", "200"},
+	{":status", "204"},
+	{":status", "206"},
+	{":status", "304"},
+	{":status", "400"},
+	{":status", "404"},
+	{":status", "500"},
+	{"accept-charset", ""},
+	{"accept-encoding", "gzip, deflate"},
+	{"accept-language", ""},
+	{"accept-ranges", ""},
+	{"accept", ""},
+	{"access-control-allow-origin", ""},
+	{"age", ""},
+	{"allow", ""},
+	{"authorization", ""},
+	{"cache-control", ""},
+	{"content-disposition", ""},
+	{"content-encoding", ""},
+	{"content-language", ""},
+	{"content-length", ""},
+	{"content-location", ""},
+	{"content-range", ""},
+	{"content-type", ""},
+	{"cookie", ""},
+	{"date", ""},
+	{"etag", ""},
+	{"expect", ""},
+	{"expires", ""},
+	{"from", ""},
+	{"host", ""},
+	{"if-match", ""},
+	{"if-modified-since", ""},
+	{"if-none-match", ""},
+	{"if-range", ""},
+	{"if-unmodified-since", ""},
+	{"last-modified", ""},
+	{"link", ""},
+	{"location", ""},
+	{"max-forwards", ""},
+	{"proxy-authenticate", ""},
+	{"proxy-authorization", ""},
+	{"range", ""},
+	{"referer", ""},
+	{"refresh", ""},
+	{"retry-after", ""},
+	{"server", ""},
+	{"set-cookie", ""},
+	{"strict-transport-security", ""},
+	{"transfer-encoding", ""},
+	{"user-agent", ""},
+	{"vary", ""},
+	{"via", ""},
+	{"www-authenticate", ""},
+}};
+
+/*
+ * The Huffman code of RFC 7541, appendix B, is canonical: it follows from
+ * the number of codes of each length and the symbols in code order.
+ */
+inline constexpr std::array<std::uint16_t, 31> code_counts = {
+	0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+	0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4};
+
+inline constexpr std::array<std::uint16_t, 257> code_symbols = {
+	48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46, 47, 51, 52,
+	53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102, 103, 104, 108, 109, 110,
+	112, 114, 117, 58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79,
+	80, 81, 82, 83, 84, 85, 86, 87, 89, 106, 107, 113, 118, 119, 120, 121,
+	122, 38, 42, 44, 59, 88, 90, 33, 34, 40, 41, 63, 39, 43, 124, 35, 62, 0,
+	36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92, 195, 208, 128, 130, 131,
+	162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177, 179, 209, 216, 217,
+	227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160, 163, 164, 169,
+	170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232, 233, 1,
+	135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157, 158,
+	165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239, 9, 142,
+	144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192,
+	193, 200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203,
+	204, 211, 212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251,
+	252, 253, 254, 2, 3, 4, 5, 6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+	21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220, 249, 10, 13, 22, 256};
+
+// End of string symbol, never valid in encoded data
+inline constexpr std::uint16_t eos = 256;
+
+struct canonical_code {
+	// First code and index of the first symbol of each length
+	std::array<std::uint32_t, 31> first{};
+	std::array<std::uint16_t, 31> offset{};
+};
+
+constexpr canonical_code make_canonical_code() {
+	canonical_code result;
+	std::uint32_t code = 0;
+	std::uint16_t offset = 0;
+	for (std::size_t length = 1; length < code_counts.size(); ++length) {
+		result.first[length] = code;
+		result.offset[length] = offset;
+		code = (code + code_counts[length]) << 1;
+		offset += code_counts[length];
+	}
+
+	return result;
+}
+
+inline constexpr canonical_code canonical = make_canonical_code();
+
+/*
+ * Appends the decoded input to output. Decoding goes bit by bit, which is
+ * fast enough for header values of a few dozen bytes.
+ * @return false if the input is not a valid encoding.
+ */
+inline bool huffman_decode(std::string_view input, std::string &output) {
+	std::uint32_t code = 0;
+	std::size_t length = 0;
+	for (unsigned char byte : input)
+		for (int bit = 7; bit >= 0; --bit) {
+			code = (code << 1) | ((byte >> bit) & 1u);
+			if (++length >= code_counts.size())
+				return false;
+
+			const std::uint32_t index = code - canonical.first[length];
+			if (index >= code_counts[length])
+				continue;
+
+			const std::uint16_t symbol =
+				code_symbols[canonical.offset[length] + index];
+			if (symbol == eos)
+				return false;
+
+			output.push_back(static_cast<char>(symbol));
+			code = 0;
+			length = 0;
+		}
+
+	// Padding is a prefix of EOS, i.e. up to 7 one bits
+	return (length < 8) && (code == (1u << length) - 1);
+}
+
+/*
+ * Reads an integer with an n-bit prefix, see RFC 7541, section 5.1.
+ */
+inline bool decode_integer(const unsigned char *&p, const unsigned char *end,
+						   unsigned prefix_bits, std::uint32_t &value) {
+	if (p == end)
+		return false;
+
+	const std::uint32_t prefix_max = (1u << prefix_bits) - 1;
+	value = *p++ & prefix_max;
+	if (value < prefix_max)
+		return true;
+
+	for (unsigned shift = 0; p != end; shift += 7) {
+		// Nothing sane needs more than 28 bits
+		if (shift > 21)
+			return false;
+
+		const unsigned char byte = *p++;
+		value += static_cast<std::uint32_t>(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+inline void encode_integer(std::string &out, unsigned char flags,
+						   unsigned prefix_bits, std::uint32_t value) {
+	const std::uint32_t prefix_max = (1u << prefix_bits) - 1;
+	if (value < prefix_max) {
+		out.push_back(static_cast<char>(flags | value));
+		return;
+	}
+
+	out.push_back(static_cast<char>(flags | prefix_max));
+	value -= prefix_max;
+	while (value >= 0x80) {
+		out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+		value >>= 7;
+	}
+
+	out.push_back(static_cast<char>(value));
+}
+
+inline char to_lower(char c) {
+	return ((c >= 'A') && (c <= 'Z')) ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// Compares with a name in lower case
+inline bool same_name(std::string_view lower, std::string_view name) {
+	if (lower.size() != name.size())
+		return false;
+
+	for (std::size_t i = 0; i < name.size(); ++i)
+		if (lower[i] != to_lower(name[i]))
+			return false;
+
+	return true;
+}
+
+// Strings are sent as they are, without Huffman coding
+inline void encode_string(std::string &out, std::string_view value) {
+	encode_integer(out, 0, 7, static_cast<std::uint32_t>(value.size()));
+	out.append(value);
+}
+
+} // namespace hpack_internals
+
+/**
+ * Header block decoder of an HTTP/2 connection, see RFC 7541. Keeps the
+ * dynamic table shared by all header blocks the peer sends, so blocks
+ * must be decoded in the order they arrive, including those of streams
+ * which are refused.
+ */
+class hpack_decoder {
+public:
+	/**
+	 * @param max_table_size the dynamic table size limit the peer has been
+	 * told, SETTINGS_HEADER_TABLE_SIZE.
+	 */
+	explicit hpack_decoder(std::size_t max_table_size = 4096) :
+		_size_limit{max_table_size}, _max_size{max_table_size} {}
+
+	/**
+	 * Decodes a complete header block, calling on_field(name, value) for
+	 * every field in order. The views are only valid during the call.
+	 *
+	 * @return false if the block is malformed, which is a connection
+	 * error of type COMPRESSION_ERROR.
+	 */
+	template <typename handler_type>
+	bool decode(std::string_view block, handler_type &&on_field) {
+		using namespace hpack_internals;
+
+		auto p = reinterpret_cast<const unsigned char *>(block.data());
+		const unsigned char *end = p + block.size();
+		bool field_seen = false;
+		while (p != end) {
+			const unsigned char first = *p;
+			std::uint32_t index = 0;
+
+			// Indexed field
+			if (first & 0x80) {
+				if (!decode_integer(p, end, 7, index))
+					return false;
+
+				std::optional<table_entry> entry = lookup(index);
+				if (!entry.has_value())
+					return false;
+
+				on_field(entry->name, entry->value);
+				field_seen = true;
+				continue;
+			}
+
+			// Dynamic table size update, only allowed before any field
+			if ((first & 0xe0) == 0x20) {
+				if (field_seen || !decode_integer(p, end, 5, index) ||
+					(index > _size_limit))
+					return false;
+
+				_max_size = index;
+				evict(0);
+				continue;
+			}
+
+			// Literal field, with incremental indexing or without indexing
+			const bool indexing = (first & 0xc0) == 0x40;
+			if (!decode_integer(p, end, indexing ? 6 : 4, index))
+				return false;
+
+			std::string_view name;
+			if (index == 0) {
+				if (!decode_string(p, end, _name))
+					return false;
+
+				name = _name;
+			} else {
+				std::optional<table_entry> entry = lookup(index);
+				if (!entry.has_value())
+					return false;
+
+				name = entry->name;
+			}
+
+			if (!decode_string(p, end, _value))
+				return false;
+
+			on_field(name, std::string_view{_value});
+			field_seen = true;
+			if (indexing)
+				insert(std::string{name}, _value);
+		}
+
+		return true;
+	}
+
+private:
+	using entry = std::pair<std::string, std::string>;
+
+	// Per entry overhead, RFC 7541, section 4.1
+	static constexpr std::size_t entry_overhead = 32;
+
+	std::optional<hpack_internals::table_entry>
+	lookup(std::uint32_t index) const {
+		using hpack_internals::static_table;
+		if (index == 0)
+			return std::nullopt;
+
+		if (index <= static_table.size())
+			return static_table[index - 1];
+
+		index -= static_table.size() + 1;
+		if (index >= _entries.size())
+			return std::nullopt;
+
+		const entry &found = _entries[index];
+		return hpack_internals::table_entry{found.first, found.second};
+	}
+
+	bool decode_string(const unsigned char *&p, const unsigned char *end,
+					   std::string &out) {
+		if (p == end)
+			return false;
+
+		const bool huffman = (*p & 0x80) != 0;
+		std::uint32_t length = 0;
+		if (!hpack_internals::decode_integer(p, end, 7, length) ||
+			(static_cast<std::size_t>(end - p) < length))
+			return false;
+
+		const std::string_view data{reinterpret_cast<const char *>(p),
+									length};
+		p += length;
+		out.clear();
+		if (huffman)
+			return hpack_internals::huffman_decode(data, out);
+
+		out.assign(data);
+		return true;
+	}
+
+	// Makes room for an entry of the given size
+	void evict(std::size_t room) {
+		while (!_entries.empty() && (_size + room > _max_size)) {
+			const entry &last = _entries.back();
+			_size -= last.first.size() + last.second.size() + entry_overhead;
+			_entries.pop_back();
+		}
+	}
+
+	void insert(std::string &&name, const std::string &value) {
+		const std::size_t size = name.size() + value.size() + entry_overhead;
+		evict(size);
+
+		// An entry larger than the table just empties it
+		if (size > _max_size)
+			return;
+
+		_entries.emplace_front(std::move(name), value);
+		_size += size;
+	}
+
+	std::size_t _size_limit;
+	std::size_t _max_size;
+	std::size_t _size = 0;
+	std::deque<entry> _entries;
+	std::string _name;
+	std::string _value;
+};
+
+/**
+ * Header block encoder. Fields are sent as literals without indexing,
+ * referring to names of the static table where possible, so the encoder
+ * keeps no state and never depends on the peer's dynamic table.
+ */
+class hpack_encoder {
+public:
+	static void status(std::string &block, unsigned code) {
+		using hpack_internals::encode_integer;
+
+		// Indexed :status fields of the static table
+		switch (code) {
+		case 200:
+			return encode_integer(block, 0x80, 7, 8);
+		case 204:
+			return encode_integer(block, 0x80, 7, 9);
+		case 206:
+			return encode_integer(block, 0x80, 7, 10);
+		case 304:
+			return encode_integer(block, 0x80, 7, 11);
+		case 400:
+			return encode_integer(block, 0x80, 7, 12);
+		case 404:
+			return encode_integer(block, 0x80, 7, 13);
+		case 500:
+			return encode_integer(block, 0x80, 7, 14);
+		default:
+			break;
+		}
+
+		char digits[3] = {static_cast<char>('0' + code / 100 % 10),
+						  static_cast<char>('0' + code / 10 % 10),
+						  static_cast<char>('0' + code % 10)};
+		encode_integer(block, 0, 4, 8);
+		hpack_internals::encode_string(block,
+									   std::string_view{digits, sizeof(digits)});
+	}
+
+	/**
+	 * Appends a field; the name is sent in lower case.
+	 */
+	static void field(std::string &block, std::string_view name,
+					  std::string_view value) {
+		using namespace hpack_internals;
+
+		// Regular fields of the static table start after :status
+		for (std::size_t i = 14; i < static_table.size(); ++i)
+			if (same_name(static_table[i].name, name)) {
+				encode_integer(block, 0, 4, static_cast<std::uint32_t>(i + 1));
+				encode_string(block, value);
+				return;
+			}
+
+		block.push_back(0);
+		encode_integer(block, 0, 7, static_cast<std::uint32_t>(name.size()));
+		for (char c : name)
+			block.push_back(to_lower(c));
+
+		encode_string(block, value);
+	}
+};
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_HPACK_HPP_ */
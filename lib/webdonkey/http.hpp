@@ -10,22 +10,403 @@
 
 #include <boost/asio/awaitable.hpp>
 #include <boost/asio/use_awaitable.hpp>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
 #include <expected>
+#include <filesystem>
+#include <limits>
+#include <memory_resource>
+#include <optional>
 #include <regex>
+#include <span>
+#include <variant>
+#include <vector>
+#include <webdonkey/access_log.hpp>
+#include <webdonkey/canned_response.hpp>
+#include <webdonkey/file_cache.hpp>
+#include <webdonkey/http2.hpp>
+#include <webdonkey/metrics.hpp>
+#include <webdonkey/recycling.hpp>
+#include <webdonkey/tls.hpp>
 #include <webdonkey/utils.hpp>
 
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+
+#include <unistd.h>
+
 namespace webdonkey {
 
 using response_generator = beast::http::message_generator;
-using request_buffer = beast::multi_buffer;
-using request_parser = beast::http::request_parser<beast::http::buffer_body>;
+using request_buffer = beast::flat_buffer;
+
+// Header fields live in a per-connection arena released with every request
+using request_allocator = std::pmr::polymorphic_allocator<char>;
+using request_parser =
+	beast::http::request_parser<beast::http::buffer_body, request_allocator>;
 using request = request_parser::value_type;
 using response_ptr = std::shared_ptr<response_generator>;
 
+using empty_response = beast::http::response<beast::http::empty_body>;
+using string_response = beast::http::response<beast::http::string_body>;
+using cached_response = beast::http::response<cached_file_body>;
+
+/**
+ * Response returned by value. Messages with an empty, string or cached
+ * file body are serialized in place, without type erasure or an allocation
+ * of their own; other messages are wrapped in a response_generator. Canned
+ * messages are written straight from their buffers. A null
+ * response means that the responder has written or queued its output
+ * itself.
+ *
+ * Responses may be moved until their serialization starts.
+ */
+class http_response {
+public:
+	using const_buffers_type = std::span<const asio::const_buffer>;
+
+	http_response() = default;
+
+	http_response(std::nullptr_t) {}
+
+	http_response(response_ptr generator) {
+		if (generator)
+			_message = std::move(generator);
+	}
+
+	http_response(response_generator &&generator) :
+		_message{std::in_place_type<response_generator>,
+				 std::move(generator)} {}
+
+	http_response(canned_message &&message) :
+		_message{std::in_place_type<canned_message>, std::move(message)} {}
+
+	template <class body>
+	http_response(beast::http::response<body> &&message) {
+		if constexpr (std::is_same_v<body, beast::http::empty_body> ||
+					  std::is_same_v<body, beast::http::string_body> ||
+					  std::is_same_v<body, cached_file_body>)
+			_message.emplace<serialized<body>>(std::move(message));
+		else
+			_message.emplace<response_generator>(std::move(message));
+	}
+
+	explicit operator bool() const {
+		return !std::holds_alternative<std::monostate>(_message);
+	}
+
+	bool is_done() {
+		return std::visit([](auto &message) { return done(message); },
+						  _message);
+	}
+
+	/**
+	 * @return the next buffers to write, valid until the next call.
+	 */
+	const_buffers_type prepare(beast::error_code &ec) {
+		std::visit([this, &ec](auto &message) { next(message, ec); },
+				   _message);
+		return const_buffers_type{_buffers.data(), _size};
+	}
+
+	void consume(std::size_t n) {
+		std::visit([n](auto &message) { consume(message, n); }, _message);
+	}
+
+private:
+	template <class body> struct serialized {
+		beast::http::response<body> message;
+		std::optional<beast::http::response_serializer<body>> serializer;
+
+		explicit serialized(beast::http::response<body> &&m) :
+			message{std::move(m)} {}
+
+		// The serializer refers to the message, so it is not carried over
+		serialized(serialized &&other) : message{std::move(other.message)} {}
+
+		serialized &operator=(serialized &&other) {
+			serializer.reset();
+			message = std::move(other.message);
+			return *this;
+		}
+	};
+
+	static bool done(std::monostate &) { return true; }
+
+	template <class body> static bool done(serialized<body> &message) {
+		return message.serializer.has_value() &&
+			   message.serializer->is_done();
+	}
+
+	static bool done(response_generator &generator) {
+		return generator.is_done();
+	}
+
+	static bool done(response_ptr &generator) { return generator->is_done(); }
+
+	static bool done(canned_message &message) { return message.is_done(); }
+
+	void next(std::monostate &, beast::error_code &) { _size = 0; }
+
+	template <class body>
+	void next(serialized<body> &message, beast::error_code &ec) {
+		_size = 0;
+		if (!message.serializer.has_value())
+			message.serializer.emplace(message.message);
+
+		message.serializer->next(
+			ec, [this](beast::error_code &, const auto &buffers) {
+				copy(buffers);
+			});
+	}
+
+	void next(response_generator &generator, beast::error_code &ec) {
+		_size = 0;
+		copy(generator.prepare(ec));
+	}
+
+	void next(response_ptr &generator, beast::error_code &ec) {
+		next(*generator, ec);
+	}
+
+	void next(canned_message &message, beast::error_code &) {
+		static_assert(canned_message::max_buffers <=
+					  std::tuple_size_v<decltype(_buffers)>);
+		_size = message.prepare(_buffers);
+	}
+
+	static void consume(std::monostate &, std::size_t) {}
+
+	template <class body>
+	static void consume(serialized<body> &message, std::size_t n) {
+		message.serializer->consume(n);
+	}
+
+	static void consume(response_generator &generator, std::size_t n) {
+		generator.consume(n);
+	}
+
+	static void consume(response_ptr &generator, std::size_t n) {
+		generator->consume(n);
+	}
+
+	static void consume(canned_message &message, std::size_t n) {
+		message.consume(n);
+	}
+
+	// Takes as many buffers as fit; the rest comes with the next prepare()
+	template <class buffer_sequence> void copy(const buffer_sequence &buffers) {
+		for (auto it = asio::buffer_sequence_begin(buffers);
+			 (it != asio::buffer_sequence_end(buffers)) &&
+			 (_size < _buffers.size());
+			 ++it)
+			_buffers[_size++] = *it;
+	}
+
+	std::variant<std::monostate, serialized<beast::http::empty_body>,
+				 serialized<beast::http::string_body>,
+				 serialized<cached_file_body>, response_generator,
+				 response_ptr, canned_message>
+		_message;
+
+	std::array<asio::const_buffer, 16> _buffers;
+	std::size_t _size = 0;
+};
+
+/**
+ * Part of an open file sent as (part of) a response body after a
+ * header-only response has been queued. Several segments may share a file.
+ */
+struct file_segment {
+	std::shared_ptr<beast::file> file;
+	std::uint64_t offset = 0;
+	std::uint64_t size = 0;
+};
+
+/**
+ * Per-phase connection deadlines; a zero duration disables the deadline.
+ * The header deadline runs from the first byte of a request, the body and
+ * write deadlines bound the time without progress of a single read or
+ * write.
+ */
+struct connection_timeouts {
+	using duration = std::chrono::steady_clock::duration;
+
+	// Waiting for the next request on a kept-alive connection
+	duration idle = std::chrono::seconds{75};
+
+	// TLS handshake of a new connection
+	duration handshake = std::chrono::seconds{60};
+
+	duration header = std::chrono::seconds{60};
+	duration body = std::chrono::seconds{60};
+	duration write = std::chrono::seconds{60};
+};
+
+/**
+ * Per-connection settings shared by all connections of a listener.
+ */
+struct connection_options {
+	connection_timeouts timeouts;
+
+	// Default request body limit, see request_context::body_limit()
+	std::uint64_t max_body_size = 1024 * 1024;
+
+	// Optional; requests are not logged or counted if null
+	access_log_ptr log;
+	metrics_ptr metrics;
+
+	http2_options http2;
+};
+
+/**
+ * Sets the deadline of subsequent operations on a stream.
+ */
+template <class socket_stream>
+void expires_after(socket_stream &stream,
+				   connection_timeouts::duration timeout) {
+	if (timeout == connection_timeouts::duration::zero())
+		beast::get_lowest_layer(stream).expires_never();
+	else
+		beast::get_lowest_layer(stream).expires_after(timeout);
+}
+
+/**
+ * Where request_context::spool_body() keeps a body.
+ */
+struct spool_options {
+	// Bodies up to this size stay in memory
+	std::size_t memory_limit = 64 * 1024;
+
+	std::filesystem::path directory = std::filesystem::temp_directory_path();
+
+	/*
+	 * The temporary file is created and written on this executor, which
+	 * should be apart from the one serving requests, so that disk writes
+	 * do not hold them up. If there is none, they block the connection's.
+	 */
+	asio::any_io_executor file_executor;
+};
+
+/**
+ * Complete request body, in memory or, if large, in an unlinked temporary
+ * file positioned at its start.
+ */
+struct spooled_body {
+	std::string memory;
+	std::shared_ptr<beast::file> file;
+	std::uint64_t size = 0;
+
+	bool on_disk() const { return static_cast<bool>(file); }
+};
+
+namespace spool_internals {
+
+/*
+ * Appends data to the file of body, creating it first with what is in
+ * memory. A coroutine so that it can be spawned on the file executor;
+ * it blocks the thread running it.
+ */
+inline awaitable<void> write(spooled_body &body, const char *data,
+							 std::size_t size, const spool_options &options) {
+	beast::error_code ec;
+	if (!body.on_disk()) {
+		std::string name = (options.directory / "webdonkey-XXXXXX").string();
+		int fd = ::mkstemp(name.data());
+		if (fd < 0)
+			throw boost::system::system_error{errno,
+											  boost::system::system_category()};
+
+		// Gone as soon as the last descriptor is closed
+		::unlink(name.c_str());
+		body.file = std::make_shared<beast::file>();
+		body.file->native_handle(fd);
+		body.file->write(body.memory.data(), body.memory.size(), ec);
+		if (ec)
+			throw boost::system::system_error{ec};
+
+		body.memory = std::string{};
+	}
+
+	body.file->write(data, size, ec);
+	if (ec)
+		throw boost::system::system_error{ec};
+
+	co_return;
+}
+
+} // namespace spool_internals
+
+/**
+ * Values of {name} segments captured by a router. Both names and values
+ * are views, the latter into the request target.
+ */
+class route_params {
+public:
+	static constexpr std::size_t capacity = 8;
+
+	/**
+	 * @return the captured value or an empty view.
+	 */
+	std::string_view get(std::string_view name) const {
+		for (std::size_t i = 0; i < _size; ++i)
+			if (_items[i].first == name)
+				return _items[i].second;
+
+		return std::string_view{};
+	}
+
+	std::size_t size() const { return _size; }
+
+	bool push(std::string_view name, std::string_view value) {
+		if (_size == capacity)
+			return false;
+
+		_items[_size++] = {name, value};
+		return true;
+	}
+
+	void pop() { --_size; }
+
+	void clear() { _size = 0; }
+
+private:
+	std::array<std::pair<std::string_view, std::string_view>, capacity> _items;
+	std::size_t _size = 0;
+};
+
+/**
+ * Connection-scoped request state. The read buffer outlives individual
+ * requests so that bytes of pipelined requests read together with the
+ * current one are not lost, while the parser is recreated by reset() for
+ * every request.
+ */
 template <class socket_stream> class request_context {
 public:
-	request_context(socket_stream &s) :
-		_stream{s} {};
+	/**
+	 * Maximum number of responses held back while pipelined requests
+	 * are being answered from the read buffer.
+	 */
+	static constexpr std::size_t max_pending_responses = 16;
+
+	/**
+	 * Response chunks up to this size are coalesced into a single write
+	 * when flushing pending responses.
+	 */
+	static constexpr std::size_t max_coalesced_write = 64 * 1024;
+
+	request_context(socket_stream &s, const connection_options &options = {}) :
+		_stream{s}, _timeouts{options.timeouts},
+		_max_body_size{options.max_body_size}, _log{options.log},
+		_metrics{options.metrics} {
+		if constexpr (std::is_same_v<socket_stream, ssl_stream>)
+			_kernel_tls = kernel_tls(s);
+
+		reset();
+	};
 
 	request_context(const request_context<socket_stream> &) = delete;
 	request_context(request_context<socket_stream> &&) = delete;
@@ -38,69 +419,752 @@ public:
 
 	request_buffer &buffer() { return _buffer; }
 
-	request_parser &parser() { return _parser; }
+	request_parser &parser() { return *_parser; }
 
 	socket_stream &stream() { return _stream; }
 
+	const connection_timeouts &timeouts() const { return _timeouts; }
+
+	/**
+	 * Sets the deadline of subsequent operations on the stream.
+	 */
+	void expires_after(connection_timeouts::duration timeout) {
+		webdonkey::expires_after(_stream, timeout);
+	}
+
+	/**
+	 * Prepares the context for the next request on the connection.
+	 * Unconsumed bytes in the read buffer are kept.
+	 */
+	void reset() {
+		_parser.reset();
+		_arena.release();
+
+		// Limits are enforced here, after the route had a say
+		_parser.emplace(std::piecewise_construct, std::make_tuple(),
+						std::make_tuple(request_allocator{&_arena}));
+		_parser->body_limit(std::numeric_limits<std::uint64_t>::max());
+		_body_limit = _max_body_size;
+		_body_read = 0;
+		_continue_sent = false;
+		_force_keep_alive.reset();
+		_params.clear();
+		_route = metrics_registry::default_route;
+	}
+
+	route_params &params() { return _params; }
+
+	const route_params &params() const { return _params; }
+
+	/**
+	 * Selects the latency histogram the current request is recorded in,
+	 * besides the overall one.
+	 */
+	void metrics_route(metrics_registry::histogram_id route) { _route = route; }
+
+	metrics_registry::histogram_id metrics_route() const { return _route; }
+
+	const metrics_ptr &metrics() const { return _metrics; }
+
+	/**
+	 * Attempts to parse the request header from already buffered bytes
+	 * without touching the socket.
+	 * @return true if a complete header has been parsed.
+	 */
+	bool parse_buffered_header() {
+		while (!_parser->is_header_done() && (_buffer.size() > 0)) {
+			beast::error_code ec;
+			std::size_t parsed = _parser->put(_buffer.data(), ec);
+			_buffer.consume(parsed);
+
+			if (ec == beast::http::error::need_more)
+				return false;
+
+			if (ec)
+				throw boost::system::system_error{ec};
+
+			if (parsed == 0)
+				break;
+		}
+
+		return _parser->is_header_done();
+	}
+
+	/**
+	 * Waits for the next request under the idle deadline, then reads its
+	 * header under the header deadline. A connection which stays idle
+	 * or is closed before a request starts ends with end_of_stream.
+	 */
 	asio::awaitable<std::size_t> read_header() {
-		return beast::http::async_read_header(_stream, _buffer, _parser,
-											  asio::use_awaitable);
+		if (_buffer.size() == 0) {
+			expires_after(_timeouts.idle);
+
+			beast::error_code ec;
+			std::size_t received = co_await _stream.async_read_some(
+				_buffer.prepare(initial_read_size),
+				asio::redirect_error(recycled_awaitable, ec));
+			_buffer.commit(received);
+
+			if ((ec == beast::error::timeout) || (ec == asio::error::eof) ||
+				(ec == ssl::error::stream_truncated))
+				throw boost::system::system_error{
+					beast::http::error::end_of_stream};
+
+			if (ec)
+				throw boost::system::system_error{ec};
+		}
+
+		expires_after(_timeouts.header);
+		co_return co_await beast::http::async_read_header(
+			_stream, _buffer, *_parser, recycled_awaitable);
+	}
+
+	/**
+	 * Maximum size of the current request body, by default the connection
+	 * option max_body_size. Reading a larger body fails with
+	 * beast::http::error::body_limit, before any of it is read if the
+	 * size is announced by Content-Length.
+	 */
+	void body_limit(std::uint64_t limit) { _body_limit = limit; }
+
+	std::uint64_t body_limit() const { return _body_limit; }
+
+	/**
+	 * True if the client waits for a 100 Continue before sending the body
+	 * and has not got one yet.
+	 */
+	bool awaiting_continue() const {
+		return !_continue_sent && !_parser->is_done() &&
+			   (request().version() >= 11) &&
+			   beast::iequals(request()[beast::http::field::expect],
+							  "100-continue");
+	}
+
+	/**
+	 * Reads the next part of the request body straight into the buffer,
+	 * decoding chunked transfer encoding. Sends 100 Continue first if the
+	 * client expects it.
+	 * @return the number of bytes read, 0 at the end of the body.
+	 */
+	awaitable<std::size_t> read_body_some(asio::mutable_buffer buffer);
+
+	/**
+	 * Reads the whole body, spilling it to a temporary file if it is
+	 * larger than the memory limit. File writes are done on the file
+	 * executor of options, if set.
+	 */
+	awaitable<spooled_body> spool_body(spool_options options);
+
+	/*
+	 * Not a default argument: GCC 12 destroys default argument temporaries
+	 * of a co_await expression twice.
+	 */
+	awaitable<spooled_body> spool_body() { return spool_body(spool_options{}); }
+
+	/**
+	 * Reads and drops whatever is left of the current request body so that
+	 * the next pipelined request can be parsed.
+	 * @return false if the body is over the limit, or has not been sent
+	 * because the client expects a 100 Continue; the connection cannot be
+	 * reused then.
+	 */
+	awaitable<bool> discard_body() {
+		if (awaiting_continue() || over_limit(0))
+			co_return false;
+
+		char scratch[4096];
+		while (!_parser->is_done()) {
+			_parser->get().body().data = scratch;
+			_parser->get().body().size = sizeof(scratch);
+
+			expires_after(_timeouts.body);
+			beast::error_code ec;
+			co_await beast::http::async_read_some(
+				_stream, _buffer, *_parser,
+				asio::redirect_error(recycled_awaitable, ec));
+
+			if (ec && (ec != beast::http::error::need_buffer))
+				throw boost::system::system_error{ec};
+
+			if (over_limit(sizeof(scratch) - _parser->get().body().size))
+				co_return false;
+		}
+
+		co_return true;
 	}
 
 	template <class body>
 	asio::awaitable<std::size_t> write(beast::http::response<body> &response) {
-		return beast::http::async_write(_stream, response, asio::use_awaitable);
+		co_await flush();
+		if (_status == 0)
+			_status = static_cast<std::uint16_t>(response.result_int());
+
+		expires_after(_timeouts.write);
+		std::size_t written;
+		if (_kernel_tls)
+			written = co_await beast::http::async_write(
+				beast::get_lowest_layer(_stream), response,
+				recycled_awaitable);
+		else
+			written = co_await beast::http::async_write(_stream, response,
+														recycled_awaitable);
+
+		_bytes_sent += written;
+		co_return written;
 	}
 
 	awaitable<std::size_t> write(response_generator &gen) {
-		return beast::async_write(_stream, std::move(gen), asio::use_awaitable);
+		co_await flush();
+		co_return co_await write_generator(gen);
 	}
 
+	awaitable<std::size_t> write(http_response &response) {
+		co_await flush();
+		co_return co_await write_generator(response);
+	}
+
+	/**
+	 * Queues a response to be written by the next flush().
+	 */
+	void enqueue(http_response &&response) {
+		_pending.emplace_back(std::move(response));
+	}
+
+	/**
+	 * Queues raw file content, typically the body of a header-only
+	 * response queued just before it.
+	 */
+	void enqueue(file_segment &&segment) {
+		_pending.emplace_back(std::move(segment));
+	}
+
+	/**
+	 * Queues preformatted bytes, e.g. part headers of a multipart body.
+	 */
+	void enqueue(std::string &&bytes) {
+		_pending.emplace_back(std::move(bytes));
+	}
+
+	/**
+	 * Queues an access log record of the current request behind its
+	 * response. Status, size and latency are filled in, and the request
+	 * is counted in the metrics, when the queue is flushed. Does nothing
+	 * if the connection has neither an access log nor metrics.
+	 */
+	void log_request(std::chrono::steady_clock::time_point started);
+
+	/**
+	 * Records the status of a response written to the stream other than
+	 * through the context, e.g. by a WebSocket handshake.
+	 */
+	void record_status(beast::http::status status) {
+		if (_status == 0)
+			_status = static_cast<std::uint16_t>(status);
+	}
+
+	/**
+	 * True if queued file segments go from the file straight to the socket
+	 * with sendfile(2) instead of through user-space buffers: on plain TCP
+	 * and on TLS connections offloaded to the kernel.
+	 */
+	bool zero_copy_files() const {
+#if defined(__linux__)
+		return std::is_same_v<socket_stream, tcp_stream> || _kernel_tls;
+#else
+		return false;
+#endif
+	}
+
+	bool pending_full() const {
+		return _pending.size() >= max_pending_responses;
+	}
+
+	/**
+	 * Writes all queued responses in order. Small responses are coalesced
+	 * so that a batch of pipelined responses costs a single write.
+	 */
+	awaitable<void> flush();
+
 	void force_keep_alive(bool flag) { _force_keep_alive = flag; }
 
 	bool keep_alive() const {
 		if (_force_keep_alive.has_value())
 			return _force_keep_alive.value();
 
-		return _parser.get().keep_alive();
+		return _parser->get().keep_alive();
 	}
 
-	const webdonkey::request &request() const { return _parser.get(); }
+	const webdonkey::request &request() const { return _parser->get(); }
 
-	webdonkey::request &request() { return _parser.get(); }
+	webdonkey::request &request() { return _parser->get(); }
 
-	std::string_view target() const { return _parser.get().base().target(); }
+	std::string_view target() const { return _parser->get().base().target(); }
 
 	std::string method_string() const {
 		return beast::http::to_string(request().method());
 	}
 
 private:
+	struct logged_request {
+		access_record record;
+		std::chrono::steady_clock::time_point started;
+		metrics_registry::histogram_id route;
+	};
+
+	using pending_write = std::variant<http_response, file_segment, std::string,
+									   logged_request>;
+
+	// Read size when waiting for a new request on an idle connection
+	static constexpr std::size_t initial_read_size = 4096;
+
+	// Arena space for the fields of a typical request header
+	static constexpr std::size_t arena_size = 4096;
+
+	/*
+	 * Counts body bytes read; true if the body is known or found to be
+	 * over the limit.
+	 */
+	bool over_limit(std::size_t read) {
+		_body_read += read;
+		boost::optional<std::uint64_t> length = _parser->content_length();
+		return (_body_read > _body_limit) ||
+			   (length.has_value() && (length.value() > _body_limit));
+	}
+
+	awaitable<void> send_continue() {
+		if (!awaiting_continue())
+			co_return;
+
+		// Responses to earlier pipelined requests go first
+		co_await flush();
+		static constexpr std::string_view interim =
+			"HTTP/1.1 100 Continue\r\n\r\n";
+		std::size_t written = 0;
+		while (written < interim.size())
+			written += co_await write_some(
+				asio::buffer(interim.substr(written)));
+
+		_continue_sent = true;
+	}
+
+	/*
+	 * Writes under the write deadline. Connections with kernel TLS are
+	 * written to as plain TCP.
+	 */
+	template <class buffer_sequence>
+	awaitable<std::size_t> write_some(const buffer_sequence &buffers) {
+		expires_after(_timeouts.write);
+		if (_kernel_tls)
+			co_return co_await beast::get_lowest_layer(_stream)
+				.async_write_some(buffers, recycled_awaitable);
+
+		co_return co_await _stream.async_write_some(buffers,
+													recycled_awaitable);
+	}
+
+	awaitable<void> write_output() {
+		while (_output.size() > 0) {
+			std::size_t written = co_await write_some(_output.data());
+			_output.consume(written);
+		}
+	}
+
+	template <class generator_type>
+	awaitable<std::size_t> write_generator(generator_type &response) {
+		std::size_t total = 0;
+		while (!response.is_done()) {
+			beast::error_code ec;
+			auto chunk = response.prepare(ec);
+			if (ec)
+				throw boost::system::system_error{ec};
+
+			note_status(chunk);
+			std::size_t written = co_await write_some(chunk);
+			response.consume(written);
+			total += written;
+		}
+
+		_bytes_sent += total;
+		co_return total;
+	}
+
+	/*
+	 * Takes the status of the current request for the access log and
+	 * metrics from the status line at the start of its first response.
+	 */
+	template <class buffer_sequence>
+	void note_status(const buffer_sequence &chunk) {
+		if ((!_log && !_metrics) || (_status != 0))
+			return;
+
+		char line[12];
+		std::size_t size = asio::buffer_copy(asio::buffer(line), chunk);
+		if ((size == sizeof(line)) &&
+			std::string_view{line, 5} == std::string_view{"HTTP/"})
+			std::from_chars(line + 9, line + 12, _status);
+	}
+
+	void complete_log(logged_request &entry) {
+		const std::uint64_t bytes = _bytes_sent - _bytes_logged;
+		const std::chrono::nanoseconds latency =
+			std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - entry.started);
+
+		if (_log) {
+			entry.record.status = _status;
+			entry.record.bytes = bytes;
+			entry.record.latency = latency.count();
+			_log->log(entry.record);
+		}
+
+		if (_metrics)
+			_metrics->request_done(entry.route, _status, bytes, latency);
+
+		_status = 0;
+		_bytes_logged = _bytes_sent;
+	}
+
+	awaitable<void> send_file(file_segment &segment);
+
+	/*
+	 * Raw socket waits bypass the stream deadline, so the write timeout
+	 * is enforced by cancelling the wait.
+	 */
+	awaitable<void> wait_writable(tcp::socket &socket) {
+		asio::steady_timer deadline{socket.get_executor()};
+		if (_timeouts.write != connection_timeouts::duration::zero()) {
+			deadline.expires_after(_timeouts.write);
+			deadline.async_wait([&socket](beast::error_code ec) {
+				if (!ec)
+					socket.cancel();
+			});
+		}
+
+		beast::error_code ec;
+		co_await socket.async_wait(tcp::socket::wait_write,
+								   asio::redirect_error(recycled_awaitable, ec));
+		if ((ec == asio::error::operation_aborted) &&
+			(deadline.expiry() <= asio::steady_timer::clock_type::now()))
+			throw boost::system::system_error{beast::error::timeout};
+
+		if (ec)
+			throw boost::system::system_error{ec};
+	}
+
 	std::optional<bool> _force_keep_alive;
 	socket_stream &_stream;
+	bool _kernel_tls = false;
+	connection_timeouts _timeouts;
+	std::uint64_t _max_body_size;
+	std::uint64_t _body_limit = 0;
+	std::uint64_t _body_read = 0;
+	bool _continue_sent = false;
+	access_log_ptr _log;
+	metrics_ptr _metrics;
+	metrics_registry::histogram_id _route = metrics_registry::default_route;
+	std::optional<tcp::endpoint> _peer;
+	std::uint16_t _status = 0;
+	std::uint64_t _bytes_sent = 0;
+	std::uint64_t _bytes_logged = 0;
 	request_buffer _buffer;
-	request_parser _parser;
+	alignas(std::max_align_t) std::array<std::byte, arena_size> _arena_space;
+	std::pmr::monotonic_buffer_resource _arena{_arena_space.data(),
+											   _arena_space.size()};
+	std::optional<request_parser> _parser;
+	route_params _params;
+	std::vector<pending_write> _pending;
+
+	// Swapped with _pending by flush() so that both keep their capacity
+	std::vector<pending_write> _batch;
+	beast::flat_buffer _output;
 };
 
+template <class socket_stream>
+awaitable<void> request_context<socket_stream>::flush() {
+	if (_pending.empty())
+		co_return;
+
+	// A lone response needs no coalescing
+	if ((_pending.size() == 1) &&
+		std::holds_alternative<http_response>(_pending.front())) {
+		co_await write_generator(std::get<http_response>(_pending.front()));
+		_pending.clear();
+		co_return;
+	}
+
+	_batch.swap(_pending);
+	for (pending_write &item : _batch) {
+		if (file_segment *segment = std::get_if<file_segment>(&item)) {
+			co_await write_output();
+			co_await send_file(*segment);
+			_bytes_sent += segment->size;
+			continue;
+		}
+
+		if (logged_request *entry = std::get_if<logged_request>(&item)) {
+			complete_log(*entry);
+			continue;
+		}
+
+		if (std::string *bytes = std::get_if<std::string>(&item)) {
+			_bytes_sent += bytes->size();
+			if (_output.size() + bytes->size() > max_coalesced_write)
+				co_await write_output();
+
+			asio::buffer_copy(_output.prepare(bytes->size()),
+							  asio::buffer(*bytes));
+			_output.commit(bytes->size());
+			continue;
+		}
+
+		http_response &response = std::get<http_response>(item);
+		while (!response.is_done()) {
+			beast::error_code ec;
+			auto chunk = response.prepare(ec);
+			if (ec)
+				throw boost::system::system_error{ec};
+
+			note_status(chunk);
+			std::size_t size = beast::buffer_bytes(chunk);
+			if (_output.size() + size > max_coalesced_write)
+				co_await write_output();
+
+			if (size > max_coalesced_write) {
+				std::size_t written = co_await write_some(chunk);
+				response.consume(written);
+				_bytes_sent += written;
+				continue;
+			}
+
+			asio::buffer_copy(_output.prepare(size), chunk);
+			_output.commit(size);
+			_bytes_sent += size;
+			response.consume(size);
+		}
+	}
+
+	_batch.clear();
+	co_await write_output();
+}
+
+template <class socket_stream>
+void request_context<socket_stream>::log_request(
+	std::chrono::steady_clock::time_point started) {
+	if (!_log && !_metrics)
+		return;
+
+	logged_request entry;
+	entry.started = started;
+	entry.route = _route;
+	if (!_log) {
+		_pending.emplace_back(std::move(entry));
+		return;
+	}
+
+	if (!_peer.has_value()) {
+		beast::error_code ec;
+		_peer = beast::get_lowest_layer(_stream).socket().remote_endpoint(ec);
+	}
+
+	entry.record.time =
+		access_log::now() -
+		std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - started)
+			.count();
+	entry.record.method = request().method();
+	entry.record.set_text(target());
+	if (_peer->port() != 0)
+		entry.record.set_peer(_peer.value());
+
+	_pending.emplace_back(std::move(entry));
+}
+
+template <class socket_stream>
+awaitable<std::size_t>
+request_context<socket_stream>::read_body_some(asio::mutable_buffer buffer) {
+	if (_parser->is_done() || (buffer.size() == 0))
+		co_return 0;
+
+	if (over_limit(0))
+		throw boost::system::system_error{beast::http::error::body_limit};
+
+	co_await send_continue();
+
+	// Chunk headers may be parsed without yielding any body bytes
+	std::size_t read = 0;
+	while ((read == 0) && !_parser->is_done()) {
+		_parser->get().body().data = buffer.data();
+		_parser->get().body().size = buffer.size();
+
+		expires_after(_timeouts.body);
+		beast::error_code ec;
+		co_await beast::http::async_read_some(
+			_stream, _buffer, *_parser,
+			asio::redirect_error(recycled_awaitable, ec));
+
+		if (ec && (ec != beast::http::error::need_buffer))
+			throw boost::system::system_error{ec};
+
+		read = buffer.size() - _parser->get().body().size;
+	}
+
+	_parser->get().body().data = nullptr;
+	_parser->get().body().size = 0;
+	if (over_limit(read))
+		throw boost::system::system_error{beast::http::error::body_limit};
+
+	co_return read;
+}
+
+template <class socket_stream>
+awaitable<spooled_body>
+request_context<socket_stream>::spool_body(spool_options options) {
+	spooled_body body;
+	std::vector<char> chunk(max_coalesced_write);
+	for (;;) {
+		std::size_t read =
+			co_await read_body_some(asio::buffer(chunk.data(), chunk.size()));
+		if (read == 0)
+			break;
+
+		body.size += read;
+		if (!body.on_disk() &&
+			(body.memory.size() + read <= options.memory_limit)) {
+			body.memory.append(chunk.data(), read);
+			continue;
+		}
+
+		if (options.file_executor)
+			co_await asio::co_spawn(
+				options.file_executor,
+				spool_internals::write(body, chunk.data(), read, options),
+				recycled_awaitable);
+		else
+			co_await spool_internals::write(body, chunk.data(), read, options);
+	}
+
+	if (body.on_disk()) {
+		beast::error_code ec;
+		body.file->seek(0, ec);
+		if (ec)
+			throw boost::system::system_error{ec};
+	}
+
+	co_return body;
+}
+
+template <class socket_stream>
+awaitable<void>
+request_context<socket_stream>::send_file(file_segment &segment) {
+#if defined(__linux__)
+	if (zero_copy_files()) {
+		tcp::socket &socket = beast::get_lowest_layer(_stream).socket();
+		socket.native_non_blocking(true);
+
+		off_t offset = static_cast<off_t>(segment.offset);
+		std::uint64_t remaining = segment.size;
+		while (remaining > 0) {
+			ssize_t sent = ::sendfile(
+				socket.native_handle(), segment.file->native_handle(),
+				&offset, std::min<std::uint64_t>(remaining, 0x7ffff000));
+
+			if (sent < 0) {
+				if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+					co_await wait_writable(socket);
+					continue;
+				}
+
+				if (errno == EINTR)
+					continue;
+
+				throw boost::system::system_error{
+					errno, boost::system::system_category()};
+			}
+
+			// The file got shorter than announced in the header
+			if (sent == 0)
+				throw boost::system::system_error{asio::error::eof};
+
+			remaining -= static_cast<std::uint64_t>(sent);
+		}
+
+		co_return;
+	}
+#endif
+
+	// Plain copy through user space, used by user-space TLS
+	beast::error_code ec;
+	segment.file->seek(segment.offset, ec);
+	if (ec)
+		throw boost::system::system_error{ec};
+
+	std::uint64_t remaining = segment.size;
+	while (remaining > 0) {
+		std::size_t chunk_size =
+			std::min<std::uint64_t>(remaining, max_coalesced_write);
+		auto chunk = _output.prepare(chunk_size);
+		std::size_t read =
+			segment.file->read(chunk.data(), chunk.size(), ec);
+		if (ec)
+			throw boost::system::system_error{ec};
+
+		if (read == 0)
+			throw boost::system::system_error{asio::error::eof};
+
+		_output.commit(read);
+		remaining -= read;
+		co_await write_output();
+	}
+}
+
+/**
+ * Serves HTTP/1.1 requests on a connection until it is closed. Bytes
+ * already read from it are passed in input.
+ */
 template <typename responder_type, class socket_stream>
-awaitable<void> serve(socket_stream &stream, responder_type respond) {
-	request_context<socket_stream> ctx{std::forward<decltype(stream)>(stream)};
+awaitable<void> serve(socket_stream &stream, responder_type respond,
+					  const connection_options &options, request_buffer input) {
+	request_context<socket_stream> ctx{std::forward<decltype(stream)>(stream),
+									   options};
+	ctx.buffer() = std::move(input);
 	for (;;) {
 		try {
-			request_context<socket_stream> ctx{
-				std::forward<decltype(stream)>(stream)};
-			co_await ctx.read_header();
-			response_ptr response = co_await respond(ctx);
+			ctx.reset();
+
+			/*
+			 * Pipelined requests may already be sitting in the buffer.
+			 * Responses are only flushed before the socket has to be read.
+			 */
+			if (!ctx.parse_buffered_header()) {
+				co_await ctx.flush();
+				co_await ctx.read_header();
+			}
+
+			const auto started = std::chrono::steady_clock::now();
+			http_response response = co_await respond(ctx);
 
 			/*
 			 * Implementations may choose to write responses to the stream
 			 * directly instead of returning them.
 			 */
 			if (response)
-				co_await ctx.write(*response);
+				ctx.enqueue(std::move(response));
+
+			ctx.log_request(started);
 
-			if (!ctx.keep_alive())
+			if (!ctx.keep_alive()) {
+				co_await ctx.flush();
 				break;
+			}
+
+			if (!ctx.parser().is_done()) {
+				co_await ctx.flush();
+				if (!co_await ctx.discard_body())
+					break;
+			}
+
+			if (ctx.pending_full())
+				co_await ctx.flush();
 		} catch (boost::system::system_error &err) {
 			// Client hangup
 			if (err.code() == beast::http::error::end_of_stream)
@@ -111,19 +1175,248 @@ awaitable<void> serve(socket_stream &stream, responder_type respond) {
 	}
 }
 
+template <typename responder_type, class socket_stream>
+awaitable<void> serve(socket_stream &stream, responder_type respond,
+					  const connection_options &options = {}) {
+	return serve(stream, std::move(respond), options, request_buffer{});
+}
+
+/**
+ * True if server can answer requests on HTTP/2 streams.
+ */
+template <typename server_type>
+inline constexpr bool http2_server =
+	std::is_invocable_v<server_type &, request_context<http2_stream> &>;
+
+namespace http2_internals {
+
+// Read size of HTTP/2 connections, a few full-sized frames
+inline constexpr std::size_t connection_read_size = 64 * 1024;
+
+/*
+ * Writes the frames queued by the session, and ends the connection when it
+ * has been idle for too long.
+ */
+template <class socket_stream>
+awaitable<void> write_frames(socket_stream &stream, http2_session &session,
+							 connection_timeouts timeouts) {
+	bool kernel = false;
+	if constexpr (std::is_same_v<socket_stream, ssl_stream>)
+		kernel = kernel_tls(stream);
+
+	beast::flat_buffer output;
+	try {
+		while (!session.finished()) {
+			if (!session.has_output()) {
+				const bool woken = co_await session.wait_for_output(
+					session.idle_deadline(timeouts.idle));
+				if (!woken) {
+					session.go_away(no_error);
+
+					// Stops the reader
+					beast::get_lowest_layer(stream).cancel();
+				}
+
+				continue;
+			}
+
+			session.take_output(output);
+			while (output.size() > 0) {
+				expires_after(stream, timeouts.write);
+				std::size_t written;
+				if (kernel)
+					written = co_await beast::get_lowest_layer(stream)
+								  .async_write_some(output.data(),
+													recycled_awaitable);
+				else
+					written = co_await stream.async_write_some(
+						output.data(), recycled_awaitable);
+
+				output.consume(written);
+			}
+
+			session.written();
+		}
+	} catch (...) {
+		// The reader fails as well and closes the session
+		beast::get_lowest_layer(stream).close();
+	}
+
+	session.task_done();
+}
+
+template <typename responder_type>
+awaitable<void> serve_stream(http2_stream stream, http2_session &session,
+							 responder_type &respond,
+							 const connection_options &options) {
+	try {
+		co_await serve(stream, std::ref(respond), options);
+		co_await stream.finish();
+	} catch (...) {
+		// Streams not answered in full are reset by release()
+	}
+
+	session.release(stream.state());
+	session.task_done();
+}
+
+template <typename responder_type, class socket_stream>
+awaitable<void> serve_connection(socket_stream &stream,
+								 responder_type &respond,
+								 const connection_options &options,
+								 request_buffer &input) {
+	const asio::any_io_executor executor =
+		beast::get_lowest_layer(stream).get_executor();
+	tcp::socket &socket = beast::get_lowest_layer(stream).socket();
+	http2_session session{executor, options.http2};
+
+	session.start();
+	session.task_started();
+	asio::co_spawn(executor, write_frames(stream, session, options.timeouts),
+				   asio::detached);
+
+	for (;;) {
+		input.consume(session.receive(input.data()));
+		while (http2_session::stream_ptr opened = session.accept()) {
+			session.task_started();
+			asio::co_spawn(executor,
+						   serve_stream(http2_stream{std::move(opened), socket},
+										session, respond, options),
+						   asio::detached);
+		}
+
+		if (session.closing())
+			break;
+
+		// No input is read while the client does not take its output
+		bool stalled = false;
+		while (session.output_full() && socket.is_open() && !stalled) {
+			const bool drained = co_await session.wait_for_room(
+				http2_session::clock::now() + options.timeouts.write);
+			stalled = !drained;
+		}
+
+		if (stalled)
+			break;
+
+		// The writer enforces the idle deadline
+		beast::get_lowest_layer(stream).expires_never();
+		beast::error_code ec;
+		std::size_t received = co_await stream.async_read_some(
+			input.prepare(connection_read_size),
+			asio::redirect_error(recycled_awaitable, ec));
+		input.commit(received);
+		if (ec)
+			break;
+	}
+
+	session.close();
+	co_await session.join();
+}
+
+} // namespace http2_internals
+
+/**
+ * Serves an HTTP/2 connection until it is closed, starting with the
+ * client's connection preface, part of which may have been read into
+ * input already. Every stream is served by serve() over an http2_stream,
+ * with the connection options, so respond must accept
+ * request_context<http2_stream>.
+ *
+ * Streams of a connection run concurrently, on the executor of its socket,
+ * which must be a strand if the socket's I/O context runs on several
+ * threads.
+ */
+template <typename responder_type, class socket_stream>
+awaitable<void> serve_http2(socket_stream &stream, responder_type respond,
+							const connection_options &options,
+							request_buffer input) {
+	co_await asio::co_spawn(
+		beast::get_lowest_layer(stream).get_executor(),
+		http2_internals::serve_connection(stream, respond, options, input),
+		recycled_awaitable);
+}
+
 template <typename server_type>
-awaitable<void> http(tcp::socket &socket, server_type server) {
+awaitable<void> http(tcp::socket &socket, server_type server,
+					 const connection_options &options = {}) {
+	// Responses are coalesced before writing; Nagle would only delay them
+	beast::error_code ec;
+	socket.set_option(tcp::no_delay(true), ec);
+
 	tcp_stream stream{std::move(socket)};
-	co_await serve(stream, server);
+	if constexpr (http2_server<server_type>) {
+		if (options.http2.prior_knowledge) {
+			// The connection preface selects HTTP/2, anything else HTTP/1.1
+			request_buffer input;
+			std::string_view head;
+			expires_after(stream, options.timeouts.idle);
+			do {
+				std::size_t received = co_await stream.async_read_some(
+					input.prepare(4096),
+					asio::redirect_error(recycled_awaitable, ec));
+				input.commit(received);
+
+				// Idle or closed before a request
+				if (ec)
+					co_return;
+
+				head = {static_cast<const char *>(input.data().data()),
+						std::min(input.size(), http2_preface.size())};
+			} while ((head.size() < http2_preface.size()) &&
+					 http2_preface.starts_with(head));
+
+			if (head == http2_preface)
+				co_await serve_http2(stream, server, options, std::move(input));
+			else
+				co_await serve(stream, server, options, std::move(input));
+
+			co_return;
+		}
+	}
+
+	co_await serve(stream, server, options);
 }
 
 template <typename server_type>
 awaitable<void> https(tcp::socket &socket, ssl::context &ssl_ctx,
-					  server_type server) {
+					  server_type server,
+					  const connection_options &options = {}) {
+	// Handshake flights and session tickets must not wait for ACKs
+	beast::error_code ec;
+	socket.set_option(tcp::no_delay(true), ec);
+
 	ssl_stream stream{std::move(socket), ssl_ctx};
-	stream.handshake(ssl::stream_base::server);
-	co_await serve(stream, server);
-	stream.shutdown();
+	if constexpr (http2_server<server_type>)
+		accept_http2(stream);
+
+	expires_after(stream, options.timeouts.handshake);
+	co_await stream.async_handshake(ssl::stream_base::server,
+									recycled_awaitable);
+
+	if (kernel_tls_requested(ssl_ctx))
+		offload_to_kernel(stream);
+
+	bool served = false;
+	if constexpr (http2_server<server_type>)
+		if (http2_negotiated(stream)) {
+			co_await serve_http2(stream, server, options, request_buffer{});
+			served = true;
+		}
+
+	if (!served)
+		co_await serve(stream, server, options);
+
+	if (kernel_tls(stream)) {
+		beast::get_lowest_layer(stream).socket().shutdown(
+			tcp::socket::shutdown_send, ec);
+		co_return;
+	}
+
+	// Clients often close without a close_notify of their own
+	expires_after(stream, options.timeouts.write);
+	co_await stream.async_shutdown(
+		asio::redirect_error(recycled_awaitable, ec));
 }
 
 struct protocol_error {
@@ -137,13 +1430,35 @@ struct protocol_error {
 	bool recoverable = true;
 };
 
-using expected_response = std::expected<response_ptr, protocol_error>;
+using expected_response = std::expected<http_response, protocol_error>;
 
 template <typename server_type, class socket_stream>
-concept responder = requires {
+concept responder =
 	std::is_invocable_r_v<expected_response, server_type,
-						  request_context<socket_stream>, std::string_view>;
-};
+						  request_context<socket_stream> &, std::string_view>;
+
+template <typename server_type>
+concept stream_responder = responder<server_type, tcp_stream> ||
+						   responder<server_type, ssl_stream>;
+
+/**
+ * Responder which may suspend, e.g. for I/O. Composes with synchronous
+ * responders through route() and operator|; synchronous responders in a
+ * composition are still called directly.
+ */
+template <typename server_type, class socket_stream>
+concept async_responder =
+	std::is_invocable_r_v<awaitable<expected_response>, server_type,
+						  request_context<socket_stream> &, std::string_view>;
+
+template <typename server_type>
+concept async_stream_responder = async_responder<server_type, tcp_stream> ||
+								 async_responder<server_type, ssl_stream>;
+
+template <typename server_type, class context_type>
+inline constexpr bool suspends =
+	std::is_invocable_r_v<awaitable<expected_response>, server_type &,
+						  context_type &, std::string_view>;
 
 //==============================================================================
 
@@ -164,23 +1479,106 @@ route(const std::regex &route_regex, upstream_responder upstream) {
 	};
 }
 
+/**
+ * Literal prefix route. Unlike the regex overload it does not type-erase
+ * the upstream responder; use router for larger route sets.
+ */
+template <stream_responder upstream_responder>
+auto route(std::string_view prefix, upstream_responder upstream) {
+	return [prefix = std::string{prefix},
+			upstream](auto &ctx, std::string_view target) -> expected_response {
+		if (!target.starts_with(prefix))
+			return std::unexpected{
+				protocol_error{beast::http::status::not_found, ""}};
+
+		return upstream(ctx, target.substr(prefix.size()));
+	};
+}
+
+/*
+ * Asynchronous variants. The returned responders are coroutines referring
+ * to their captures, so they must outlive the awaiting of their results.
+ */
+
+template <class socket_stream, async_responder<socket_stream> upstream_responder>
+std::function<awaitable<expected_response>(request_context<socket_stream> &,
+										   std::string_view)>
+route(const std::regex &route_regex, upstream_responder upstream) {
+	return [prefix_regex = route_regex,
+			upstream](request_context<socket_stream> &ctx,
+					  std::string_view target) -> awaitable<expected_response> {
+		std::string_view prefix = prefix_matching(target, prefix_regex);
+		if (prefix.data() == nullptr)
+			co_return std::unexpected{
+				protocol_error{beast::http::status::not_found, ""}};
+
+		co_return co_await upstream(ctx, target.substr(prefix.length()));
+	};
+}
+
+template <async_stream_responder upstream_responder>
+auto route(std::string_view prefix, upstream_responder upstream) {
+	return [prefix = std::string{prefix},
+			upstream](auto &ctx,
+					  std::string_view target) -> awaitable<expected_response> {
+		if (!target.starts_with(prefix))
+			co_return std::unexpected{
+				protocol_error{beast::http::status::not_found, ""}};
+
+		co_return co_await upstream(ctx, target.substr(prefix.size()));
+	};
+}
+
 //==============================================================================
 
-template <class socket_stream, responder<socket_stream> first_responder,
-		  responder<socket_stream> next_responder>
-std::function<expected_response(request_context<socket_stream> &,
-								std::string_view)>
-operator|(first_responder first, next_responder next) {
-	return [first, next](request_context<socket_stream> &ctx,
+/**
+ * Tries the next responder if the first one fails with a recoverable error.
+ */
+template <stream_responder first_responder, stream_responder next_responder>
+auto operator|(first_responder first, next_responder next) {
+	return [first, next](auto &ctx,
 						 std::string_view target) -> expected_response {
 		expected_response first_response = first(ctx, target);
 		if (first_response.has_value())
 			return first_response;
 
-		if (first.response.error().recoverable)
-			return next_responder(ctx, target);
+		if (first_response.error().recoverable)
+			return next(ctx, target);
+
+		return first_response;
+	};
+}
+
+/**
+ * Asynchronous if either responder is.
+ */
+template <typename first_responder, typename next_responder>
+	requires(stream_responder<first_responder> ||
+			 async_stream_responder<first_responder>) &&
+			(stream_responder<next_responder> ||
+			 async_stream_responder<next_responder>) &&
+			(async_stream_responder<first_responder> ||
+			 async_stream_responder<next_responder>)
+auto operator|(first_responder first, next_responder next) {
+	return [first, next](auto &ctx, std::string_view target)
+			   -> awaitable<expected_response> {
+		using context_type = std::remove_reference_t<decltype(ctx)>;
+
+		// Synchronous responders are called without a coroutine of their own
+		expected_response first_response;
+		if constexpr (suspends<const first_responder, context_type>)
+			first_response = co_await first(ctx, target);
+		else
+			first_response = first(ctx, target);
+
+		if (first_response.has_value() ||
+			!first_response.error().recoverable)
+			co_return first_response;
 
-		return std::unexpected{first_response.error()};
+		if constexpr (suspends<const next_responder, context_type>)
+			co_return co_await next(ctx, target);
+		else
+			co_return next(ctx, target);
 	};
 }
 
@@ -0,0 +1,1710 @@
+/*
+ * http2.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_HTTP2_HPP_
+#define LIB_WEBDONKEY_HTTP2_HPP_
+
+#include <webdonkey/defs.hpp>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <webdonkey/hpack.hpp>
+#include <webdonkey/recycling.hpp>
+
+namespace webdonkey {
+
+struct http2_options {
+	/*
+	 * Serve cleartext connections opened with the HTTP/2 connection
+	 * preface, i.e. h2c with prior knowledge, see http(). HTTP/2 over TLS
+	 * is offered with enable_http2() on the SSL context instead.
+	 */
+	bool prior_knowledge = false;
+
+	// Streams a client may have open at once
+	std::uint32_t max_concurrent_streams = 100;
+
+	// Request body bytes a client may send ahead, per stream and in total
+	std::uint32_t stream_window = 256 * 1024;
+	std::uint32_t connection_window = 1024 * 1024;
+
+	// Largest request header, counted as in RFC 9113, section 6.5.2
+	std::uint32_t max_header_list_size = 64 * 1024;
+
+	/*
+	 * Frames a client may provoke replies to per second: PING and SETTINGS,
+	 * which are acknowledged, and frames on closed streams, which are
+	 * answered with RST_STREAM. A client sending more is told to
+	 * ENHANCE_YOUR_CALM and disconnected.
+	 */
+	std::uint32_t max_control_replies = 1000;
+};
+
+inline constexpr std::string_view http2_preface =
+	"PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+namespace http2_internals {
+
+using clock = std::chrono::steady_clock;
+
+enum frame_type : std::uint8_t {
+	data = 0,
+	headers = 1,
+	priority = 2,
+	rst_stream = 3,
+	settings = 4,
+	push_promise = 5,
+	ping = 6,
+	goaway = 7,
+	window_update = 8,
+	continuation = 9
+};
+
+enum frame_flag : std::uint8_t {
+	end_stream = 0x1,
+	ack = 0x1,
+	end_headers = 0x4,
+	padded = 0x8,
+	priority_info = 0x20
+};
+
+enum error_code : std::uint32_t {
+	no_error = 0,
+	protocol_error = 1,
+	internal_error = 2,
+	flow_control_error = 3,
+	stream_closed = 5,
+	frame_size_error = 6,
+	refused_stream = 7,
+	cancel = 8,
+	compression_error = 9,
+	enhance_your_calm = 11
+};
+
+enum setting : std::uint16_t {
+	header_table_size = 1,
+	enable_push = 2,
+	max_concurrent_streams = 3,
+	initial_window_size = 4,
+	max_frame_size = 5,
+	max_header_list_size = 6
+};
+
+inline constexpr std::size_t frame_header_size = 9;
+inline constexpr std::uint32_t default_window = 65535;
+inline constexpr std::uint32_t default_frame_size = 16384;
+inline constexpr std::int64_t max_window = 0x7fffffff;
+
+inline std::uint32_t read_u32(const unsigned char *p) {
+	return (std::uint32_t{p[0]} << 24) | (std::uint32_t{p[1]} << 16) |
+		   (std::uint32_t{p[2]} << 8) | std::uint32_t{p[3]};
+}
+
+inline void put_u32(unsigned char *p, std::uint32_t value) {
+	p[0] = static_cast<unsigned char>(value >> 24);
+	p[1] = static_cast<unsigned char>(value >> 16);
+	p[2] = static_cast<unsigned char>(value >> 8);
+	p[3] = static_cast<unsigned char>(value);
+}
+
+/*
+ * Wakes the one coroutine or operation waiting for a change of state.
+ * A notification given while nobody waits makes the next wait return at
+ * once, so none is lost. Waiters recheck their condition after waking.
+ */
+class event {
+public:
+	explicit event(const asio::any_io_executor &executor) :
+		_timer{executor} {}
+
+	void notify() {
+		_notified = true;
+		if (_waiting)
+			_timer.cancel();
+	}
+
+	// Consumes a pending notification
+	bool notified() { return std::exchange(_notified, false); }
+
+	template <class handler_type>
+	void async_wait(clock::time_point deadline, handler_type &&handler) {
+		_waiting = true;
+		_timer.expires_at(deadline);
+		_timer.async_wait(std::forward<handler_type>(handler));
+	}
+
+	/*
+	 * To be called when a wait started with async_wait() completes.
+	 * @return false if the deadline has passed.
+	 */
+	bool done_waiting() {
+		_waiting = false;
+		return notified() || (clock::now() < _timer.expiry());
+	}
+
+	awaitable<bool> wait(clock::time_point deadline) {
+		if (notified())
+			co_return true;
+
+		beast::error_code ec;
+		_waiting = true;
+		_timer.expires_at(deadline);
+		co_await _timer.async_wait(asio::redirect_error(recycled_awaitable, ec));
+		co_return done_waiting();
+	}
+
+private:
+	asio::steady_timer _timer;
+	bool _waiting = false;
+	bool _notified = false;
+};
+
+/*
+ * Pseudo-header and regular fields of a request header block, turned
+ * into an HTTP/1.1 style header as they are decoded.
+ */
+struct request_builder {
+	std::string method;
+	std::string scheme;
+	std::string authority;
+	std::string path;
+	std::string fields;
+	std::string cookie;
+	std::optional<std::uint64_t> content_length;
+	std::size_t size = 0;
+	std::size_t size_limit = 0;
+	bool host = false;
+	bool regular = false;
+	bool malformed = false;
+
+	void clear() {
+		method.clear();
+		scheme.clear();
+		authority.clear();
+		path.clear();
+		fields.clear();
+		cookie.clear();
+		content_length.reset();
+		size = 0;
+		host = false;
+		regular = false;
+		malformed = false;
+	}
+
+	static bool token_char(char c) {
+		return ((c >= 'a') && (c <= 'z')) || ((c >= '0') && (c <= '9')) ||
+			   (std::string_view{"!#$%&'*+-.^_`|~"}.find(c) !=
+				std::string_view::npos);
+	}
+
+	static bool valid_value(std::string_view value) {
+		return value.find_first_of(std::string_view{"\0\r\n", 3}) ==
+			   std::string_view::npos;
+	}
+
+	bool pseudo(std::string &target, std::string_view value) {
+		if (regular || !target.empty() || value.empty() ||
+			!valid_value(value))
+			return false;
+
+		target.assign(value);
+		return true;
+	}
+
+	void field(std::string_view name, std::string_view value) {
+		size += name.size() + value.size() + 32;
+		if (malformed || (size > size_limit) || name.empty()) {
+			malformed = true;
+			return;
+		}
+
+		if (name.front() == ':') {
+			if (name == ":method")
+				malformed = !pseudo(method, value);
+			else if (name == ":scheme")
+				malformed = !pseudo(scheme, value);
+			else if (name == ":authority")
+				malformed = !pseudo(authority, value);
+			else if (name == ":path")
+				malformed = !pseudo(path, value);
+			else
+				malformed = true;
+			return;
+		}
+
+		regular = true;
+		if (!std::all_of(name.begin(), name.end(), token_char) ||
+			!valid_value(value)) {
+			malformed = true;
+			return;
+		}
+
+		// Connection-specific fields, RFC 9113, section 8.2.2
+		if ((name == "connection") || (name == "keep-alive") ||
+			(name == "proxy-connection") || (name == "transfer-encoding") ||
+			(name == "upgrade") || ((name == "te") && (value != "trailers"))) {
+			malformed = true;
+			return;
+		}
+
+		// Cookie crumbs are joined for HTTP/1.1, RFC 9113, section 8.2.3
+		if (name == "cookie") {
+			if (!cookie.empty())
+				cookie.append("; ");
+			cookie.append(value);
+			return;
+		}
+
+		if (name == "content-length") {
+			std::uint64_t length = 0;
+			auto [end, ec] = std::from_chars(
+				value.data(), value.data() + value.size(), length);
+			if ((ec != std::errc{}) || (end != value.data() + value.size()) ||
+				(content_length.has_value() &&
+				 (content_length.value() != length))) {
+				malformed = true;
+				return;
+			}
+
+			content_length = length;
+		}
+
+		if (name == "host")
+			host = true;
+
+		fields.append(name).append(": ").append(value).append("\r\n");
+	}
+
+	/*
+	 * Writes the request as HTTP/1.1 text; Beast parses no other version.
+	 * Bodies of unknown length are sent chunked.
+	 * @return false if the request is malformed.
+	 */
+	bool build(std::string &text, bool end_stream) const {
+		if (malformed || method.empty() || scheme.empty() || path.empty() ||
+			!std::all_of(method.begin(), method.end(),
+						 [](char c) {
+							 return token_char(c) ||
+									((c >= 'A') && (c <= 'Z'));
+						 }) ||
+			(path.find(' ') != std::string::npos) ||
+			((path.front() != '/') && (path != "*")))
+			return false;
+
+		text.clear();
+		text.append(method).append(" ").append(path).append(" HTTP/1.1\r\n");
+		if (!host && !authority.empty())
+			text.append("host: ").append(authority).append("\r\n");
+
+		text.append(fields);
+		if (!cookie.empty())
+			text.append("cookie: ").append(cookie).append("\r\n");
+
+		if (!end_stream && !content_length.has_value())
+			text.append("transfer-encoding: chunked\r\n");
+
+		// One exchange per stream
+		text.append("connection: close\r\n\r\n");
+		return true;
+	}
+};
+
+} // namespace http2_internals
+
+class http2_session;
+
+/**
+ * Protocol state of one HTTP/2 stream, operated by its http2_stream. The
+ * request waits as HTTP/1.1 text to be read; the HTTP/1.1 response
+ * written is parsed and sent on as HEADERS and DATA frames, as far as
+ * flow control permits.
+ */
+class http2_stream_state {
+public:
+	using clock = http2_internals::clock;
+
+	// Response bytes held while waiting for flow control credit
+	static constexpr std::size_t max_staged = 64 * 1024;
+
+	http2_stream_state(http2_session &session, std::uint32_t id,
+					   std::int64_t send_window, std::int64_t receive_window);
+
+	http2_stream_state(const http2_stream_state &) = delete;
+	http2_stream_state &operator=(const http2_stream_state &) = delete;
+
+	std::uint32_t id() const { return _id; }
+
+	http2_session &session() { return _session; }
+
+	http2_internals::event &event() { return _event; }
+
+	clock::time_point deadline() const { return _deadline; }
+
+	void deadline(clock::time_point at) { _deadline = at; }
+
+	bool reset() const { return _reset; }
+
+	bool request_done() const { return _request_done; }
+
+	bool response_done() const { return _response_done; }
+
+	/*
+	 * Request side, fed by the session.
+	 */
+
+	void start_request(std::string_view text, bool end_stream, bool head,
+					   std::optional<std::uint64_t> content_length);
+
+	// length counts padding, which is returned to the peer at once
+	void receive_data(std::string_view data, std::size_t length,
+					  bool end_stream);
+
+	void end_request();
+
+	/*
+	 * Copies request bytes to buffers.
+	 * @return false if the read has to wait.
+	 */
+	template <class buffers_type>
+	bool read(const buffers_type &buffers, beast::error_code &ec,
+			  std::size_t &transferred) {
+		transferred = 0;
+		ec = {};
+		if (_request.size() > 0) {
+			transferred = asio::buffer_copy(buffers, _request.data());
+			_request.consume(transferred);
+			consumed(transferred);
+			return true;
+		}
+
+		if (_request_done) {
+			ec = asio::error::eof;
+			return true;
+		}
+
+		if (_reset) {
+			ec = asio::error::connection_reset;
+			return true;
+		}
+
+		return beast::buffer_bytes(buffers) == 0;
+	}
+
+	/*
+	 * Response side, fed by the stream's serve().
+	 */
+
+	/*
+	 * Takes response bytes from buffers and sends what it can.
+	 * @return false if the write has to wait.
+	 */
+	template <class buffers_type>
+	bool write(const buffers_type &buffers, beast::error_code &ec,
+			   std::size_t &transferred) {
+		transferred = 0;
+		ec = {};
+		drain();
+		if (_reset) {
+			ec = asio::error::connection_reset;
+			return true;
+		}
+
+		const std::size_t size = beast::buffer_bytes(buffers);
+		if (size == 0)
+			return true;
+
+		if (_response.size() >= max_staged)
+			return false;
+
+		transferred = asio::buffer_copy(
+			_response.prepare(std::min(size, max_staged - _response.size())),
+			buffers);
+		_response.commit(transferred);
+		drain();
+		return true;
+	}
+
+	/*
+	 * Parses staged response bytes, sending frames.
+	 */
+	void drain();
+
+	/*
+	 * Called once serve() is done: completes a response delimited by the
+	 * end of the connection.
+	 */
+	void end_of_response();
+
+	/*
+	 * Sends RST_STREAM unless the stream has already been reset.
+	 */
+	void reset(http2_internals::error_code code);
+
+	// The peer has reset the stream, or the connection is gone
+	void reset_by_peer() {
+		_reset = true;
+		_event.notify();
+	}
+
+	void window_update(std::uint32_t increment);
+
+	void adjust_send_window(std::int64_t delta) {
+		_send_window += delta;
+		_event.notify();
+	}
+
+	// Payload bytes received but not read yet
+	std::size_t buffered() const { return _buffered; }
+
+private:
+	class response_parser : public beast::http::basic_parser<false> {
+	public:
+		response_parser(http2_stream_state &stream, bool head) :
+			_stream{stream} {
+			skip(head);
+			header_limit(64 * 1024);
+			body_limit(std::numeric_limits<std::uint64_t>::max());
+		}
+
+	private:
+		void on_request_impl(beast::http::verb, beast::string_view,
+							 beast::string_view, int,
+							 beast::error_code &) override {}
+
+		void on_response_impl(int code, beast::string_view, int,
+							  beast::error_code &) override {
+			_stream.response_status(code);
+		}
+
+		void on_field_impl(beast::http::field name,
+						   beast::string_view name_string,
+						   beast::string_view value,
+						   beast::error_code &) override {
+			_stream.response_field(
+				name, std::string_view{name_string.data(), name_string.size()},
+				std::string_view{value.data(), value.size()});
+		}
+
+		void on_header_impl(beast::error_code &) override {}
+
+		void on_body_init_impl(const boost::optional<std::uint64_t> &length,
+							   beast::error_code &) override {
+			if (length.has_value())
+				_stream._body_remaining = length.value();
+		}
+
+		std::size_t on_body_impl(beast::string_view body,
+								 beast::error_code &) override {
+			return _stream.send_data(body.data(), body.size());
+		}
+
+		void on_chunk_header_impl(std::uint64_t, beast::string_view,
+								  beast::error_code &) override {}
+
+		std::size_t on_chunk_body_impl(std::uint64_t, beast::string_view body,
+									   beast::error_code &) override {
+			return _stream.send_data(body.data(), body.size());
+		}
+
+		void on_finish_impl(beast::error_code &) override {
+			_stream.end_response();
+		}
+
+		http2_stream_state &_stream;
+	};
+
+	void consumed(std::size_t n);
+
+	void acknowledge(std::size_t n);
+
+	void response_status(int code);
+
+	void response_field(beast::http::field name, std::string_view name_string,
+						std::string_view value);
+
+	void send_headers(bool end_stream);
+
+	std::size_t send_data(const char *data, std::size_t size);
+
+	void end_response();
+
+	http2_session &_session;
+	std::uint32_t _id;
+	http2_internals::event _event;
+	clock::time_point _deadline = clock::time_point::max();
+	bool _reset = false;
+
+	// Request
+	beast::flat_buffer _request;
+	bool _request_done = false;
+	bool _chunked = false;
+	bool _head = false;
+	std::optional<std::uint64_t> _content_length;
+	std::uint64_t _received = 0;
+	std::size_t _buffered = 0;
+	std::size_t _unacknowledged = 0;
+	std::int64_t _receive_window;
+	std::int64_t _window_size;
+
+	// Response
+	std::optional<response_parser> _parser;
+	beast::flat_buffer _response;
+	std::string _header_block;
+	bool _interim = false;
+	bool _headers_sent = false;
+	bool _response_done = false;
+	std::optional<std::uint64_t> _body_remaining;
+	std::int64_t _send_window;
+};
+
+/**
+ * Protocol engine of an HTTP/2 server connection, see RFC 9113: framing,
+ * settings, HPACK, stream states and flow control in both directions. It
+ * does no I/O of its own; serve_http2() feeds it with what it reads and
+ * writes out the frames it queues, while each stream is served as an
+ * http2_stream on the connection's strand.
+ */
+class http2_session {
+public:
+	using clock = http2_internals::clock;
+	using stream_ptr = std::shared_ptr<http2_stream_state>;
+
+	// Streams wait for the writer when this much output is queued
+	static constexpr std::size_t max_output = 256 * 1024;
+
+	http2_session(const asio::any_io_executor &executor,
+				  const http2_options &options) :
+		_executor{executor}, _options{options}, _writer{executor},
+		_drained{executor}, _joined{executor},
+		_receive_window{options.connection_window} {
+		_request.size_limit = options.max_header_list_size;
+	}
+
+	http2_session(const http2_session &) = delete;
+	http2_session &operator=(const http2_session &) = delete;
+
+	const asio::any_io_executor &get_executor() const { return _executor; }
+
+	/**
+	 * Queues the server's connection preface: its SETTINGS and the
+	 * enlargement of the connection's receive window.
+	 */
+	void start() {
+		using namespace http2_internals;
+		unsigned char payload[18];
+		put_setting(payload, max_concurrent_streams,
+					_options.max_concurrent_streams);
+		put_setting(payload + 6, initial_window_size, _options.stream_window);
+		put_setting(payload + 12, max_header_list_size,
+					_options.max_header_list_size);
+		queue(settings, 0, 0, payload, sizeof(payload));
+
+		if (_options.connection_window > default_window)
+			queue_window_update(0, _options.connection_window - default_window);
+	}
+
+	/**
+	 * Processes the complete frames at the start of input.
+	 * @return the number of bytes used; the rest is to be passed again
+	 * with more input.
+	 */
+	std::size_t receive(asio::const_buffer input);
+
+	/**
+	 * @return the next stream whose request header has arrived, or null.
+	 */
+	stream_ptr accept() {
+		if (_accepted.empty())
+			return nullptr;
+
+		stream_ptr next = std::move(_accepted.front());
+		_accepted.pop_front();
+		return next;
+	}
+
+	/**
+	 * True once the connection is going away and no more input is
+	 * processed.
+	 */
+	bool closing() const { return _closing; }
+
+	/**
+	 * Sends GOAWAY, closing the connection once open streams are done.
+	 */
+	void go_away(http2_internals::error_code code) {
+		if (_closing)
+			return;
+
+		_closing = true;
+		unsigned char payload[8];
+		http2_internals::put_u32(payload, _last_stream_id);
+		http2_internals::put_u32(payload + 4, code);
+		queue(http2_internals::goaway, 0, 0, payload, sizeof(payload));
+	}
+
+	/**
+	 * Ends the connection after the input has ended: open streams are
+	 * reset and their waits woken.
+	 */
+	void close() {
+		_closing = true;
+		_closed = true;
+		for (auto &[id, stream] : _streams)
+			stream->reset_by_peer();
+
+		_writer.notify();
+	}
+
+	/*
+	 * Tasks of the connection, i.e. its writer and the coroutines serving
+	 * streams, are counted so that join() can wait for them.
+	 */
+
+	void task_started() { ++_tasks; }
+
+	void task_done() {
+		--_tasks;
+		_joined.notify();
+		_writer.notify();
+		_drained.notify();
+	}
+
+	awaitable<void> join() {
+		while (_tasks > 0)
+			co_await _joined.wait(clock::time_point::max());
+	}
+
+	/**
+	 * Called when the coroutine serving a stream ends.
+	 */
+	void release(const stream_ptr &stream);
+
+	/*
+	 * Output
+	 */
+
+	bool has_output() const { return _output.size() > 0; }
+
+	// Swaps the queued frames into an empty buffer
+	void take_output(beast::flat_buffer &buffer) { std::swap(buffer, _output); }
+
+	/**
+	 * Called after queued frames have been written; streams waiting for
+	 * room in the output retry.
+	 */
+	void written() {
+		for (auto &[id, stream] : _streams)
+			stream->event().notify();
+
+		_drained.notify();
+	}
+
+	/**
+	 * True while so much output is queued that the connection waits for
+	 * the client to take it, reading no more input.
+	 */
+	bool output_full() const { return _output.size() >= max_output; }
+
+	/**
+	 * Waits until queued frames have been written or the writer has ended.
+	 * @return false if the deadline has passed.
+	 */
+	awaitable<bool> wait_for_room(clock::time_point deadline) {
+		return _drained.wait(deadline);
+	}
+
+	// True once the connection is closed and all streams are done
+	bool finished() const { return _closed && (_tasks <= 1) && !has_output(); }
+
+	awaitable<bool> wait_for_output(clock::time_point deadline) {
+		return _writer.wait(deadline);
+	}
+
+	/**
+	 * @return when the connection counts as idle, if no stream is open.
+	 */
+	clock::time_point idle_deadline(clock::duration timeout) const {
+		if ((timeout == clock::duration::zero()) || !_streams.empty())
+			return clock::time_point::max();
+
+		return _last_activity + timeout;
+	}
+
+	/*
+	 * Used by streams
+	 */
+
+	void queue(std::uint8_t type, std::uint8_t flags, std::uint32_t stream,
+			   const void *payload, std::size_t size) {
+		unsigned char header[http2_internals::frame_header_size];
+		header[0] = static_cast<unsigned char>(size >> 16);
+		header[1] = static_cast<unsigned char>(size >> 8);
+		header[2] = static_cast<unsigned char>(size);
+		header[3] = type;
+		header[4] = flags;
+		http2_internals::put_u32(header + 5, stream);
+
+		auto out = _output.prepare(sizeof(header) + size);
+		std::memcpy(out.data(), header, sizeof(header));
+		if (size > 0)
+			std::memcpy(static_cast<char *>(out.data()) + sizeof(header),
+						payload, size);
+		_output.commit(sizeof(header) + size);
+		_writer.notify();
+	}
+
+	void queue_reset(std::uint32_t stream, http2_internals::error_code code) {
+		unsigned char payload[4];
+		http2_internals::put_u32(payload, code);
+		queue(http2_internals::rst_stream, 0, stream, payload,
+			  sizeof(payload));
+	}
+
+	void queue_window_update(std::uint32_t stream, std::uint32_t increment) {
+		unsigned char payload[4];
+		http2_internals::put_u32(payload, increment);
+		queue(http2_internals::window_update, 0, stream, payload,
+			  sizeof(payload));
+	}
+
+	// Largest frame payload the peer accepts
+	std::uint32_t max_frame_size() const { return _max_frame_size; }
+
+	/**
+	 * @return how much DATA the connection can take now.
+	 */
+	std::int64_t send_credit() const {
+		if (output_full())
+			return 0;
+
+		return std::min<std::int64_t>(
+			_send_window, static_cast<std::int64_t>(max_output - _output.size()));
+	}
+
+	void spend(std::size_t n) { _send_window -= static_cast<std::int64_t>(n); }
+
+	/**
+	 * Returns receive window taken by request data which has been read
+	 * or discarded.
+	 */
+	void acknowledge(std::size_t n) {
+		_unacknowledged += n;
+		if (_unacknowledged < _options.connection_window / 2)
+			return;
+
+		queue_window_update(0, static_cast<std::uint32_t>(_unacknowledged));
+		_receive_window += static_cast<std::int64_t>(_unacknowledged);
+		_unacknowledged = 0;
+	}
+
+	// Request body window announced to the peer
+	std::uint32_t stream_window() const { return _options.stream_window; }
+
+private:
+	static void put_setting(unsigned char *p, std::uint16_t id,
+							std::uint32_t value) {
+		p[0] = static_cast<unsigned char>(id >> 8);
+		p[1] = static_cast<unsigned char>(id);
+		http2_internals::put_u32(p + 2, value);
+	}
+
+	stream_ptr find(std::uint32_t id) const {
+		auto it = _streams.find(id);
+		return (it != _streams.end()) ? it->second : nullptr;
+	}
+
+	void frame(std::uint8_t type, std::uint8_t flags, std::uint32_t stream,
+			   std::string_view payload);
+
+	void on_data(std::uint8_t flags, std::uint32_t stream,
+				 std::string_view payload);
+
+	void on_headers(std::uint8_t flags, std::uint32_t stream,
+					std::string_view payload);
+
+	void on_continuation(std::uint8_t flags, std::uint32_t stream,
+						 std::string_view payload);
+
+	void header_block_done();
+
+	void on_settings(std::uint8_t flags, std::uint32_t stream,
+					 std::string_view payload);
+
+	void on_window_update(std::uint32_t stream, std::string_view payload);
+
+	/*
+	 * Counts a reply to a control frame of the client.
+	 * @return false if the client has sent too many of them; the
+	 * connection is then going away.
+	 */
+	bool reply_allowed() {
+		const clock::time_point now = clock::now();
+		if (now - _replies_since >= std::chrono::seconds{1}) {
+			_replies_since = now;
+			_replies = 0;
+		}
+
+		if (++_replies <= _options.max_control_replies)
+			return true;
+
+		go_away(http2_internals::enhance_your_calm);
+		return false;
+	}
+
+	// Strips padding; false if the padding is malformed
+	static bool unpad(std::uint8_t flags, std::string_view &payload) {
+		if (!(flags & http2_internals::padded))
+			return true;
+
+		if (payload.empty())
+			return false;
+
+		const std::size_t padding = static_cast<unsigned char>(payload[0]);
+		payload.remove_prefix(1);
+		if (padding > payload.size())
+			return false;
+
+		payload.remove_suffix(padding);
+		return true;
+	}
+
+	asio::any_io_executor _executor;
+	http2_options _options;
+	http2_internals::event _writer;
+	http2_internals::event _drained;
+	http2_internals::event _joined;
+	std::size_t _tasks = 0;
+
+	hpack_decoder _decoder;
+	http2_internals::request_builder _request;
+	std::string _request_text;
+
+	std::unordered_map<std::uint32_t, stream_ptr> _streams;
+	std::deque<stream_ptr> _accepted;
+	std::uint32_t _last_stream_id = 0;
+
+	bool _preface_received = false;
+	bool _settings_received = false;
+	bool _closing = false;
+	bool _closed = false;
+	clock::time_point _last_activity = clock::now();
+
+	// Replies to control frames in the current second
+	clock::time_point _replies_since = clock::now();
+	std::uint32_t _replies = 0;
+
+	// Header block being collected from HEADERS and CONTINUATION frames
+	std::string _header_block;
+	std::uint32_t _header_stream = 0;
+	bool _header_end_stream = false;
+	bool _continuation_expected = false;
+
+	// Peer settings and flow control
+	std::int64_t _peer_initial_window = http2_internals::default_window;
+	std::uint32_t _max_frame_size = http2_internals::default_frame_size;
+	std::int64_t _send_window = http2_internals::default_window;
+	std::int64_t _receive_window;
+	std::size_t _unacknowledged = 0;
+
+	beast::flat_buffer _output;
+};
+
+//==============================================================================
+
+inline http2_stream_state::http2_stream_state(http2_session &session,
+											  std::uint32_t id,
+											  std::int64_t send_window,
+											  std::int64_t receive_window) :
+	_session{session}, _id{id}, _event{session.get_executor()},
+	_receive_window{receive_window}, _window_size{receive_window},
+	_send_window{send_window} {}
+
+inline void
+http2_stream_state::start_request(std::string_view text, bool end_stream,
+								  bool head,
+								  std::optional<std::uint64_t> content_length) {
+	auto out = _request.prepare(text.size());
+	asio::buffer_copy(out, asio::buffer(text));
+	_request.commit(text.size());
+
+	_chunked = !end_stream && !content_length.has_value();
+	_content_length = content_length;
+	_head = head;
+	_parser.emplace(*this, head);
+	if (end_stream)
+		end_request();
+}
+
+inline void http2_stream_state::receive_data(std::string_view data,
+											 std::size_t length,
+											 bool end_stream) {
+	using namespace http2_internals;
+	if (_request_done || _reset) {
+		_session.acknowledge(length);
+		reset(stream_closed);
+		return;
+	}
+
+	if (static_cast<std::int64_t>(length) > _receive_window) {
+		_session.acknowledge(length);
+		reset(flow_control_error);
+		return;
+	}
+
+	_receive_window -= static_cast<std::int64_t>(length);
+	_received += data.size();
+	if (_content_length.has_value() && (_received > _content_length.value())) {
+		_session.acknowledge(length);
+		reset(protocol_error);
+		return;
+	}
+
+	if (_chunked && !data.empty()) {
+		char size[20];
+		auto [end, ec] = std::to_chars(size, size + sizeof(size) - 2,
+									   data.size(), 16);
+		*end++ = '\r';
+		*end++ = '\n';
+		const std::size_t header_size = end - size;
+		auto out = _request.prepare(header_size + data.size() + 2);
+		asio::buffer_copy(out, std::array<asio::const_buffer, 3>{
+								   asio::buffer(size, header_size),
+								   asio::buffer(data), asio::buffer("\r\n", 2)});
+		_request.commit(header_size + data.size() + 2);
+	} else if (!data.empty()) {
+		asio::buffer_copy(_request.prepare(data.size()), asio::buffer(data));
+		_request.commit(data.size());
+	}
+
+	_buffered += data.size();
+
+	// Padding is never read, so it is returned at once
+	acknowledge(length - data.size());
+
+	if (end_stream)
+		end_request();
+
+	_event.notify();
+}
+
+inline void http2_stream_state::end_request() {
+	if (_request_done)
+		return;
+
+	if (_content_length.has_value() && (_received != _content_length.value())) {
+		reset(http2_internals::protocol_error);
+		return;
+	}
+
+	if (_chunked) {
+		static constexpr std::string_view last_chunk = "0\r\n\r\n";
+		asio::buffer_copy(_request.prepare(last_chunk.size()),
+						  asio::buffer(last_chunk));
+		_request.commit(last_chunk.size());
+	}
+
+	_request_done = true;
+	_event.notify();
+}
+
+inline void http2_stream_state::consumed(std::size_t n) {
+	const std::size_t payload = std::min(n, _buffered);
+	_buffered -= payload;
+	acknowledge(payload);
+}
+
+inline void http2_stream_state::acknowledge(std::size_t n) {
+	if (n == 0)
+		return;
+
+	_session.acknowledge(n);
+	if (_request_done || _reset)
+		return;
+
+	_unacknowledged += n;
+	if (_unacknowledged < static_cast<std::size_t>(_window_size / 2))
+		return;
+
+	_session.queue_window_update(_id,
+								 static_cast<std::uint32_t>(_unacknowledged));
+	_receive_window += static_cast<std::int64_t>(_unacknowledged);
+	_unacknowledged = 0;
+}
+
+inline void http2_stream_state::drain() {
+	while (!_reset && _parser.has_value()) {
+		if (_parser->is_done()) {
+			// Interim responses are dropped, the final one follows
+			if (_interim) {
+				_interim = false;
+				_parser.emplace(*this, _head);
+				continue;
+			}
+
+			_response.consume(_response.size());
+			break;
+		}
+
+		if (_response.size() == 0)
+			break;
+
+		beast::error_code ec;
+		const std::size_t used = _parser->put(_response.data(), ec);
+		_response.consume(used);
+		if (ec == beast::http::error::need_more)
+			break;
+
+		if (ec) {
+			reset(http2_internals::internal_error);
+			break;
+		}
+
+		if (used == 0)
+			break;
+	}
+}
+
+inline void http2_stream_state::end_of_response() {
+	drain();
+	if (_reset || !_parser.has_value() || _parser->is_done() ||
+		(_response.size() > 0))
+		return;
+
+	if (!_parser->need_eof()) {
+		reset(http2_internals::internal_error);
+		return;
+	}
+
+	beast::error_code ec;
+	_parser->put_eof(ec);
+	if (ec)
+		reset(http2_internals::internal_error);
+}
+
+inline void http2_stream_state::reset(http2_internals::error_code code) {
+	if (!_reset)
+		_session.queue_reset(_id, code);
+
+	_reset = true;
+	_event.notify();
+}
+
+inline void http2_stream_state::window_update(std::uint32_t increment) {
+	if (increment == 0) {
+		reset(http2_internals::protocol_error);
+		return;
+	}
+
+	_send_window += increment;
+	if (_send_window > http2_internals::max_window) {
+		reset(http2_internals::flow_control_error);
+		return;
+	}
+
+	_event.notify();
+}
+
+inline void http2_stream_state::response_status(int code) {
+	_interim = (code / 100 == 1);
+	if (_interim)
+		return;
+
+	_header_block.clear();
+	hpack_encoder::status(_header_block, static_cast<unsigned>(code));
+}
+
+inline void http2_stream_state::response_field(beast::http::field name,
+											   std::string_view name_string,
+											   std::string_view value) {
+	if (_interim)
+		return;
+
+	switch (name) {
+	case beast::http::field::connection:
+	case beast::http::field::keep_alive:
+	case beast::http::field::proxy_connection:
+	case beast::http::field::transfer_encoding:
+	case beast::http::field::upgrade:
+		return;
+	default:
+		hpack_encoder::field(_header_block, name_string, value);
+	}
+}
+
+inline void http2_stream_state::send_headers(bool end_stream) {
+	using namespace http2_internals;
+	std::string_view block = _header_block;
+	const std::size_t limit = _session.max_frame_size();
+	std::uint8_t type = headers;
+	std::uint8_t flags = end_stream ? http2_internals::end_stream : 0;
+	do {
+		const std::string_view fragment = block.substr(0, limit);
+		block.remove_prefix(fragment.size());
+		if (block.empty())
+			flags |= end_headers;
+
+		_session.queue(type, flags, _id, fragment.data(), fragment.size());
+		type = continuation;
+		flags = 0;
+	} while (!block.empty());
+
+	_headers_sent = true;
+	_response_done = end_stream;
+}
+
+inline std::size_t http2_stream_state::send_data(const char *data,
+												 std::size_t size) {
+	if (_interim || _reset || _response_done)
+		return size;
+
+	if (!_headers_sent)
+		send_headers(false);
+
+	const std::int64_t credit =
+		std::min(_send_window, _session.send_credit());
+	if (credit <= 0)
+		return 0;
+
+	const std::size_t sent =
+		std::min(size, static_cast<std::size_t>(credit));
+	const bool last = _body_remaining.has_value() &&
+					  (_body_remaining.value() == sent);
+	if (_body_remaining.has_value())
+		_body_remaining.value() -= sent;
+
+	const std::size_t limit = _session.max_frame_size();
+	for (std::size_t offset = 0; offset < sent; offset += limit) {
+		const std::size_t frame_size = std::min(limit, sent - offset);
+		const bool end = last && (offset + frame_size == sent);
+		_session.queue(http2_internals::data,
+					   end ? http2_internals::end_stream : 0, _id,
+					   data + offset, frame_size);
+	}
+
+	_send_window -= static_cast<std::int64_t>(sent);
+	_session.spend(sent);
+	_response_done = last;
+	return sent;
+}
+
+inline void http2_stream_state::end_response() {
+	if (_interim || _reset || _response_done)
+		return;
+
+	if (!_headers_sent) {
+		send_headers(true);
+		return;
+	}
+
+	_session.queue(http2_internals::data, http2_internals::end_stream, _id,
+				   nullptr, 0);
+	_response_done = true;
+}
+
+//==============================================================================
+
+inline std::size_t http2_session::receive(asio::const_buffer input) {
+	using namespace http2_internals;
+	auto data = static_cast<const unsigned char *>(input.data());
+	const std::size_t size = input.size();
+	std::size_t used = 0;
+	if (size == 0)
+		return 0;
+
+	if (!_preface_received) {
+		const std::size_t compared = std::min(size, http2_preface.size());
+		if (std::memcmp(data, http2_preface.data(), compared) != 0) {
+			go_away(protocol_error);
+			return size;
+		}
+
+		if (size < http2_preface.size())
+			return 0;
+
+		used = http2_preface.size();
+		_preface_received = true;
+	}
+
+	while (!_closing && (size - used >= frame_header_size)) {
+		const unsigned char *p = data + used;
+		const std::uint32_t length = (std::uint32_t{p[0]} << 16) |
+									 (std::uint32_t{p[1]} << 8) | p[2];
+
+		// Frames are never larger than the default, which is all we announce
+		if (length > default_frame_size) {
+			go_away(frame_size_error);
+			break;
+		}
+
+		if (size - used - frame_header_size < length)
+			break;
+
+		used += frame_header_size + length;
+		_last_activity = clock::now();
+		frame(p[3], p[4], read_u32(p + 5) & 0x7fffffff,
+			  std::string_view{reinterpret_cast<const char *>(p) +
+								   frame_header_size,
+							   length});
+	}
+
+	return used;
+}
+
+inline void http2_session::frame(std::uint8_t type, std::uint8_t flags,
+								 std::uint32_t stream,
+								 std::string_view payload) {
+	using namespace http2_internals;
+
+	// The client's preface ends with its SETTINGS
+	if (!_settings_received) {
+		if ((type != settings) || (flags & ack)) {
+			go_away(protocol_error);
+			return;
+		}
+
+		_settings_received = true;
+	}
+
+	// A header block must not be interleaved with other frames
+	if (_continuation_expected && (type != continuation)) {
+		go_away(protocol_error);
+		return;
+	}
+
+	switch (type) {
+	case data:
+		on_data(flags, stream, payload);
+		break;
+	case headers:
+		on_headers(flags, stream, payload);
+		break;
+	case priority:
+		if (stream == 0)
+			go_away(protocol_error);
+		else if ((payload.size() != 5) && reply_allowed())
+			queue_reset(stream, frame_size_error);
+		break;
+	case rst_stream:
+		if ((stream == 0) || (stream > _last_stream_id))
+			go_away(protocol_error);
+		else if (payload.size() != 4)
+			go_away(frame_size_error);
+		else if (stream_ptr found = find(stream))
+			found->reset_by_peer();
+		break;
+	case settings:
+		on_settings(flags, stream, payload);
+		break;
+	case ping:
+		if (stream != 0)
+			go_away(protocol_error);
+		else if (payload.size() != 8)
+			go_away(frame_size_error);
+		else if (!(flags & ack) && reply_allowed())
+			queue(ping, ack, 0, payload.data(), payload.size());
+		break;
+	case goaway:
+		// The client opens no more streams; open ones are still served
+		if (stream != 0)
+			go_away(protocol_error);
+		break;
+	case window_update:
+		on_window_update(stream, payload);
+		break;
+	case continuation:
+		on_continuation(flags, stream, payload);
+		break;
+	case push_promise:
+		go_away(protocol_error);
+		break;
+	default:
+		// Unknown frame types are ignored, RFC 9113, section 4.1
+		break;
+	}
+}
+
+inline void http2_session::on_data(std::uint8_t flags, std::uint32_t stream,
+								   std::string_view payload) {
+	using namespace http2_internals;
+	if (stream == 0) {
+		go_away(protocol_error);
+		return;
+	}
+
+	const std::size_t length = payload.size();
+	if (static_cast<std::int64_t>(length) > _receive_window) {
+		go_away(flow_control_error);
+		return;
+	}
+
+	_receive_window -= static_cast<std::int64_t>(length);
+	if (!unpad(flags, payload)) {
+		go_away(protocol_error);
+		return;
+	}
+
+	stream_ptr found = find(stream);
+	if (!found) {
+		acknowledge(length);
+		if (stream > _last_stream_id)
+			go_away(protocol_error);
+		else if (reply_allowed())
+			queue_reset(stream, stream_closed);
+		return;
+	}
+
+	found->receive_data(payload, length, flags & end_stream);
+}
+
+inline void http2_session::on_headers(std::uint8_t flags, std::uint32_t stream,
+									  std::string_view payload) {
+	using namespace http2_internals;
+	if ((stream == 0) || !unpad(flags, payload)) {
+		go_away(protocol_error);
+		return;
+	}
+
+	if (flags & priority_info) {
+		if (payload.size() < 5) {
+			go_away(protocol_error);
+			return;
+		}
+
+		payload.remove_prefix(5);
+	}
+
+	_header_block.assign(payload);
+	_header_stream = stream;
+	_header_end_stream = flags & end_stream;
+	_continuation_expected = !(flags & end_headers);
+	if (!_continuation_expected)
+		header_block_done();
+}
+
+inline void http2_session::on_continuation(std::uint8_t flags,
+										   std::uint32_t stream,
+										   std::string_view payload) {
+	using namespace http2_internals;
+	if (!_continuation_expected || (stream != _header_stream)) {
+		go_away(protocol_error);
+		return;
+	}
+
+	// Compressed fields are never larger than decoded ones
+	if (_header_block.size() + payload.size() >
+		_options.max_header_list_size) {
+		go_away(enhance_your_calm);
+		return;
+	}
+
+	_header_block.append(payload);
+	_continuation_expected = !(flags & end_headers);
+	if (!_continuation_expected)
+		header_block_done();
+}
+
+inline void http2_session::header_block_done() {
+	using namespace http2_internals;
+
+	// Every block is decoded, to keep the dynamic table in step
+	_request.clear();
+	if (!_decoder.decode(_header_block,
+						 [this](std::string_view name, std::string_view value) {
+							 _request.field(name, value);
+						 })) {
+		go_away(compression_error);
+		return;
+	}
+
+	const std::uint32_t id = _header_stream;
+
+	// Trailers end the request; their fields are dropped
+	if (stream_ptr found = find(id)) {
+		if (found->request_done() || !_header_end_stream)
+			found->reset(protocol_error);
+		else
+			found->end_request();
+		return;
+	}
+
+	if ((id % 2 == 0) || (id <= _last_stream_id)) {
+		go_away(protocol_error);
+		return;
+	}
+
+	_last_stream_id = id;
+	if (_closing)
+		return;
+
+	if (_streams.size() >= _options.max_concurrent_streams) {
+		queue_reset(id, refused_stream);
+		return;
+	}
+
+	if (!_request.build(_request_text, _header_end_stream)) {
+		queue_reset(id, protocol_error);
+		return;
+	}
+
+	auto stream = std::make_shared<http2_stream_state>(
+		*this, id, _peer_initial_window, _options.stream_window);
+	stream->start_request(_request_text, _header_end_stream,
+						  _request.method == "HEAD", _request.content_length);
+	_streams.emplace(id, stream);
+	_accepted.push_back(std::move(stream));
+}
+
+inline void http2_session::on_settings(std::uint8_t flags, std::uint32_t stream,
+									   std::string_view payload) {
+	using namespace http2_internals;
+	if (stream != 0) {
+		go_away(protocol_error);
+		return;
+	}
+
+	if (flags & ack) {
+		if (!payload.empty())
+			go_away(frame_size_error);
+		return;
+	}
+
+	if (payload.size() % 6 != 0) {
+		go_away(frame_size_error);
+		return;
+	}
+
+	auto p = reinterpret_cast<const unsigned char *>(payload.data());
+	for (const unsigned char *end = p + payload.size(); p != end; p += 6) {
+		const std::uint16_t id =
+			static_cast<std::uint16_t>((std::uint16_t{p[0]} << 8) | p[1]);
+		const std::uint32_t value = read_u32(p + 2);
+		switch (id) {
+		case enable_push:
+			if (value > 1) {
+				go_away(protocol_error);
+				return;
+			}
+			break;
+		case initial_window_size: {
+			if (value > max_window) {
+				go_away(flow_control_error);
+				return;
+			}
+
+			// Applies to the send windows of open streams as well
+			const std::int64_t delta = value - _peer_initial_window;
+			_peer_initial_window = value;
+			for (auto &[stream_id, open] : _streams)
+				open->adjust_send_window(delta);
+		} break;
+		case http2_internals::max_frame_size:
+			if ((value < default_frame_size) || (value > 0xffffff)) {
+				go_away(protocol_error);
+				return;
+			}
+
+			_max_frame_size = value;
+			break;
+		default:
+			// The encoder keeps no dynamic table, so its size is moot
+			break;
+		}
+	}
+
+	if (reply_allowed())
+		queue(settings, ack, 0, nullptr, 0);
+}
+
+inline void http2_session::on_window_update(std::uint32_t stream,
+											std::string_view payload) {
+	using namespace http2_internals;
+	if (payload.size() != 4) {
+		go_away(frame_size_error);
+		return;
+	}
+
+	const std::uint32_t increment =
+		read_u32(reinterpret_cast<const unsigned char *>(payload.data())) &
+		0x7fffffff;
+	if (stream != 0) {
+		if (stream_ptr found = find(stream))
+			found->window_update(increment);
+		else if (stream > _last_stream_id)
+			go_away(protocol_error);
+		return;
+	}
+
+	_send_window += increment;
+	if ((increment == 0) || (_send_window > max_window)) {
+		go_away(increment == 0 ? protocol_error : flow_control_error);
+		return;
+	}
+
+	for (auto &[id, open] : _streams)
+		open->event().notify();
+}
+
+inline void http2_session::release(const stream_ptr &stream) {
+	using namespace http2_internals;
+	if (!stream->reset()) {
+		// The client need not send the rest of a body nobody reads
+		if (!stream->response_done())
+			stream->reset(internal_error);
+		else if (!stream->request_done())
+			stream->reset(no_error);
+	}
+
+	acknowledge(stream->buffered());
+	_streams.erase(stream->id());
+	_last_activity = clock::now();
+	_writer.notify();
+}
+
+//==============================================================================
+
+/**
+ * One HTTP/2 stream, seen as a connection carrying a single HTTP/1.1
+ * exchange: reads yield the request as HTTP/1.1 text, and the HTTP/1.1
+ * response written to it goes out as HEADERS and DATA frames. Streams are
+ * thus served by serve() with any responder which is generic over the
+ * stream type.
+ *
+ * Deadlines apply to waits for request data and for flow control credit.
+ */
+class http2_stream {
+public:
+	using executor_type = asio::any_io_executor;
+	using clock = http2_internals::clock;
+
+	http2_stream(std::shared_ptr<http2_stream_state> state,
+				 tcp::socket &socket) :
+		_state{std::move(state)}, _socket{&socket} {}
+
+	executor_type get_executor() const noexcept {
+		return _state->session().get_executor();
+	}
+
+	// The connection's socket, e.g. for the peer address
+	tcp::socket &socket() { return *_socket; }
+
+	const std::shared_ptr<http2_stream_state> &state() const { return _state; }
+
+	void expires_after(clock::duration timeout) {
+		_state->deadline(clock::now() + timeout);
+	}
+
+	void expires_never() { _state->deadline(clock::time_point::max()); }
+
+	template <class buffers_type, class token_type>
+	auto async_read_some(const buffers_type &buffers, token_type &&token) {
+		return asio::async_compose<token_type,
+								   void(beast::error_code, std::size_t)>(
+			operation<buffers_type, false>{_state.get(), buffers}, token,
+			get_executor());
+	}
+
+	template <class buffers_type, class token_type>
+	auto async_write_some(const buffers_type &buffers, token_type &&token) {
+		return asio::async_compose<token_type,
+								   void(beast::error_code, std::size_t)>(
+			operation<buffers_type, true>{_state.get(), buffers}, token,
+			get_executor());
+	}
+
+	/**
+	 * Waits until the response has been sent in full, after serve()
+	 * returns.
+	 */
+	awaitable<void> finish() {
+		for (;;) {
+			_state->end_of_response();
+			if (_state->response_done() || _state->reset())
+				co_return;
+
+			// Not awaited within the condition, which GCC 12 miscompiles
+			const bool woken =
+				co_await _state->event().wait(_state->deadline());
+			if (!woken)
+				throw boost::system::system_error{beast::error::timeout};
+		}
+	}
+
+private:
+	template <class buffers_type, bool writing> struct operation {
+		http2_stream_state *state;
+		buffers_type buffers;
+		bool waiting = false;
+		bool completing = false;
+		beast::error_code result{};
+		std::size_t transferred = 0;
+
+		template <class self_type>
+		void operator()(self_type &self, beast::error_code = {}) {
+			if (completing) {
+				self.complete(result, transferred);
+				return;
+			}
+
+			const bool resumed = std::exchange(waiting, false);
+			if (resumed && !state->event().done_waiting()) {
+				complete(self, beast::error::timeout, resumed);
+				return;
+			}
+
+			for (;;) {
+				bool ready;
+				if constexpr (writing)
+					ready = state->write(buffers, result, transferred);
+				else
+					ready = state->read(buffers, result, transferred);
+
+				if (ready) {
+					complete(self, result, resumed);
+					return;
+				}
+
+				if (!state->event().notified())
+					break;
+			}
+
+			waiting = true;
+			state->event().async_wait(state->deadline(), std::move(self));
+		}
+
+		// Completions within the initiating function are posted
+		template <class self_type>
+		void complete(self_type &self, beast::error_code ec, bool resumed) {
+			if (resumed) {
+				self.complete(ec, transferred);
+				return;
+			}
+
+			result = ec;
+			completing = true;
+			asio::post(std::move(self));
+		}
+	};
+
+	std::shared_ptr<http2_stream_state> _state;
+	tcp::socket *_socket;
+};
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_HTTP2_HPP_ */
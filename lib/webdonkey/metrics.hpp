@@ -0,0 +1,493 @@
+/*
+ * metrics.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_METRICS_HPP_
+#define LIB_WEBDONKEY_METRICS_HPP_
+
+#include <webdonkey/admission.hpp>
+#include <webdonkey/defs.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace webdonkey {
+
+/**
+ * Log-linear latency histogram in microseconds, in the manner of HDR
+ * histograms: 16 linear buckets per power of two, i.e. a relative error
+ * of about 6%, up to about 19 hours. Every instance has a single writer;
+ * readers may merge it at any time.
+ */
+class latency_histogram {
+public:
+	static constexpr unsigned sub_bucket_bits = 4;
+	static constexpr unsigned max_magnitude = 36;
+	static constexpr std::size_t bucket_count =
+		(max_magnitude - sub_bucket_bits + 1) << sub_bucket_bits;
+
+	static std::size_t bucket(std::uint64_t value) {
+		static constexpr std::uint64_t linear = 2 << sub_bucket_bits;
+		if (value < linear)
+			return static_cast<std::size_t>(value);
+
+		const unsigned shift = std::bit_width(value) - (sub_bucket_bits + 1);
+		const std::size_t index = (static_cast<std::size_t>(shift)
+								   << sub_bucket_bits) +
+								  static_cast<std::size_t>(value >> shift);
+		return std::min(index, bucket_count - 1);
+	}
+
+	// Highest value falling into a bucket
+	static std::uint64_t bucket_limit(std::size_t index) {
+		static constexpr std::size_t linear = 2 << sub_bucket_bits;
+		if (index < linear)
+			return index;
+
+		const unsigned shift =
+			static_cast<unsigned>(index >> sub_bucket_bits) - 1;
+		const std::uint64_t mantissa =
+			(index & ((1u << sub_bucket_bits) - 1)) | (1u << sub_bucket_bits);
+		return ((mantissa + 1) << shift) - 1;
+	}
+
+	/**
+	 * @return the upper bound in microseconds of the q-quantile of merged
+	 * bucket counts, or zero if there are none.
+	 */
+	static std::uint64_t quantile(const std::vector<std::uint64_t> &buckets,
+								  double q) {
+		std::uint64_t count = 0;
+		for (std::uint64_t bucket : buckets)
+			count += bucket;
+
+		if (count == 0)
+			return 0;
+
+		const std::uint64_t rank = std::max<std::uint64_t>(
+			static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(count))),
+			1);
+		std::uint64_t seen = 0;
+		for (std::size_t b = 0; b < buckets.size(); ++b) {
+			seen += buckets[b];
+			if (seen >= rank)
+				return bucket_limit(b);
+		}
+
+		return bucket_limit(buckets.size() - 1);
+	}
+
+	void record(std::chrono::nanoseconds latency) {
+		const std::uint64_t micros =
+			static_cast<std::uint64_t>(std::max<std::int64_t>(
+				std::chrono::duration_cast<std::chrono::microseconds>(latency)
+					.count(),
+				0));
+		increment(_buckets[bucket(micros)], 1);
+		increment(_sum_ns, static_cast<std::uint64_t>(latency.count()));
+	}
+
+	/**
+	 * Adds the counts of this histogram to a merged one.
+	 */
+	void merge_into(std::vector<std::uint64_t> &buckets,
+					std::uint64_t &sum_ns) const {
+		buckets.resize(bucket_count);
+		for (std::size_t i = 0; i < bucket_count; ++i)
+			buckets[i] += _buckets[i].load(std::memory_order_relaxed);
+
+		sum_ns += _sum_ns.load(std::memory_order_relaxed);
+	}
+
+private:
+	// Single writer: no read-modify-write needed
+	static void increment(std::atomic<std::uint64_t> &counter,
+						  std::uint64_t value) {
+		counter.store(counter.load(std::memory_order_relaxed) + value,
+					  std::memory_order_relaxed);
+	}
+
+	std::array<std::atomic<std::uint64_t>, bucket_count> _buckets{};
+	std::atomic<std::uint64_t> _sum_ns = 0;
+};
+
+/**
+ * Counters, latency histograms and gauges exported in the Prometheus text
+ * format. Counters and histograms are recorded on per-thread shards
+ * without locks or shared cache lines, and merged on scrape.
+ *
+ * Metrics are identified by name and label set, e.g. route="static". They
+ * can be registered at any time, up to max_counters counters and
+ * max_histograms histograms.
+ */
+class metrics_registry {
+public:
+	static constexpr std::size_t max_counters = 256;
+	static constexpr std::size_t max_histograms = 64;
+	static constexpr std::size_t max_status = 600;
+
+	using counter_id = std::size_t;
+	using histogram_id = std::size_t;
+
+	/*
+	 * Always present: requests, statuses, bytes sent and the latency of
+	 * all requests, which every request is recorded in besides its route.
+	 */
+	static constexpr counter_id requests_counter = 0;
+	static constexpr counter_id bytes_sent_counter = 1;
+	static constexpr histogram_id default_route = 0;
+
+	metrics_registry() :
+		_id{next_id()} {
+		counter("webdonkey_requests_total", "Requests served.");
+		counter("webdonkey_response_bytes_total", "Response bytes sent.");
+		histogram("webdonkey_request_duration_seconds",
+				  "Time from request header to response.", "route=\"all\"");
+	}
+
+	metrics_registry(const metrics_registry &) = delete;
+	metrics_registry(metrics_registry &&) = delete;
+	metrics_registry &operator=(const metrics_registry &) = delete;
+	metrics_registry &operator=(metrics_registry &&) = delete;
+
+	/**
+	 * Registers a counter or finds an existing one.
+	 * @param labels Prometheus label list without braces, e.g. a="b",c="d"
+	 */
+	counter_id counter(std::string_view name, std::string_view help,
+					   std::string_view labels = {}) {
+		return register_metric(_counters, max_counters, name, help, labels);
+	}
+
+	histogram_id histogram(std::string_view name, std::string_view help,
+						   std::string_view labels = {}) {
+		return register_metric(_histograms, max_histograms, name, help, labels);
+	}
+
+	/**
+	 * Registers a value read on scrape, e.g. a connection count. The
+	 * callback must stay valid for as long as the registry is scraped.
+	 */
+	void gauge(std::string_view name, std::string_view help,
+			   std::function<double()> read, std::string_view labels = {}) {
+		std::lock_guard<std::mutex> lock{_mutex};
+		_gauges.push_back(
+			{{std::string{name}, std::string{help}, std::string{labels}},
+			 std::move(read)});
+	}
+
+	void add(counter_id id, std::uint64_t value = 1) {
+		std::atomic<std::uint64_t> &counter = local_shard().counters[id];
+		counter.store(counter.load(std::memory_order_relaxed) + value,
+					  std::memory_order_relaxed);
+	}
+
+	void record(histogram_id id, std::chrono::nanoseconds latency) {
+		std::atomic<latency_histogram *> &slot = local_shard().histograms[id];
+		latency_histogram *histogram = slot.load(std::memory_order_relaxed);
+		if (histogram == nullptr) {
+			histogram = new latency_histogram{};
+			slot.store(histogram, std::memory_order_release);
+		}
+
+		histogram->record(latency);
+	}
+
+	/**
+	 * Records a finished request.
+	 */
+	void request_done(histogram_id route, unsigned status, std::uint64_t bytes,
+					  std::chrono::nanoseconds latency) {
+		shard &local = local_shard();
+		auto increment = [](std::atomic<std::uint64_t> &counter,
+							std::uint64_t value) {
+			counter.store(counter.load(std::memory_order_relaxed) + value,
+						  std::memory_order_relaxed);
+		};
+
+		increment(local.counters[requests_counter], 1);
+		increment(local.counters[bytes_sent_counter], bytes);
+		if ((status > 0) && (status < max_status))
+			increment(local.statuses[status], 1);
+
+		record(route, latency);
+		if (route != default_route)
+			record(default_route, latency);
+	}
+
+	/**
+	 * Merges all shards into the Prometheus text exposition format.
+	 */
+	std::string scrape() const;
+
+private:
+	struct descriptor {
+		std::string name;
+		std::string help;
+		std::string labels;
+	};
+
+	struct gauge_entry {
+		descriptor info;
+		std::function<double()> read;
+	};
+
+	struct shard {
+		std::array<std::atomic<std::uint64_t>, max_counters> counters{};
+		std::array<std::atomic<std::uint64_t>, max_status> statuses{};
+		std::array<std::atomic<latency_histogram *>, max_histograms>
+			histograms{};
+
+		shard() = default;
+		shard(const shard &) = delete;
+		shard &operator=(const shard &) = delete;
+
+		~shard() {
+			for (std::atomic<latency_histogram *> &histogram : histograms)
+				delete histogram.load();
+		}
+	};
+
+	static std::uint64_t next_id() {
+		static std::atomic<std::uint64_t> counter = 0;
+		return ++counter;
+	}
+
+	std::size_t register_metric(std::vector<descriptor> &list,
+								std::size_t limit, std::string_view name,
+								std::string_view help,
+								std::string_view labels) {
+		std::lock_guard<std::mutex> lock{_mutex};
+		for (std::size_t i = 0; i < list.size(); ++i)
+			if ((list[i].name == name) && (list[i].labels == labels))
+				return i;
+
+		if (list.size() == limit)
+			throw std::length_error{"Too many metrics: " + std::string{name}};
+
+		list.push_back({std::string{name}, std::string{help},
+						std::string{labels}});
+		return list.size() - 1;
+	}
+
+	shard &local_shard();
+
+	const std::uint64_t _id;
+	std::vector<descriptor> _counters;
+	std::vector<descriptor> _histograms;
+	std::vector<gauge_entry> _gauges;
+	std::vector<std::shared_ptr<shard>> _shards;
+	mutable std::mutex _mutex;
+};
+
+using metrics_ptr = std::shared_ptr<metrics_registry>;
+
+/**
+ * Exports the connection counts of a listener. The admission control must
+ * outlive scrapes of the registry.
+ * @param labels identifies the listener, e.g. listener="http"
+ */
+inline void watch_admission(metrics_registry &metrics,
+							const admission_control &admission,
+							std::string_view labels = {}) {
+	const admission_control *watched = &admission;
+	metrics.gauge(
+		"webdonkey_connections_active", "Connections currently served.",
+		[watched]() { return static_cast<double>(watched->active()); },
+		labels);
+	metrics.gauge(
+		"webdonkey_connections_admitted", "Connections admitted since start.",
+		[watched]() { return static_cast<double>(watched->admitted()); },
+		labels);
+	metrics.gauge(
+		"webdonkey_connections_shed", "Connections shed with a 503.",
+		[watched]() { return static_cast<double>(watched->shed()); }, labels);
+	metrics.gauge(
+		"webdonkey_connections_rejected",
+		"Connections closed at the connection limit.",
+		[watched]() { return static_cast<double>(watched->rejected()); },
+		labels);
+}
+
+//==============================================================================
+
+inline metrics_registry::shard &metrics_registry::local_shard() {
+	// Keyed by registry id, as in access_log
+	thread_local std::vector<std::pair<std::uint64_t, std::shared_ptr<shard>>>
+		local_shards;
+
+	for (auto &entry : local_shards)
+		if (entry.first == _id)
+			return *entry.second;
+
+	std::shared_ptr<shard> created = std::make_shared<shard>();
+	{
+		std::lock_guard<std::mutex> lock{_mutex};
+		_shards.push_back(created);
+	}
+
+	local_shards.emplace_back(_id, created);
+	return *created;
+}
+
+inline std::string metrics_registry::scrape() const {
+	std::lock_guard<std::mutex> lock{_mutex};
+	std::string out;
+	char number[64];
+
+	auto family = [&out](const descriptor &info, std::string_view type) {
+		out += "# HELP " + info.name + " " + info.help + "\n";
+		out += "# TYPE " + info.name + " ";
+		out += type;
+		out += "\n";
+	};
+
+	/*
+	 * Samples of one name must follow a single header, whatever order
+	 * their label sets were registered in.
+	 */
+	auto grouped = [](const auto &list, auto info, auto emit) {
+		std::vector<bool> done(list.size(), false);
+		for (std::size_t i = 0; i < list.size(); ++i) {
+			if (done[i])
+				continue;
+
+			emit(i, true);
+			for (std::size_t j = i + 1; j < list.size(); ++j)
+				if (!done[j] && (info(list[j]).name == info(list[i]).name)) {
+					done[j] = true;
+					emit(j, false);
+				}
+		}
+	};
+
+	auto own_info = [](const descriptor &info) -> const descriptor & {
+		return info;
+	};
+
+	auto sample = [&out](std::string_view name, std::string_view labels,
+						 std::string_view extra_label,
+						 std::string_view value) {
+		out += name;
+		if (!labels.empty() || !extra_label.empty()) {
+			out += "{";
+			out += labels;
+			if (!labels.empty() && !extra_label.empty())
+				out += ",";
+			out += extra_label;
+			out += "}";
+		}
+		out += " ";
+		out += value;
+		out += "\n";
+	};
+
+	grouped(_counters, own_info, [&](std::size_t i, bool first) {
+		std::uint64_t total = 0;
+		for (const std::shared_ptr<shard> &s : _shards)
+			total += s->counters[i].load(std::memory_order_relaxed);
+
+		if (first)
+			family(_counters[i], "counter");
+
+		std::snprintf(number, sizeof(number), "%llu",
+					  static_cast<unsigned long long>(total));
+		sample(_counters[i].name, _counters[i].labels, {}, number);
+	});
+
+	bool statuses_started = false;
+	for (std::size_t status = 0; status < max_status; ++status) {
+		std::uint64_t total = 0;
+		for (const std::shared_ptr<shard> &s : _shards)
+			total += s->statuses[status].load(std::memory_order_relaxed);
+
+		if (total == 0)
+			continue;
+
+		if (!statuses_started) {
+			out += "# HELP webdonkey_responses_total Responses by status.\n"
+				   "# TYPE webdonkey_responses_total counter\n";
+			statuses_started = true;
+		}
+
+		char code[32];
+		std::snprintf(code, sizeof(code), "code=\"%zu\"", status);
+		std::snprintf(number, sizeof(number), "%llu",
+					  static_cast<unsigned long long>(total));
+		sample("webdonkey_responses_total", {}, code, number);
+	}
+
+	static constexpr std::pair<double, std::string_view> quantiles[] = {
+		{0.5, "quantile=\"0.5\""},
+		{0.9, "quantile=\"0.9\""},
+		{0.99, "quantile=\"0.99\""},
+		{0.999, "quantile=\"0.999\""}};
+
+	std::vector<std::uint64_t> buckets;
+	grouped(_histograms, own_info, [&](std::size_t i, bool first) {
+		buckets.assign(latency_histogram::bucket_count, 0);
+		std::uint64_t sum_ns = 0;
+		for (const std::shared_ptr<shard> &s : _shards)
+			if (latency_histogram *h =
+					s->histograms[i].load(std::memory_order_acquire))
+				h->merge_into(buckets, sum_ns);
+
+		std::uint64_t count = 0;
+		for (std::uint64_t bucket : buckets)
+			count += bucket;
+
+		const descriptor &info = _histograms[i];
+		if (first)
+			family(info, "summary");
+
+		for (const auto &[q, label] : quantiles) {
+			std::snprintf(
+				number, sizeof(number), "%.6f",
+				static_cast<double>(latency_histogram::quantile(buckets, q)) /
+					1e6);
+			sample(info.name, info.labels, label, number);
+		}
+
+		std::snprintf(number, sizeof(number), "%.6f",
+					  static_cast<double>(sum_ns) / 1e9);
+		sample(info.name + "_sum", info.labels, {}, number);
+		std::snprintf(number, sizeof(number), "%llu",
+					  static_cast<unsigned long long>(count));
+		sample(info.name + "_count", info.labels, {}, number);
+	});
+
+	auto gauge_info = [](const gauge_entry &gauge) -> const descriptor & {
+		return gauge.info;
+	};
+
+	grouped(_gauges, gauge_info, [&](std::size_t i, bool first) {
+		const gauge_entry &gauge = _gauges[i];
+		if (first)
+			family(gauge.info, "gauge");
+
+		std::snprintf(number, sizeof(number), "%.17g", gauge.read());
+		sample(gauge.info.name, gauge.info.labels, {}, number);
+	});
+
+	return out;
+}
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_METRICS_HPP_ */
@@ -0,0 +1,89 @@
+/*
+ * metrics_responder.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_METRICS_RESPONDER_HPP_
+#define LIB_WEBDONKEY_METRICS_RESPONDER_HPP_
+
+#include <boost/beast/http/string_body.hpp>
+#include <expected>
+#include <string>
+#include <webdonkey/http.hpp>
+#include <webdonkey/metrics.hpp>
+
+namespace webdonkey {
+
+/**
+ * Serves a scrape of the registry to GET and HEAD requests for the route
+ * itself, e.g. routes.add("/metrics", metrics_responder{metrics}).
+ */
+class metrics_responder {
+public:
+	static constexpr std::string_view content_type =
+		"text/plain; version=0.0.4; charset=utf-8";
+
+	explicit metrics_responder(metrics_ptr metrics) :
+		_metrics{std::move(metrics)} {}
+
+	template <class socket_stream>
+	expected_response operator()(request_context<socket_stream> &ctx,
+								 std::string_view target) const {
+		if (!target.empty() && (target != "/") && !target.starts_with('?'))
+			return std::unexpected{
+				protocol_error{beast::http::status::not_found, ""}};
+
+		const request &req = ctx.request();
+		if (req.method() != beast::http::verb::get &&
+			req.method() != beast::http::verb::head)
+			return std::unexpected{protocol_error{
+				beast::http::status::method_not_allowed,
+				ctx.method_string() + " " + std::string{ctx.target()}}};
+
+		beast::http::response<beast::http::string_body> res{
+			beast::http::status::ok, req.version()};
+		res.set(beast::http::field::content_type, content_type);
+		res.set(beast::http::field::cache_control, "no-store");
+		res.keep_alive(req.keep_alive());
+		res.body() = _metrics->scrape();
+		res.prepare_payload();
+		if (req.method() == beast::http::verb::head)
+			res.body().clear();
+
+		return res;
+	}
+
+private:
+	metrics_ptr _metrics;
+};
+
+/**
+ * Records the latency of requests answered by the upstream responder under
+ * route="route_name" as well as under route="all".
+ */
+template <stream_responder upstream_responder>
+auto metered(const metrics_ptr &metrics, std::string_view route_name,
+			 upstream_responder upstream) {
+	const metrics_registry::histogram_id route = metrics->histogram(
+		"webdonkey_request_duration_seconds",
+		"Time from request header to response.",
+		"route=\"" + std::string{route_name} + "\"");
+
+	return [route, upstream](auto &ctx,
+							 std::string_view target) -> expected_response {
+		const metrics_registry::histogram_id previous = ctx.metrics_route();
+		ctx.metrics_route(route);
+
+		expected_response response = upstream(ctx, target);
+		if (!response.has_value() && response.error().recoverable)
+			ctx.metrics_route(previous);
+
+		return response;
+	};
+}
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_METRICS_RESPONDER_HPP_ */
@@ -0,0 +1,151 @@
+/*
+ * recycling.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_RECYCLING_HPP_
+#define LIB_WEBDONKEY_RECYCLING_HPP_
+
+#include <webdonkey/defs.hpp>
+
+#include <array>
+#include <boost/asio/bind_allocator.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <cstddef>
+#include <new>
+
+namespace webdonkey {
+
+/**
+ * Per-thread free lists of small blocks. Memory released on a thread goes
+ * to the lists of that thread, whichever thread allocated it, so blocks of
+ * a connection served by a strand on a thread pool migrate freely.
+ */
+class recycling_pool {
+public:
+	// Blocks are rounded up to a multiple of this size
+	static constexpr std::size_t granularity = 64;
+
+	// Larger blocks go straight to the heap
+	static constexpr std::size_t max_block = 2048;
+
+	// Blocks kept per size class; the rest is given back to the heap
+	static constexpr std::size_t max_free = 64;
+
+	recycling_pool() = default;
+
+	recycling_pool(const recycling_pool &) = delete;
+	recycling_pool &operator=(const recycling_pool &) = delete;
+
+	~recycling_pool() {
+		for (free_list &list : _lists)
+			while (list.head != nullptr) {
+				block *next = list.head->next;
+				::operator delete(list.head);
+				list.head = next;
+			}
+	}
+
+	static recycling_pool &local() {
+		thread_local recycling_pool pool;
+		return pool;
+	}
+
+	void *allocate(std::size_t size) {
+		if ((size == 0) || (size > max_block))
+			return ::operator new(size == 0 ? 1 : size);
+
+		free_list &list = _lists[size_class(size)];
+		if (list.head == nullptr)
+			return ::operator new(block_size(size));
+
+		block *reused = list.head;
+		list.head = reused->next;
+		--list.size;
+		return reused;
+	}
+
+	void deallocate(void *pointer, std::size_t size) noexcept {
+		if ((size == 0) || (size > max_block)) {
+			::operator delete(pointer);
+			return;
+		}
+
+		free_list &list = _lists[size_class(size)];
+		if (list.size == max_free) {
+			::operator delete(pointer);
+			return;
+		}
+
+		list.head = ::new (pointer) block{list.head};
+		++list.size;
+	}
+
+private:
+	struct block {
+		block *next;
+	};
+
+	struct free_list {
+		block *head = nullptr;
+		std::size_t size = 0;
+	};
+
+	static constexpr std::size_t size_class(std::size_t size) {
+		return (size - 1) / granularity;
+	}
+
+	static constexpr std::size_t block_size(std::size_t size) {
+		return (size_class(size) + 1) * granularity;
+	}
+
+	std::array<free_list, max_block / granularity> _lists;
+};
+
+/**
+ * Allocator of the calling thread's recycling_pool. Stateless, so any two
+ * instances are interchangeable.
+ */
+template <typename element_type> class recycling_allocator {
+public:
+	using value_type = element_type;
+
+	template <typename other_type> struct rebind {
+		using other = recycling_allocator<other_type>;
+	};
+
+	recycling_allocator() noexcept = default;
+
+	template <typename other_type>
+	recycling_allocator(const recycling_allocator<other_type> &) noexcept {}
+
+	element_type *allocate(std::size_t n) {
+		return static_cast<element_type *>(
+			recycling_pool::local().allocate(n * sizeof(element_type)));
+	}
+
+	void deallocate(element_type *pointer, std::size_t n) noexcept {
+		recycling_pool::local().deallocate(pointer, n * sizeof(element_type));
+	}
+
+	template <typename other_type>
+	bool operator==(const recycling_allocator<other_type> &) const noexcept {
+		return true;
+	}
+};
+
+/**
+ * Drop-in replacement of asio::use_awaitable for operations on hot paths:
+ * their intermediate operations, e.g. reactor operations and composed
+ * operation states, are allocated from the recycling pool. Everything
+ * else associated with the handler, such as its cancellation slot, is
+ * passed through.
+ */
+inline const auto recycled_awaitable =
+	asio::bind_allocator(recycling_allocator<void>{}, asio::use_awaitable);
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_RECYCLING_HPP_ */
@@ -0,0 +1,268 @@
+/*
+ * router.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_ROUTER_HPP_
+#define LIB_WEBDONKEY_ROUTER_HPP_
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <webdonkey/http.hpp>
+
+namespace webdonkey {
+
+class route_conflict : public std::runtime_error {
+public:
+	explicit route_conflict(const std::string &pattern) :
+		std::runtime_error{"Conflicting route: " + pattern} {}
+
+	route_conflict(const route_conflict &) = default;
+	route_conflict(route_conflict &&) = default;
+	route_conflict &operator=(const route_conflict &) = default;
+	route_conflict &operator=(route_conflict &&) = default;
+
+	virtual ~route_conflict() = default;
+};
+
+class route_parse_error : public std::runtime_error {
+public:
+	explicit route_parse_error(const std::string &pattern) :
+		std::runtime_error{"Malformed route: " + pattern} {}
+
+	route_parse_error(const route_parse_error &) = default;
+	route_parse_error(route_parse_error &&) = default;
+	route_parse_error &operator=(const route_parse_error &) = default;
+	route_parse_error &operator=(route_parse_error &&) = default;
+
+	virtual ~route_parse_error() = default;
+};
+
+/**
+ * Dispatches requests over a radix tree of path patterns. Patterns are
+ * matched literally except for "{name}" segments, which capture a
+ * non-empty value up to the next '/' into request_context::params(), and a
+ * trailing '*', which makes a pattern match every path it is a prefix of.
+ *
+ * Responders receive the unmatched rest of the target: the tail of the path
+ * for prefix patterns, the query (if any) for exact ones. Literal edges are
+ * preferred to captures and longer matches to shorter ones. If a responder
+ * fails with a recoverable error, the next candidate is tried, as with
+ * operator|.
+ *
+ * Matching takes time proportional to the path length (plus backtracking
+ * over alternative candidates) and does not allocate. Routes must be added
+ * before the router is used to serve requests; copies share the tree.
+ * add() throws route_parse_error for a capture that is unterminated, empty
+ * or spans a '/', and route_conflict for a pattern that is already routed
+ * or names a capture differently than an earlier pattern does.
+ */
+template <class socket_stream> class router {
+public:
+	using handler_type = std::function<expected_response(
+		request_context<socket_stream> &, std::string_view)>;
+
+	router() :
+		_root{std::make_shared<node>()} {}
+
+	router(const router<socket_stream> &) = default;
+	router(router<socket_stream> &&) = default;
+	router<socket_stream> &operator=(const router<socket_stream> &) = default;
+	router<socket_stream> &operator=(router<socket_stream> &&) = default;
+
+	template <responder<socket_stream> upstream_responder>
+	router<socket_stream> &add(std::string_view pattern,
+							   upstream_responder upstream);
+
+	expected_response operator()(request_context<socket_stream> &ctx,
+								 std::string_view target) const {
+		std::size_t path_end = target.find('?');
+		std::string_view path = target.substr(0, path_end);
+
+		std::optional<protocol_error> failure;
+		std::optional<expected_response> response =
+			match(*_root, ctx, target, path, 0, failure);
+		if (response.has_value())
+			return std::move(response.value());
+
+		if (failure.has_value())
+			return std::unexpected{std::move(failure.value())};
+
+		return std::unexpected{
+			protocol_error{beast::http::status::not_found, ""}};
+	}
+
+private:
+	struct node {
+		// Literal text leading to this node, or the capture name
+		std::string label;
+		std::vector<std::unique_ptr<node>> children;
+		std::unique_ptr<node> capture;
+		std::optional<handler_type> exact;
+		std::optional<handler_type> prefix;
+	};
+
+	static node *add_literal(node *parent, std::string_view text);
+
+	static std::optional<expected_response>
+	invoke(const handler_type &handler, request_context<socket_stream> &ctx,
+		   std::string_view rest, std::optional<protocol_error> &failure) {
+		expected_response response = handler(ctx, rest);
+		if (response.has_value() || !response.error().recoverable)
+			return response;
+
+		failure = std::move(response.error());
+		return std::nullopt;
+	}
+
+	static std::optional<expected_response>
+	match(const node &current, request_context<socket_stream> &ctx,
+		  std::string_view target, std::string_view path, std::size_t pos,
+		  std::optional<protocol_error> &failure);
+
+	std::shared_ptr<node> _root;
+};
+
+template <class socket_stream>
+template <responder<socket_stream> upstream_responder>
+router<socket_stream> &router<socket_stream>::add(std::string_view pattern,
+												  upstream_responder upstream) {
+	const std::string full_pattern{pattern};
+	const bool is_prefix = pattern.ends_with('*');
+	if (is_prefix)
+		pattern.remove_suffix(1);
+
+	node *current = _root.get();
+	while (!pattern.empty()) {
+		std::size_t open = pattern.find('{');
+		current = add_literal(current, pattern.substr(0, open));
+		if (open == std::string_view::npos)
+			break;
+
+		std::size_t close = pattern.find('}', open);
+		if (close == std::string_view::npos)
+			throw route_parse_error{full_pattern};
+
+		std::string_view name = pattern.substr(open + 1, close - open - 1);
+		if (name.empty() || (name.find_first_of("{/") != name.npos))
+			throw route_parse_error{full_pattern};
+
+		if (!current->capture) {
+			current->capture = std::make_unique<node>();
+			current->capture->label = name;
+		} else if (current->capture->label != name)
+			throw route_conflict{full_pattern};
+
+		current = current->capture.get();
+		pattern.remove_prefix(close + 1);
+	}
+
+	std::optional<handler_type> &slot =
+		is_prefix ? current->prefix : current->exact;
+	if (slot.has_value())
+		throw route_conflict{full_pattern};
+
+	slot = handler_type{upstream};
+	return *this;
+}
+
+template <class socket_stream>
+typename router<socket_stream>::node *
+router<socket_stream>::add_literal(node *parent, std::string_view text) {
+	while (!text.empty()) {
+		node *next = nullptr;
+		for (std::unique_ptr<node> &child : parent->children) {
+			if (child->label.front() != text.front())
+				continue;
+
+			std::size_t common = 0;
+			while ((common < child->label.size()) && (common < text.size()) &&
+				   (child->label[common] == text[common]))
+				++common;
+
+			// Split the edge at the end of the common part
+			if (common < child->label.size()) {
+				std::unique_ptr<node> split = std::make_unique<node>();
+				split->label = child->label.substr(0, common);
+				child->label.erase(0, common);
+				split->children.push_back(std::move(child));
+				child = std::move(split);
+			}
+
+			next = child.get();
+			text.remove_prefix(common);
+			break;
+		}
+
+		if (next == nullptr) {
+			parent->children.push_back(std::make_unique<node>());
+			next = parent->children.back().get();
+			next->label = text;
+			text = std::string_view{};
+		}
+
+		parent = next;
+	}
+
+	return parent;
+}
+
+template <class socket_stream>
+std::optional<expected_response> router<socket_stream>::match(
+	const node &current, request_context<socket_stream> &ctx,
+	std::string_view target, std::string_view path, std::size_t pos,
+	std::optional<protocol_error> &failure) {
+	if ((pos == path.size()) && current.exact.has_value()) {
+		std::optional<expected_response> response = invoke(
+			current.exact.value(), ctx, target.substr(path.size()), failure);
+		if (response.has_value())
+			return response;
+	}
+
+	if (pos < path.size()) {
+		std::string_view rest = path.substr(pos);
+		for (const std::unique_ptr<node> &child : current.children) {
+			if (!rest.starts_with(child->label))
+				continue;
+
+			std::optional<expected_response> response =
+				match(*child, ctx, target, path, pos + child->label.size(),
+					  failure);
+			if (response.has_value())
+				return response;
+
+			// Children start with distinct characters
+			break;
+		}
+
+		if (current.capture) {
+			std::string_view value = rest.substr(0, rest.find('/'));
+			if (!value.empty() &&
+				ctx.params().push(current.capture->label, value)) {
+				std::optional<expected_response> response =
+					match(*current.capture, ctx, target, path,
+						  pos + value.size(), failure);
+				if (response.has_value())
+					return response;
+
+				ctx.params().pop();
+			}
+		}
+	}
+
+	if (current.prefix.has_value())
+		return invoke(current.prefix.value(), ctx, target.substr(pos), failure);
+
+	return std::nullopt;
+}
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_ROUTER_HPP_ */
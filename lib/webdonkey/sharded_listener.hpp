@@ -0,0 +1,228 @@
+/*
+ * sharded_listener.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_SHARDED_LISTENER_HPP_
+#define LIB_WEBDONKEY_SHARDED_LISTENER_HPP_
+
+#include <webdonkey/defs.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <webdonkey/admission.hpp>
+#include <webdonkey/recycling.hpp>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace webdonkey {
+
+#if defined(SO_REUSEPORT)
+/**
+ * SO_REUSEPORT as a settable socket option, which Asio does not provide.
+ */
+class reuse_port {
+public:
+	explicit reuse_port(bool enabled) : _value{enabled ? 1 : 0} {}
+
+	template <class protocol_type> int level(const protocol_type &) const {
+		return SOL_SOCKET;
+	}
+
+	template <class protocol_type> int name(const protocol_type &) const {
+		return SO_REUSEPORT;
+	}
+
+	template <class protocol_type>
+	const int *data(const protocol_type &) const {
+		return &_value;
+	}
+
+	template <class protocol_type>
+	std::size_t size(const protocol_type &) const {
+		return sizeof(_value);
+	}
+
+private:
+	int _value;
+};
+#endif
+
+/**
+ * Listener running one acceptor per shard, all bound to the same endpoint
+ * with SO_REUSEPORT so that the kernel spreads incoming connections
+ * between them. Every shard owns a single-threaded io_context, optionally
+ * pinned to a core, which runs both its accept loop and all of its
+ * connections. A connection therefore never leaves the thread which
+ * accepted it and needs no strand.
+ */
+class sharded_listener {
+public:
+	void stop() {
+		_stopped = true;
+		for (std::unique_ptr<shard> &s : _shards)
+			s->io.stop();
+	}
+
+	bool stopped() const { return _stopped; }
+
+	/**
+	 * Blocks until all shard threads exit.
+	 */
+	void join() {
+		for (std::unique_ptr<shard> &s : _shards)
+			if (s->thread.joinable())
+				s->thread.join();
+	}
+
+	std::size_t shard_count() const { return _shards.size(); }
+
+	// Endpoint all shards are bound to
+	tcp::endpoint local_endpoint() const {
+		return _shards.front()->acceptor.local_endpoint();
+	}
+
+	// Connection counts and limits, common to all shards
+	const admission_control &admission() const { return *_admission; }
+
+	/**
+	 * Executor of a shard, e.g. for running per-shard background work.
+	 */
+	asio::io_context::executor_type executor(std::size_t index) {
+		return _shards[index]->io.get_executor();
+	}
+
+	/**
+	 * @param endpoint if its port is zero, the port chosen for the first
+	 * shard is taken by all of them.
+	 * @param shard_count number of acceptors and threads; zero means one
+	 * per hardware thread.
+	 * @param pin_threads pin shard i to CPU i modulo the number of CPUs.
+	 */
+	template <typename handler_type>
+	sharded_listener(const tcp::endpoint &endpoint, handler_type socket_handler,
+					 std::size_t shard_count = 0, bool pin_threads = true,
+					 const admission_options &limits = {}) :
+		_admission{std::make_shared<admission_control>(limits)} {
+		if (shard_count == 0)
+			shard_count = std::max(1u, std::thread::hardware_concurrency());
+
+		tcp::endpoint bound = endpoint;
+		for (std::size_t i = 0; i < shard_count; ++i) {
+			std::unique_ptr<shard> s = std::make_unique<shard>();
+			s->acceptor.open(endpoint.protocol());
+			s->acceptor.set_option(asio::socket_base::reuse_address(true));
+#if defined(SO_REUSEPORT)
+			s->acceptor.set_option(reuse_port(true));
+#else
+			if (shard_count > 1)
+				throw std::runtime_error{"SO_REUSEPORT is not supported."};
+#endif
+			s->acceptor.bind(bound);
+			s->acceptor.listen(asio::socket_base::max_listen_connections);
+			bound = s->acceptor.local_endpoint();
+
+			asio::co_spawn(s->io,
+						   accept_connections(*s, _stopped, _admission,
+											  socket_handler),
+						   asio::detached);
+			_shards.push_back(std::move(s));
+		}
+
+		const unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+		for (std::size_t i = 0; i < _shards.size(); ++i) {
+			shard &s = *_shards[i];
+			s.thread = std::thread{[&s]() { s.io.run(); }};
+#if defined(__linux__)
+			if (pin_threads) {
+				cpu_set_t cpu_set;
+				CPU_ZERO(&cpu_set);
+				CPU_SET(i % cpus, &cpu_set);
+				pthread_setaffinity_np(s.thread.native_handle(),
+									   sizeof(cpu_set), &cpu_set);
+			}
+#endif
+		}
+	}
+
+	sharded_listener(const sharded_listener &) = delete;
+	sharded_listener(sharded_listener &&) = delete;
+	sharded_listener &operator=(const sharded_listener &) = delete;
+	sharded_listener &operator=(sharded_listener &&) = delete;
+
+	~sharded_listener() {
+		stop();
+		join();
+	}
+
+private:
+	struct shard {
+		// Concurrency hint 1: the context is only ever run by one thread
+		asio::io_context io{1};
+		tcp::acceptor acceptor{io};
+		std::thread thread;
+	};
+
+	template <typename handler_type>
+	static awaitable<void> accept_connections(shard &s,
+											  std::atomic<bool> &stopped,
+											  admission_ptr admission,
+											  handler_type handler) {
+		while (!stopped) {
+			co_await admission->throttle();
+			tcp::socket socket =
+				co_await s.acceptor.async_accept(recycled_awaitable);
+
+			switch (admission->admit()) {
+			case admission_control::verdict::admit:
+				asio::co_spawn(s.io,
+							   handle_connection(std::move(socket), handler,
+												 connection_ticket{admission}),
+							   asio::detached);
+				break;
+			case admission_control::verdict::shed:
+				asio::co_spawn(s.io,
+							   shed_connection(std::move(socket), admission),
+							   asio::detached);
+				break;
+			case admission_control::verdict::reject: {
+				beast::error_code ec;
+				socket.close(ec);
+			} break;
+			}
+		}
+	}
+
+	/*
+	 * Keeps the accepted socket alive and counted in the connection's own
+	 * coroutine frame for as long as the handler runs.
+	 */
+	template <typename handler_type>
+	static awaitable<void>
+	handle_connection(tcp::socket socket, handler_type handler,
+					  [[maybe_unused]] connection_ticket ticket) {
+		// ticket is only held, releasing its slot when the frame is destroyed
+		co_await handler(socket);
+	}
+
+	admission_ptr _admission;
+	std::vector<std::unique_ptr<shard>> _shards;
+	std::atomic<bool> _stopped = false;
+};
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_SHARDED_LISTENER_HPP_ */
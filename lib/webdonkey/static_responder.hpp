@@ -12,36 +12,166 @@
 #include <boost/beast/http/status.hpp>
 #include <expected>
 #include <filesystem>
+#include <random>
 #include <string>
+#include <sys/stat.h>
+#include <webdonkey/compression.hpp>
+#include <webdonkey/conditional.hpp>
 #include <webdonkey/contextual.hpp>
+#include <webdonkey/file_cache.hpp>
 #include <webdonkey/http.hpp>
+#include <webdonkey/metrics.hpp>
 #include <webdonkey/utils.hpp>
 
 namespace webdonkey {
 
+struct static_responder_options {
+	// Content cache, may be shared with other responders
+	std::shared_ptr<file_cache> cache;
+
+	// Serve .br, .zst and .gz siblings of files to clients accepting them
+	bool precompressed = false;
+
+	// Background compression of compressible files, may be shared
+	std::shared_ptr<compression_cache> compression;
+
+	// Counts responses by source if set
+	metrics_ptr metrics;
+};
+
 class static_responder {
 public:
+	// Requests for more ranges than this get the whole file
+	static constexpr std::size_t max_ranges = 16;
+
 	static_responder(const std::filesystem::path &root,
 					 const std::string &index, const std::string &version) :
 		_root{root}, _index{index}, _version{version} {}
 
+	static_responder(const std::filesystem::path &root,
+					 const std::string &index, const std::string &version,
+					 const static_responder_options &options) :
+		_root{root}, _index{index}, _version{version}, _options{options} {
+		if (!options.metrics)
+			return;
+
+		static constexpr std::string_view name =
+			"webdonkey_static_responses_total";
+		static constexpr std::string_view help =
+			"Static responses by source of the content.";
+		metrics_registry &metrics = *options.metrics;
+		_sources.cache = metrics.counter(name, help, "source=\"cache\"");
+		_sources.file = metrics.counter(name, help, "source=\"file\"");
+		_sources.sendfile = metrics.counter(name, help, "source=\"sendfile\"");
+		_sources.range = metrics.counter(name, help, "source=\"range\"");
+		_sources.not_modified =
+			metrics.counter(name, help, "source=\"not_modified\"");
+	}
+
 	static_responder(const static_responder &) = default;
 	static_responder(static_responder &&) = default;
 
 	template <class socket_stream>
 	expected_response operator()(request_context<socket_stream> &r_context,
-								 std::string_view target);
+								 std::string_view target) const;
 
 private:
+	struct source_counters {
+		metrics_registry::counter_id cache = 0;
+		metrics_registry::counter_id file = 0;
+		metrics_registry::counter_id sendfile = 0;
+		metrics_registry::counter_id range = 0;
+		metrics_registry::counter_id not_modified = 0;
+	};
+
+	void count(metrics_registry::counter_id source) const {
+		if (_options.metrics)
+			_options.metrics->add(source);
+	}
+
+	// True if responses depend on Accept-Encoding
+	bool negotiating() const {
+		return _options.precompressed || _options.compression;
+	}
+
+	template <class message_type>
+	void set_common_fields(message_type &res, const request &req,
+						   std::string_view encoding) const {
+		res.version(req.version());
+		res.set(beast::http::field::server, _version);
+		if (!encoding.empty())
+			res.set(beast::http::field::content_encoding, encoding);
+		if (negotiating())
+			res.set(beast::http::field::vary, "Accept-Encoding");
+		res.keep_alive(req.keep_alive());
+	}
+
+	template <class message_type>
+	void set_common_fields(message_type &res, const request &req,
+						   std::string_view encoding, std::string_view etag,
+						   std::string_view last_modified) const {
+		set_common_fields(res, req, encoding);
+		res.set(beast::http::field::etag, etag);
+		res.set(beast::http::field::last_modified, last_modified);
+	}
+
+	http_response not_modified_response(const request &req,
+										std::string_view encoding,
+										std::string_view etag,
+										std::string_view last_modified) const {
+		beast::http::response<beast::http::empty_body> res{
+			beast::http::status::not_modified, req.version()};
+		set_common_fields(res, req, encoding, etag, last_modified);
+		return res;
+	}
+
+	/**
+	 * Serves a file which may be an encoded variant of the requested one.
+	 */
+	template <class socket_stream>
+	expected_response serve_file(request_context<socket_stream> &r_context,
+								 std::string_view target,
+								 const std::filesystem::path &file_path,
+								 std::string_view content_type,
+								 std::string_view encoding) const;
+
+	http_response serve_cached(const request &req,
+							   const cached_file_ptr &cached,
+							   std::string_view content_type,
+							   std::string_view encoding) const;
+
+	template <class socket_stream>
+	expected_response range_response(
+		request_context<socket_stream> &r_context,
+		beast::http::response<beast::http::empty_body> &&res,
+		std::shared_ptr<beast::file> file,
+									 std::uint64_t size,
+									 const std::vector<byte_range> &ranges,
+									 std::string_view content_type) const;
+
+	static std::string multipart_boundary() {
+		thread_local std::mt19937_64 random{std::random_device{}()};
+		char boundary[40];
+		int length =
+			std::snprintf(boundary, sizeof(boundary), "webdonkey-%016llx",
+						  static_cast<unsigned long long>(random()));
+		return std::string{boundary, static_cast<std::size_t>(length)};
+	}
+
 	std::filesystem::path _root;
 	std::string _index;
 	std::string _version;
+	static_responder_options _options;
+	source_counters _sources;
+
+	// Tells headers canned by this responder and its copies from others
+	std::shared_ptr<const char> _canned_tag = std::make_shared<char>();
 };
 
 template <class socket_stream>
 expected_response
 static_responder::operator()(request_context<socket_stream> &r_context,
-							 std::string_view target) {
+							 std::string_view target) const {
 	// Request path must be absolute and not contain "..".
 	if (target.find("..") != std::string_view::npos)
 		return std::unexpected{
@@ -62,6 +192,92 @@ static_responder::operator()(request_context<socket_stream> &r_context,
 			beast::http::status::method_not_allowed,
 			r_context.method_string() + " " + std::string{r_context.target()}}};
 
+	const std::string_view content_type = mime_type(file_path);
+	if (negotiating()) {
+		std::string_view accept_encoding =
+			req[beast::http::field::accept_encoding];
+
+		if (_options.precompressed) {
+			for (const precompressed_variant &variant :
+				 precompressed_variants) {
+				if (!accepts_encoding(accept_encoding, variant.coding))
+					continue;
+
+				std::filesystem::path variant_path = file_path;
+				variant_path += variant.suffix;
+				if (_options.cache && _options.cache->missing(variant_path))
+					continue;
+
+				// Fall through to the next variant if this one is missing
+				expected_response response = serve_file(
+					r_context, target, variant_path, content_type,
+					variant.coding);
+				if (response.has_value() ||
+					(response.error().status != beast::http::status::not_found))
+					return response;
+			}
+		}
+
+		if (_options.compression &&
+			(req.find(beast::http::field::range) == req.end()) &&
+			compressible(content_type) &&
+			accepts_encoding(accept_encoding, compression_cache::coding)) {
+			cached_file_ptr original =
+				_options.cache ? _options.cache->lookup(file_path) : nullptr;
+
+			struct stat st;
+			if (original)
+				st = original->file_stat();
+
+			if ((original || (::stat(file_path.c_str(), &st) == 0)) &&
+				S_ISREG(st.st_mode)) {
+				cached_file_ptr compressed =
+					_options.compression->lookup(file_path, st, content_type);
+				if (compressed)
+					return serve_cached(req, compressed, content_type,
+										compression_cache::coding);
+			}
+		}
+	}
+
+	return serve_file(r_context, target, file_path, content_type, {});
+}
+
+template <class socket_stream>
+expected_response static_responder::serve_file(
+	request_context<socket_stream> &r_context, std::string_view target,
+	const std::filesystem::path &file_path, std::string_view content_type,
+	std::string_view encoding) const {
+	request &req = r_context.request();
+	const bool conditional =
+		(req.find(beast::http::field::if_none_match) != req.end()) ||
+		(req.find(beast::http::field::if_modified_since) != req.end());
+	const bool ranged = (req.method() == beast::http::verb::get) &&
+						(req.find(beast::http::field::range) != req.end());
+
+	// Range requests are served from the file
+	if (_options.cache && !ranged) {
+		cached_file_ptr cached = _options.cache->lookup(file_path);
+		if (cached)
+			return serve_cached(req, cached, content_type, encoding);
+
+		if (_options.cache->missing(file_path))
+			return std::unexpected{protocol_error{
+				beast::http::status::not_found, std::string{target}}};
+	}
+
+	// Answer revalidation without opening the file
+	struct stat st;
+	if (conditional && (::stat(file_path.c_str(), &st) == 0) &&
+		S_ISREG(st.st_mode)) {
+		std::string etag = entity_tag(st);
+		if (not_modified(req, etag, st.st_mtim.tv_sec)) {
+			count(_sources.not_modified);
+			return not_modified_response(req, encoding, etag,
+										 http_date(st.st_mtim.tv_sec));
+		}
+	}
+
 	// Attempt to open the file
 	beast::error_code ec;
 	beast::http::file_body::value_type body;
@@ -73,33 +289,161 @@ static_responder::operator()(request_context<socket_stream> &r_context,
 											  std::string{target}}};
 
 	// Handle an unknown error
-	if (ec)
+	if (ec || (::fstat(body.file().native_handle(), &st) != 0))
 		return std::unexpected{
 			protocol_error{beast::http::status::bad_request, "Unknown error"}};
 
 	// Cache the size since we need it after the move
 	const std::size_t size = body.size();
+	const std::string etag = entity_tag(st);
+	const std::string last_modified = http_date(st.st_mtim.tv_sec);
+
+	if (ranged && range_applies(req, etag, st.st_mtim.tv_sec)) {
+		std::optional<std::vector<byte_range>> ranges =
+			parse_ranges(req[beast::http::field::range], size);
+
+		if (ranges.has_value() && ranges->empty()) {
+			count(_sources.range);
+			beast::http::response<beast::http::empty_body> res{
+				beast::http::status::range_not_satisfiable, req.version()};
+			set_common_fields(res, req, encoding, etag, last_modified);
+			res.set(beast::http::field::content_range,
+					"bytes */" + std::to_string(size));
+			res.content_length(0);
+			return res;
+		}
+
+		if (ranges.has_value() && (ranges->size() <= max_ranges)) {
+			count(_sources.range);
+			beast::http::response<beast::http::empty_body> res{
+				beast::http::status::partial_content, req.version()};
+			set_common_fields(res, req, encoding, etag, last_modified);
+			return range_response(
+				r_context, std::move(res),
+				std::make_shared<beast::file>(std::move(body.file())), size,
+				ranges.value(), content_type);
+		}
+	}
 
 	// Respond to HEAD request
 	if (req.method() == beast::http::verb::head) {
+		count(_sources.file);
 		beast::http::response<beast::http::empty_body> res{
 			beast::http::status::ok, req.version()};
-		res.set(beast::http::field::server, _version);
-		res.set(beast::http::field::content_type, mime_type(file_path));
+		set_common_fields(res, req, encoding, etag, last_modified);
+		res.set(beast::http::field::content_type, content_type);
+		res.set(beast::http::field::accept_ranges, "bytes");
 		res.content_length(size);
-		res.keep_alive(req.keep_alive());
-		return std::make_shared<response_generator>(std::move(res));
+		return res;
+	} else if (r_context.zero_copy_files()) {
+		// Send the header now and let the body go straight from the file
+		count(_sources.sendfile);
+		beast::http::response<beast::http::empty_body> res{
+			beast::http::status::ok, req.version()};
+		set_common_fields(res, req, encoding, etag, last_modified);
+		res.set(beast::http::field::content_type, content_type);
+		res.set(beast::http::field::accept_ranges, "bytes");
+		res.content_length(size);
+		r_context.enqueue(std::move(res));
+		r_context.enqueue(file_segment{
+			std::make_shared<beast::file>(std::move(body.file())), 0, size});
+		return http_response{};
 	} else {
 		// Respond to GET request
+		count(_sources.file);
 		beast::http::response<beast::http::file_body> res{
 			std::piecewise_construct, std::make_tuple(std::move(body)),
 			std::make_tuple(beast::http::status::ok, req.version())};
-		res.set(beast::http::field::server, _version);
-		res.set(beast::http::field::content_type, mime_type(file_path));
+		set_common_fields(res, req, encoding, etag, last_modified);
+		res.set(beast::http::field::content_type, content_type);
+		res.set(beast::http::field::accept_ranges, "bytes");
 		res.content_length(size);
-		res.keep_alive(req.keep_alive());
-		return std::make_shared<response_generator>(std::move(res));
+		return res;
+	}
+}
+
+inline http_response
+static_responder::serve_cached(const request &req,
+							   const cached_file_ptr &cached,
+							   std::string_view content_type,
+							   std::string_view encoding) const {
+	const cached_file::header_type &header = cached->header();
+	if (((req.find(beast::http::field::if_none_match) != req.end()) ||
+		 (req.find(beast::http::field::if_modified_since) != req.end())) &&
+		not_modified(req, header[beast::http::field::etag],
+					 cached->file_stat().st_mtim.tv_sec)) {
+		count(_sources.not_modified);
+		return not_modified_response(
+			req, encoding, header[beast::http::field::etag],
+			header[beast::http::field::last_modified]);
 	}
+
+	count(_sources.cache);
+
+	// The header is built once per file and then sent with the content
+	std::optional<canned_response> canned = cached->canned(_canned_tag.get());
+	if (!canned.has_value()) {
+		beast::http::response<beast::http::empty_body> res{header};
+		set_common_fields(res, req, encoding);
+		res.set(beast::http::field::content_type, content_type);
+		canned.emplace(res);
+		cached->canned(_canned_tag.get(), canned.value());
+	}
+
+	canned_fields fields;
+	fields.content = asio::buffer(cached->data(), cached->size());
+	fields.content_owner = cached;
+	return canned.value()(req, std::move(fields));
+}
+
+template <class socket_stream>
+expected_response static_responder::range_response(
+	request_context<socket_stream> &r_context,
+	beast::http::response<beast::http::empty_body> &&res,
+	std::shared_ptr<beast::file> file, std::uint64_t size,
+	const std::vector<byte_range> &ranges,
+	std::string_view content_type) const {
+	const std::string total = "/" + std::to_string(size);
+	if (ranges.size() == 1) {
+		const byte_range &range = ranges.front();
+		res.set(beast::http::field::content_type, content_type);
+		res.set(beast::http::field::content_range,
+				"bytes " + std::to_string(range.first) + "-" +
+					std::to_string(range.last) + total);
+		res.content_length(range.size());
+		r_context.enqueue(std::move(res));
+		r_context.enqueue(file_segment{file, range.first, range.size()});
+		return http_response{};
+	}
+
+	// multipart/byteranges body, see RFC 9110, section 14.6
+	const std::string boundary = multipart_boundary();
+	std::vector<std::string> part_headers;
+	std::uint64_t content_length = 0;
+	for (const byte_range &range : ranges) {
+		std::string part = "\r\n--" + boundary +
+						   "\r\nContent-Type: " + content_type +
+						   "\r\nContent-Range: bytes " +
+						   std::to_string(range.first) + "-" +
+						   std::to_string(range.last) + total + "\r\n\r\n";
+		content_length += part.size() + range.size();
+		part_headers.push_back(std::move(part));
+	}
+
+	std::string closing = "\r\n--" + boundary + "--\r\n";
+	content_length += closing.size();
+
+	res.set(beast::http::field::content_type,
+			"multipart/byteranges; boundary=" + boundary);
+	res.content_length(content_length);
+	r_context.enqueue(std::move(res));
+	for (std::size_t i = 0; i < ranges.size(); ++i) {
+		r_context.enqueue(std::move(part_headers[i]));
+		r_context.enqueue(file_segment{file, ranges[i].first, ranges[i].size()});
+	}
+
+	r_context.enqueue(std::move(closing));
+	return http_response{};
 }
 
 } // namespace webdonkey
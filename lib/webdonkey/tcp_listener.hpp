@@ -16,7 +16,9 @@
 #include <boost/asio/use_awaitable.hpp>
 #include <boost/asio/use_future.hpp>
 #include <boost/signals2.hpp>
+#include <webdonkey/admission.hpp>
 #include <webdonkey/contextual.hpp>
+#include <webdonkey/recycling.hpp>
 
 namespace webdonkey {
 
@@ -25,10 +27,20 @@ public:
 	void stop() { _state->stopped = true; }
 	bool stopped() const { return _state->stopped; }
 
+	// Connection counts and limits
+	const admission_control &admission() const { return *_state->admission; }
+
+	// Bound address, e.g. to find the port picked for port 0
+	tcp::endpoint local_endpoint() const {
+		return _state->acceptor.local_endpoint();
+	}
+
 	using executor_ptr = managed_ptr<context, executor>;
 	template <typename handler_type>
-	tcp_listener(const tcp::endpoint &endpoint, handler_type socket_handler) {
+	tcp_listener(const tcp::endpoint &endpoint, handler_type socket_handler,
+				 const admission_options &limits = {}) {
 		state_ptr shared_state = std::make_shared<state>();
+		shared_state->admission = std::make_shared<admission_control>(limits);
 
 		shared_state->acceptor.open(endpoint.protocol());
 		shared_state->acceptor.set_option(
@@ -50,6 +62,7 @@ private:
 	struct state {
 		managed_ptr<context, executor> exec;
 		tcp::acceptor acceptor;
+		admission_ptr admission;
 		std::atomic<bool> stopped = false;
 
 		state() :
@@ -61,14 +74,58 @@ private:
 	template <typename handler_type>
 	static awaitable<void> accept_connections(state_ptr shared_state,
 											  handler_type handler) {
+		admission_ptr admission = shared_state->admission;
+
+		/*
+		 * Resolved once rather than for every accept and spawn. Executors
+		 * do not keep their execution context alive, so the pin is not
+		 * held across waits.
+		 */
+		auto exec = [&shared_state]() {
+			pinned_ptr<executor> pinned = shared_state->exec.pin();
+			if (!pinned)
+				throw lazy_resolution_failure{};
+
+			return pinned->get_executor();
+		}();
+
 		while (!shared_state->stopped) {
+			co_await admission->throttle();
 			tcp::socket socket = co_await shared_state->acceptor.async_accept(
-				asio::make_strand(*shared_state->exec), asio::use_awaitable);
-			asio::co_spawn(*shared_state->exec, handler(socket),
-						   asio::detached);
+				asio::make_strand(exec), recycled_awaitable);
+
+			switch (admission->admit()) {
+			case admission_control::verdict::admit:
+				asio::co_spawn(exec,
+							   handle_connection(std::move(socket), handler,
+												 connection_ticket{admission}),
+							   asio::detached);
+				break;
+			case admission_control::verdict::shed:
+				asio::co_spawn(exec,
+							   shed_connection(std::move(socket), admission),
+							   asio::detached);
+				break;
+			case admission_control::verdict::reject: {
+				beast::error_code ec;
+				socket.close(ec);
+			} break;
+			}
 		}
 	}
 
+	/*
+	 * Keeps the accepted socket alive and counted in the connection's own
+	 * coroutine frame for as long as the handler runs.
+	 */
+	template <typename handler_type>
+	static awaitable<void>
+	handle_connection(tcp::socket socket, handler_type handler,
+					  [[maybe_unused]] connection_ticket ticket) {
+		// ticket is only held, releasing its slot when the frame is destroyed
+		co_await handler(socket);
+	}
+
 	state_ptr _state;
 };
 
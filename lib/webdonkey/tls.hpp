@@ -0,0 +1,578 @@
+/*
+ * tls.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_TLS_HPP_
+#define LIB_WEBDONKEY_TLS_HPP_
+
+#include <webdonkey/defs.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#include <optional>
+#include <stdexcept>
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+/*
+ * Kernel TLS offload is only built with WEBDONKEY_KERNEL_TLS defined, as by
+ * the CMake option of that name, which is off by default.
+ */
+#if defined(__linux__) && defined(WEBDONKEY_KERNEL_TLS)
+#define WEBDONKEY_KERNEL_TLS_OFFLOAD 1
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+namespace webdonkey {
+
+struct tls_session_options {
+	// Sessions held in the server-side session cache
+	long cache_size = 20 * 1024;
+
+	// How long a cached session or a ticket may be resumed
+	std::chrono::seconds session_lifetime{2 * 60 * 60};
+
+	/*
+	 * Session tickets are sealed with a key replaced this often. Tickets
+	 * sealed with the previous key are still accepted, and renewed.
+	 */
+	bool tickets = true;
+	std::chrono::seconds ticket_key_lifetime{12 * 60 * 60};
+};
+
+/**
+ * Rotating session ticket keys of an SSL context: the current key and
+ * the one it replaced. Keys are random and never leave the process, so
+ * tickets are only honored by the process which issued them.
+ */
+class session_ticket_keys {
+public:
+	using clock = std::chrono::steady_clock;
+
+	static constexpr std::size_t name_size = 16;
+
+	struct key {
+		unsigned char name[name_size];
+		unsigned char cipher_key[32];
+		unsigned char mac_key[32];
+		clock::time_point created;
+	};
+
+	explicit session_ticket_keys(clock::duration lifetime) :
+		_lifetime{lifetime}, _current{generate()} {}
+
+	session_ticket_keys(const session_ticket_keys &) = delete;
+	session_ticket_keys(session_ticket_keys &&) = delete;
+	session_ticket_keys &operator=(const session_ticket_keys &) = delete;
+	session_ticket_keys &operator=(session_ticket_keys &&) = delete;
+
+	/**
+	 * The key for sealing new tickets, rotated when it gets too old.
+	 */
+	key current() {
+		std::lock_guard<std::mutex> lock{_mutex};
+		if (clock::now() - _current.created >= _lifetime) {
+			_previous = _current;
+			_current = generate();
+		}
+
+		return _current;
+	}
+
+	/**
+	 * Looks up the key a ticket was sealed with.
+	 * @return the key and whether it is still the current one.
+	 */
+	std::optional<std::pair<key, bool>> find(const unsigned char *name) {
+		std::lock_guard<std::mutex> lock{_mutex};
+		if (std::memcmp(name, _current.name, name_size) == 0)
+			return std::make_pair(_current, true);
+
+		if (_previous.has_value() &&
+			(std::memcmp(name, _previous->name, name_size) == 0))
+			return std::make_pair(_previous.value(), false);
+
+		return std::nullopt;
+	}
+
+private:
+	static key generate() {
+		key result;
+		if ((RAND_bytes(result.name, sizeof(result.name)) <= 0) ||
+			(RAND_bytes(result.cipher_key, sizeof(result.cipher_key)) <= 0) ||
+			(RAND_bytes(result.mac_key, sizeof(result.mac_key)) <= 0))
+			throw std::runtime_error{"Failed to generate a session ticket key."};
+
+		result.created = clock::now();
+		return result;
+	}
+
+	clock::duration _lifetime;
+	key _current;
+	std::optional<key> _previous;
+	std::mutex _mutex;
+};
+
+//==============================================================================
+
+namespace tls_internals {
+
+/*
+ * Ticket keys are owned by the SSL context and freed together with it.
+ */
+inline int ticket_keys_index() {
+	static const int index = SSL_CTX_get_ex_new_index(
+		0, nullptr, nullptr, nullptr,
+		[](void *, void *ptr, CRYPTO_EX_DATA *, int, long, void *) {
+			delete static_cast<session_ticket_keys *>(ptr);
+		});
+	return index;
+}
+
+inline session_ticket_keys *ticket_keys(SSL *ssl) {
+	return static_cast<session_ticket_keys *>(
+		SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ticket_keys_index()));
+}
+
+/*
+ * Selects the ticket key and sets up the cipher and MAC contexts.
+ * Returns 1 to accept a ticket, 2 to accept and renew it, 0 to reject it
+ * and -1 on failure.
+ */
+template <typename mac_setup>
+int seal_ticket(SSL *ssl, unsigned char *name, unsigned char *iv,
+				EVP_CIPHER_CTX *cipher, int encrypt, mac_setup setup_mac) {
+	session_ticket_keys *keys = ticket_keys(ssl);
+	if (keys == nullptr)
+		return -1;
+
+	session_ticket_keys::key key;
+	int result = 1;
+	if (encrypt) {
+		key = keys->current();
+		std::memcpy(name, key.name, session_ticket_keys::name_size);
+		if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) <= 0)
+			return -1;
+
+		if (!EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr,
+								key.cipher_key, iv))
+			return -1;
+	} else {
+		std::optional<std::pair<session_ticket_keys::key, bool>> found =
+			keys->find(name);
+		if (!found.has_value())
+			return 0;
+
+		key = found->first;
+		result = found->second ? 1 : 2;
+		if (!EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr,
+								key.cipher_key, iv))
+			return -1;
+	}
+
+	return setup_mac(key) ? result : -1;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+inline int ticket_key_callback(SSL *ssl, unsigned char *name,
+							   unsigned char *iv, EVP_CIPHER_CTX *cipher,
+							   EVP_MAC_CTX *mac, int encrypt) {
+	return seal_ticket(
+		ssl, name, iv, cipher, encrypt,
+		[mac](session_ticket_keys::key &key) {
+			char digest[] = "SHA256";
+			OSSL_PARAM params[] = {
+				OSSL_PARAM_construct_octet_string(
+					OSSL_MAC_PARAM_KEY, key.mac_key, sizeof(key.mac_key)),
+				OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest,
+												 0),
+				OSSL_PARAM_construct_end()};
+			return EVP_MAC_CTX_set_params(mac, params) == 1;
+		});
+}
+#else
+inline int ticket_key_callback(SSL *ssl, unsigned char *name,
+							   unsigned char *iv, EVP_CIPHER_CTX *cipher,
+							   HMAC_CTX *mac, int encrypt) {
+	return seal_ticket(ssl, name, iv, cipher, encrypt,
+					   [mac](session_ticket_keys::key &key) {
+						   return HMAC_Init_ex(mac, key.mac_key,
+											   sizeof(key.mac_key),
+											   EVP_sha256(), nullptr) == 1;
+					   });
+}
+#endif
+
+/*
+ * Flags on SSL contexts which opted into kernel TLS, and on connections
+ * which got it.
+ */
+inline int kernel_tls_context_index() {
+	static const int index =
+		SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+	return index;
+}
+
+inline int kernel_tls_connection_index() {
+	static const int index =
+		SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+	return index;
+}
+
+inline void *enabled_flag() {
+	static int flag;
+	return &flag;
+}
+
+/*
+ * Derives the TLS 1.2 key block from the master secret (RFC 5246, 6.3):
+ * client and server write MAC keys, if any, write keys and IVs, in this
+ * order.
+ */
+inline bool derive_key_block(SSL *ssl, const EVP_MD *digest,
+							 unsigned char *block, std::size_t size) {
+	unsigned char master[SSL_MAX_MASTER_KEY_LENGTH];
+	std::size_t master_size = SSL_SESSION_get_master_key(
+		SSL_get_session(ssl), master, sizeof(master));
+
+	unsigned char client_random[SSL3_RANDOM_SIZE];
+	unsigned char server_random[SSL3_RANDOM_SIZE];
+	SSL_get_client_random(ssl, client_random, sizeof(client_random));
+	SSL_get_server_random(ssl, server_random, sizeof(server_random));
+
+	static constexpr char label[] = "key expansion";
+	EVP_PKEY_CTX *prf = EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, nullptr);
+	bool derived =
+		(prf != nullptr) && (EVP_PKEY_derive_init(prf) > 0) &&
+		(EVP_PKEY_CTX_set_tls1_prf_md(prf, digest) > 0) &&
+		(EVP_PKEY_CTX_set1_tls1_prf_secret(prf, master,
+										   static_cast<int>(master_size)) >
+		 0) &&
+		(EVP_PKEY_CTX_add1_tls1_prf_seed(
+			 prf, reinterpret_cast<const unsigned char *>(label),
+			 sizeof(label) - 1) > 0) &&
+		(EVP_PKEY_CTX_add1_tls1_prf_seed(prf, server_random,
+										 sizeof(server_random)) > 0) &&
+		(EVP_PKEY_CTX_add1_tls1_prf_seed(prf, client_random,
+										 sizeof(client_random)) > 0) &&
+		(EVP_PKEY_derive(prf, block, &size) > 0);
+
+	EVP_PKEY_CTX_free(prf);
+	OPENSSL_cleanse(master, sizeof(master));
+	return derived;
+}
+
+#if defined(WEBDONKEY_KERNEL_TLS_OFFLOAD)
+template <class crypto_info>
+bool install_tx_keys(int fd, unsigned short cipher_type,
+					 const unsigned char *key, const unsigned char *salt,
+					 std::uint64_t sequence) {
+	crypto_info info{};
+	info.info.version = TLS_1_2_VERSION;
+	info.info.cipher_type = cipher_type;
+	std::memcpy(info.key, key, sizeof(info.key));
+	std::memcpy(info.salt, salt, sizeof(info.salt));
+	for (int i = sizeof(info.rec_seq) - 1; i >= 0; --i) {
+		info.rec_seq[i] = static_cast<unsigned char>(sequence & 0xff);
+		sequence >>= 8;
+	}
+
+	// The record sequence number doubles as the explicit nonce
+	std::memcpy(info.iv, info.rec_seq, sizeof(info.iv));
+	return ::setsockopt(fd, SOL_TLS, TLS_TX, &info, sizeof(info)) == 0;
+}
+
+/*
+ * Write side of an offloaded connection's OpenSSL engine, which is still
+ * used to decrypt requests. Whatever the engine sends from then on, e.g.
+ * an alert refusing renegotiation or reporting a bad record, would be
+ * encrypted a second time by the kernel and land amid the application
+ * data. It is discarded instead, and the connection is shut down, to be
+ * reset when closed.
+ */
+inline int engine_sink_write(BIO *bio, const char *, int size) {
+	const int fd =
+		static_cast<int>(reinterpret_cast<std::intptr_t>(BIO_get_data(bio)));
+	const ::linger reset{1, 0};
+	::setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+	::shutdown(fd, SHUT_RDWR);
+	return size;
+}
+
+inline long engine_sink_ctrl(BIO *, int cmd, long, void *) {
+	return (cmd == BIO_CTRL_FLUSH) ? 1 : 0;
+}
+
+inline int engine_sink_create(BIO *bio) {
+	BIO_set_init(bio, 1);
+	return 1;
+}
+
+inline BIO *engine_sink(int fd) {
+	static BIO_METHOD *const method = [] {
+		BIO_METHOD *sink =
+			BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK,
+						 "webdonkey kernel TLS engine sink");
+		BIO_meth_set_write(sink, engine_sink_write);
+		BIO_meth_set_ctrl(sink, engine_sink_ctrl);
+		BIO_meth_set_create(sink, engine_sink_create);
+		return sink;
+	}();
+
+	BIO *bio = BIO_new(method);
+	if (bio != nullptr)
+		BIO_set_data(bio,
+					 reinterpret_cast<void *>(static_cast<std::intptr_t>(fd)));
+
+	return bio;
+}
+#endif
+
+} // namespace tls_internals
+
+/**
+ * Enables resumption of TLS sessions on a server context: a server-side
+ * session cache, and stateless session tickets sealed with keys rotated
+ * every ticket_key_lifetime. Resumed connections skip the certificate
+ * exchange and key agreement of a full handshake.
+ */
+inline void enable_session_resumption(ssl::context &ctx,
+									  const tls_session_options &options = {}) {
+	SSL_CTX *native = ctx.native_handle();
+
+	static constexpr unsigned char session_id_context[] = "webdonkey";
+	SSL_CTX_set_session_id_context(native, session_id_context,
+								   sizeof(session_id_context) - 1);
+	SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_sess_set_cache_size(native, options.cache_size);
+	SSL_CTX_set_timeout(native,
+						static_cast<long>(options.session_lifetime.count()));
+
+	if (!options.tickets) {
+		SSL_CTX_set_options(native, SSL_OP_NO_TICKET);
+		return;
+	}
+
+	SSL_CTX_clear_options(native, SSL_OP_NO_TICKET);
+
+	const int index = tls_internals::ticket_keys_index();
+	delete static_cast<session_ticket_keys *>(
+		SSL_CTX_get_ex_data(native, index));
+	SSL_CTX_set_ex_data(native, index,
+						new session_ticket_keys{options.ticket_key_lifetime});
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	SSL_CTX_set_tlsext_ticket_key_evp_cb(native,
+										 tls_internals::ticket_key_callback);
+#else
+	SSL_CTX_set_tlsext_ticket_key_cb(native,
+									 tls_internals::ticket_key_callback);
+#endif
+}
+
+//==============================================================================
+
+// True if offload_to_kernel() can offload connections at all
+#if defined(WEBDONKEY_KERNEL_TLS_OFFLOAD)
+inline constexpr bool kernel_tls_built = true;
+#else
+inline constexpr bool kernel_tls_built = false;
+#endif
+
+/**
+ * Opts connections of a server context into kernel TLS: after the
+ * handshake, https() hands the transmit keys to the Linux TLS ULP, so that
+ * responses are encrypted by the kernel and file bodies go out with
+ * sendfile(2). Connections for which this is not possible (no kernel
+ * support, protocols other than TLS 1.2, ciphers other than AES-GCM) stay
+ * in user space.
+ *
+ * Only transmission is offloaded, requests are still decrypted by
+ * OpenSSL. Nothing OpenSSL sends reaches an offloaded connection: a
+ * connection on which it would send an alert, e.g. to refuse
+ * renegotiation, is dropped instead. Offloaded connections are closed
+ * without a close_notify.
+ *
+ * The offload is only built on Linux with WEBDONKEY_KERNEL_TLS defined, see
+ * kernel_tls_built; otherwise every connection stays in user space.
+ */
+inline void enable_kernel_tls(ssl::context &ctx) {
+	SSL_CTX_set_ex_data(ctx.native_handle(),
+						tls_internals::kernel_tls_context_index(),
+						tls_internals::enabled_flag());
+}
+
+inline bool kernel_tls_requested(ssl::context &ctx) {
+	return SSL_CTX_get_ex_data(ctx.native_handle(),
+							   tls_internals::kernel_tls_context_index()) ==
+		   tls_internals::enabled_flag();
+}
+
+/**
+ * True if the connection's transmit side has been offloaded to the kernel.
+ * Anything sent on such a connection must bypass OpenSSL and go to the
+ * TCP socket as plain text.
+ */
+inline bool kernel_tls(ssl_stream &stream) {
+	return SSL_get_ex_data(stream.native_handle(),
+						   tls_internals::kernel_tls_connection_index()) ==
+		   tls_internals::enabled_flag();
+}
+
+/**
+ * Moves encryption of outgoing records of a freshly established
+ * connection to the kernel. Must be called right after the handshake,
+ * before anything else is written.
+ * @return false if the connection stays in user space.
+ */
+inline bool offload_to_kernel([[maybe_unused]] ssl_stream &stream) {
+#if defined(WEBDONKEY_KERNEL_TLS_OFFLOAD)
+	SSL *ssl = stream.native_handle();
+	if (SSL_version(ssl) != TLS1_2_VERSION)
+		return false;
+
+	const SSL_CIPHER *cipher = SSL_get_current_cipher(ssl);
+	const int cipher_nid = SSL_CIPHER_get_cipher_nid(cipher);
+	std::size_t key_size;
+	if (cipher_nid == NID_aes_128_gcm)
+		key_size = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+	else if (cipher_nid == NID_aes_256_gcm)
+		key_size = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+	else
+		return false;
+
+	// Client and server write keys, then the implicit nonce parts
+	static constexpr std::size_t salt_size = TLS_CIPHER_AES_GCM_128_SALT_SIZE;
+	unsigned char block[2 * TLS_CIPHER_AES_GCM_256_KEY_SIZE + 2 * salt_size];
+	const std::size_t block_size = 2 * key_size + 2 * salt_size;
+	if (!tls_internals::derive_key_block(
+			ssl, SSL_CIPHER_get_handshake_digest(cipher), block, block_size))
+		return false;
+
+	const unsigned char *key = block + key_size;
+	const unsigned char *salt = block + 2 * key_size + salt_size;
+
+	// The server's Finished message was record 0 under these keys
+	static constexpr std::uint64_t sequence = 1;
+
+	int fd = beast::get_lowest_layer(stream).socket().native_handle();
+
+	// Made beforehand, as there is no way back once the keys are in
+	BIO *sink = tls_internals::engine_sink(fd);
+	static constexpr char ulp[] = "tls";
+	bool installed =
+		(sink != nullptr) &&
+		(::setsockopt(fd, SOL_TCP, TCP_ULP, ulp, sizeof(ulp)) == 0) &&
+		((key_size == TLS_CIPHER_AES_GCM_128_KEY_SIZE)
+			 ? tls_internals::install_tx_keys<tls12_crypto_info_aes_gcm_128>(
+				   fd, TLS_CIPHER_AES_GCM_128, key, salt, sequence)
+			 : tls_internals::install_tx_keys<tls12_crypto_info_aes_gcm_256>(
+				   fd, TLS_CIPHER_AES_GCM_256, key, salt, sequence));
+	OPENSSL_cleanse(block, sizeof(block));
+	if (!installed) {
+		BIO_free(sink);
+		return false;
+	}
+
+	/*
+	 * The engine must not write any more records under the same keys, but
+	 * refusing renegotiation does not stop it from sending alerts, so its
+	 * output is cut off from the socket for good.
+	 */
+	SSL_set_options(ssl, SSL_OP_NO_RENEGOTIATION);
+	SSL_set0_wbio(ssl, sink);
+	SSL_set_ex_data(ssl, tls_internals::kernel_tls_connection_index(),
+					tls_internals::enabled_flag());
+	return true;
+#else
+	return false;
+#endif
+}
+
+//==============================================================================
+
+namespace tls_internals {
+
+// ALPN protocol list in wire format, in order of preference
+inline constexpr unsigned char alpn_protocols[] = "\x02h2\x08http/1.1";
+
+// The same list without h2
+inline constexpr const unsigned char *alpn_http1 = alpn_protocols + 3;
+
+// Flags connections whose server accepts HTTP/2 streams
+inline int http2_connection_index() {
+	static const int index =
+		SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+	return index;
+}
+
+inline int alpn_select_callback(SSL *ssl, const unsigned char **out,
+								unsigned char *out_size,
+								const unsigned char *in, unsigned int in_size,
+								void *) {
+	const bool http2 = SSL_get_ex_data(ssl, http2_connection_index()) ==
+					   enabled_flag();
+	const unsigned char *offered = http2 ? alpn_protocols : alpn_http1;
+	const unsigned int offered_size =
+		sizeof(alpn_protocols) - 1 - (offered - alpn_protocols);
+
+	unsigned char *selected = nullptr;
+	if (SSL_select_next_proto(&selected, out_size, offered, offered_size, in,
+							  in_size) != OPENSSL_NPN_NEGOTIATED)
+		return SSL_TLSEXT_ERR_NOACK;
+
+	*out = selected;
+	return SSL_TLSEXT_ERR_OK;
+}
+
+} // namespace tls_internals
+
+/**
+ * Offers HTTP/2 through ALPN on a server context, preferring it over
+ * HTTP/1.1. h2 is offered only on connections marked with
+ * accept_http2(), which https() does when the server accepts HTTP/2
+ * streams; https() serves those which negotiate it with serve_http2().
+ */
+inline void enable_http2(ssl::context &ctx) {
+	SSL_CTX_set_alpn_select_cb(ctx.native_handle(),
+							   tls_internals::alpn_select_callback, nullptr);
+}
+
+/**
+ * Marks a connection as able to serve HTTP/2, letting enable_http2() offer
+ * h2 to its client. Must be called before the handshake.
+ */
+inline void accept_http2(ssl_stream &stream) {
+	SSL_set_ex_data(stream.native_handle(),
+					tls_internals::http2_connection_index(),
+					tls_internals::enabled_flag());
+}
+
+/**
+ * True if the client has chosen HTTP/2 during the handshake.
+ */
+inline bool http2_negotiated(ssl_stream &stream) {
+	const unsigned char *protocol = nullptr;
+	unsigned int size = 0;
+	SSL_get0_alpn_selected(stream.native_handle(), &protocol, &size);
+	return (size == 2) && (std::memcmp(protocol, "h2", 2) == 0);
+}
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_TLS_HPP_ */
@@ -8,59 +8,217 @@
 #ifndef LIB_WEBDONKEY_HTTP_UTILS_HPP_
 #define LIB_WEBDONKEY_HTTP_UTILS_HPP_
 
+#include <algorithm>
+#include <deque>
 #include <filesystem>
+#include <fstream>
 #include <regex>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <webdonkey/defs.hpp>
 
 namespace webdonkey {
 
-static std::string mime_type(const std::filesystem::path &file_path) {
-	using beast::iequals;
-	std::filesystem::path ext = file_path.extension();
-	if (iequals(ext.c_str(), ".htm"))
-		return "text/html";
-	if (iequals(ext.c_str(), ".html"))
-		return "text/html";
-	if (iequals(ext.c_str(), ".php"))
-		return "text/html";
-	if (iequals(ext.c_str(), ".css"))
-		return "text/css";
-	if (iequals(ext.c_str(), ".txt"))
-		return "text/plain";
-	if (iequals(ext.c_str(), ".js"))
-		return "application/javascript";
-	if (iequals(ext.c_str(), ".json"))
-		return "application/json";
-	if (iequals(ext.c_str(), ".xml"))
-		return "application/xml";
-	if (iequals(ext.c_str(), ".swf"))
-		return "application/x-shockwave-flash";
-	if (iequals(ext.c_str(), ".flv"))
-		return "video/x-flv";
-	if (iequals(ext.c_str(), ".png"))
-		return "image/png";
-	if (iequals(ext.c_str(), ".jpe"))
-		return "image/jpeg";
-	if (iequals(ext.c_str(), ".jpeg"))
-		return "image/jpeg";
-	if (iequals(ext.c_str(), ".jpg"))
-		return "image/jpeg";
-	if (iequals(ext.c_str(), ".gif"))
-		return "image/gif";
-	if (iequals(ext.c_str(), ".bmp"))
-		return "image/bmp";
-	if (iequals(ext.c_str(), ".ico"))
-		return "image/vnd.microsoft.icon";
-	if (iequals(ext.c_str(), ".tiff"))
-		return "image/tiff";
-	if (iequals(ext.c_str(), ".tif"))
-		return "image/tiff";
-	if (iequals(ext.c_str(), ".svg"))
-		return "image/svg+xml";
-	if (iequals(ext.c_str(), ".svgz"))
-		return "image/svg+xml";
-	return "application/text";
+/**
+ * Case-insensitive map of file extensions to MIME types. Lookups take
+ * constant time and don't allocate. The table is meant to be extended
+ * at startup, before any lookups are made from worker threads.
+ */
+class mime_table {
+public:
+	// Longer extensions are never matched
+	static constexpr std::size_t max_extension = 15;
+
+	mime_table(const mime_table &) = delete;
+	mime_table(mime_table &&) = delete;
+	mime_table &operator=(const mime_table &) = delete;
+	mime_table &operator=(mime_table &&) = delete;
+
+	static mime_table &shared() {
+		static mime_table table;
+		return table;
+	}
+
+	/**
+	 * @param extension file extension without the leading dot.
+	 */
+	std::string_view lookup(std::string_view extension) const {
+		char key[max_extension];
+		if (!lower_case(extension, key))
+			return _default;
+
+		std::string_view lowered{key, extension.size()};
+		const std::size_t mask = _slots.size() - 1;
+		for (std::size_t i = hash(lowered) & mask;; i = (i + 1) & mask) {
+			const slot &candidate = _slots[i];
+			if (candidate.type.empty())
+				return _default;
+
+			if (lowered == candidate.extension())
+				return candidate.type;
+		}
+	}
+
+	/**
+	 * Maps an extension (without the leading dot) to a type, replacing
+	 * the previous mapping if any.
+	 */
+	void add(std::string_view extension, std::string_view type) {
+		char key[max_extension];
+		if (type.empty() || !lower_case(extension, key))
+			return;
+
+		if (2 * (_count + 1) > _slots.size())
+			rehash(2 * _slots.size());
+
+		insert({key, extension.size()}, own(type));
+	}
+
+	/**
+	 * Loads mappings from a file in mime.types format: a MIME type followed
+	 * by its extensions on each line, '#' starting a comment.
+	 * @return the number of extensions added.
+	 */
+	std::size_t load(const std::filesystem::path &path) {
+		std::ifstream input{path};
+		if (!input)
+			throw std::filesystem::filesystem_error{
+				"Cannot read MIME types", path,
+				std::make_error_code(std::errc::no_such_file_or_directory)};
+
+		std::size_t added = 0;
+		std::string line;
+		while (std::getline(input, line)) {
+			line = line.substr(0, line.find('#'));
+			std::istringstream tokens{line};
+			std::string type;
+			if (!(tokens >> type))
+				continue;
+
+			std::string extension;
+			while (tokens >> extension) {
+				add(extension, type);
+				++added;
+			}
+		}
+
+		return added;
+	}
+
+	// Type of files with unknown extensions
+	std::string_view default_type() const { return _default; }
+
+	void set_default_type(std::string_view type) { _default = own(type); }
+
+private:
+	struct slot {
+		char key[max_extension] = {};
+		std::uint8_t length = 0;
+		std::string_view type;
+
+		std::string_view extension() const { return {key, length}; }
+	};
+
+	mime_table() {
+		_slots.resize(64);
+		static constexpr std::pair<std::string_view, std::string_view>
+			builtin[] = {{"htm", "text/html"},
+						 {"html", "text/html"},
+						 {"php", "text/html"},
+						 {"css", "text/css"},
+						 {"txt", "text/plain"},
+						 {"js", "application/javascript"},
+						 {"json", "application/json"},
+						 {"xml", "application/xml"},
+						 {"swf", "application/x-shockwave-flash"},
+						 {"flv", "video/x-flv"},
+						 {"png", "image/png"},
+						 {"jpe", "image/jpeg"},
+						 {"jpeg", "image/jpeg"},
+						 {"jpg", "image/jpeg"},
+						 {"gif", "image/gif"},
+						 {"bmp", "image/bmp"},
+						 {"ico", "image/vnd.microsoft.icon"},
+						 {"tiff", "image/tiff"},
+						 {"tif", "image/tiff"},
+						 {"svg", "image/svg+xml"},
+						 {"svgz", "image/svg+xml"}};
+
+		for (const auto &[extension, type] : builtin)
+			insert(extension, type);
+	}
+
+	static bool lower_case(std::string_view text, char *out) {
+		if (text.empty() || (text.size() > max_extension))
+			return false;
+
+		for (std::size_t i = 0; i < text.size(); ++i)
+			out[i] = ((text[i] >= 'A') && (text[i] <= 'Z'))
+						 ? static_cast<char>(text[i] - 'A' + 'a')
+						 : text[i];
+		return true;
+	}
+
+	// FNV-1a
+	static std::size_t hash(std::string_view key) {
+		std::uint64_t value = 14695981039346656037ull;
+		for (char c : key)
+			value = (value ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+		return static_cast<std::size_t>(value);
+	}
+
+	void insert(std::string_view key, std::string_view type) {
+		const std::size_t mask = _slots.size() - 1;
+		for (std::size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+			slot &candidate = _slots[i];
+			if (candidate.type.empty()) {
+				std::copy(key.begin(), key.end(), candidate.key);
+				candidate.length = static_cast<std::uint8_t>(key.size());
+				candidate.type = type;
+				++_count;
+				return;
+			}
+
+			if (candidate.extension() == key) {
+				candidate.type = type;
+				return;
+			}
+		}
+	}
+
+	void rehash(std::size_t size) {
+		std::vector<slot> old(size);
+		old.swap(_slots);
+		_count = 0;
+		for (const slot &entry : old)
+			if (!entry.type.empty())
+				insert(entry.extension(), entry.type);
+	}
+
+	std::string_view own(std::string_view type) {
+		return _types.emplace_back(type);
+	}
+
+	std::vector<slot> _slots;
+	std::size_t _count = 0;
+	std::deque<std::string> _types;
+	std::string_view _default = "application/text";
+};
+
+static std::string_view mime_type(const std::filesystem::path &file_path) {
+	std::string_view name = file_path.native();
+	std::size_t slash = name.find_last_of('/');
+	if (slash != std::string_view::npos)
+		name = name.substr(slash + 1);
+
+	// Names like ".htaccess" have no extension
+	std::size_t dot = name.find_last_of('.');
+	if ((dot == std::string_view::npos) || (dot == 0))
+		return mime_table::shared().default_type();
+
+	return mime_table::shared().lookup(name.substr(dot + 1));
 }
 
 static std::string_view prefix_matching(std::string_view path,
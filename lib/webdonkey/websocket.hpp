@@ -0,0 +1,629 @@
+/*
+ * websocket.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#ifndef LIB_WEBDONKEY_WEBSOCKET_HPP_
+#define LIB_WEBDONKEY_WEBSOCKET_HPP_
+
+#include <boost/beast/websocket.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <webdonkey/http.hpp>
+#include <webdonkey/recycling.hpp>
+
+namespace webdonkey {
+
+/**
+ * What becomes of a message sent to a connection whose send queue is full.
+ */
+enum class slow_consumer_policy {
+	// Queued messages are dropped, oldest first, to make room for it
+	drop_oldest,
+
+	// The message is dropped; the queue is left as it is
+	drop_newest,
+
+	// The connection is closed
+	disconnect
+};
+
+struct websocket_options {
+	// Largest message accepted from a client
+	std::uint64_t max_message_size = 64 * 1024;
+
+	/*
+	 * Limits of the send queue of a connection. A message is always
+	 * accepted into an empty queue, however large.
+	 */
+	std::size_t max_queued_messages = 1024;
+	std::size_t max_queued_bytes = 4 * 1024 * 1024;
+
+	slow_consumer_policy slow_consumer = slow_consumer_policy::disconnect;
+
+	// Limit of the opening and closing handshakes
+	std::chrono::steady_clock::duration handshake_timeout =
+		std::chrono::seconds(30);
+
+	/*
+	 * A client silent for half of this is pinged, and the connection is
+	 * dropped if it is still silent when the full period is over.
+	 */
+	std::chrono::steady_clock::duration idle_timeout =
+		std::chrono::seconds(300);
+};
+
+/**
+ * Immutable message, shared by all connections it is sent to. Copies share
+ * the payload, which is written to each socket from where it is, without
+ * being copied per connection.
+ */
+class websocket_message {
+public:
+	explicit websocket_message(std::string payload, bool binary = false) :
+		_payload{std::make_shared<const std::string>(std::move(payload))},
+		_binary{binary} {}
+
+	asio::const_buffer buffer() const { return asio::buffer(*_payload); }
+
+	std::size_t size() const { return _payload->size(); }
+
+	bool binary() const { return _binary; }
+
+private:
+	std::shared_ptr<const std::string> _payload;
+	bool _binary;
+};
+
+namespace websocket_internals {
+
+/*
+ * Send queue of a connection. Messages are queued from any thread and
+ * written by the connection's writer on the executor of its socket.
+ */
+class outbox : public std::enable_shared_from_this<outbox> {
+public:
+	outbox(tcp_stream &transport, const websocket_options &options) :
+		_transport{&transport}, _timer{transport.get_executor()},
+		_max_messages{options.max_queued_messages},
+		_max_bytes{options.max_queued_bytes},
+		_policy{options.slow_consumer} {}
+
+	/*
+	 * Queues message, unless the connection is closing or too far behind.
+	 * @return false if the message is not going to be sent.
+	 */
+	bool push(const websocket_message &message) {
+		std::unique_lock lock{_mutex};
+		if (_closed)
+			return false;
+
+		if (full(message.size())) {
+			if (_policy == slow_consumer_policy::drop_newest)
+				return false;
+
+			if (_policy == slow_consumer_policy::disconnect) {
+				lock.unlock();
+				abort();
+				return false;
+			}
+
+			while (full(message.size())) {
+				_queued_bytes -= _queue.front().size();
+				_queue.pop_front();
+			}
+		}
+
+		_queue.push_back(message);
+		_queued_bytes += message.size();
+		const bool wake = std::exchange(_waiting, false);
+		lock.unlock();
+
+		if (wake)
+			notify(false);
+
+		return true;
+	}
+
+	// Takes no more messages; those already queued are still written
+	void close() {
+		std::unique_lock lock{_mutex};
+		_closed = true;
+		const bool wake = std::exchange(_waiting, false);
+		lock.unlock();
+
+		if (wake)
+			notify(false);
+	}
+
+	// Drops the queue and cancels the I/O of the connection
+	void abort() {
+		{
+			std::lock_guard lock{_mutex};
+			_closed = true;
+			_queue.clear();
+			_queued_bytes = 0;
+			_waiting = false;
+		}
+
+		notify(true);
+	}
+
+	/*
+	 * Next message to write. If there is none, the writer is expected to
+	 * wait() before trying again.
+	 */
+	std::optional<websocket_message> pop() {
+		std::lock_guard lock{_mutex};
+		if (_queue.empty()) {
+			_waiting = !_closed;
+			return std::nullopt;
+		}
+
+		websocket_message message = std::move(_queue.front());
+		_queue.pop_front();
+		_queued_bytes -= message.size();
+		return message;
+	}
+
+	/*
+	 * Waits for a message to be queued.
+	 * @return false once the outbox is closed and drained.
+	 */
+	awaitable<bool> wait() {
+		bool waiting;
+		{
+			std::lock_guard lock{_mutex};
+			waiting = _waiting;
+		}
+
+		/*
+		 * A wakeup is posted to the same executor, hence cannot slip in
+		 * between the check above and the start of the wait.
+		 */
+		if (waiting) {
+			_timer.expires_at(asio::steady_timer::time_point::max());
+			beast::error_code ec;
+			co_await _timer.async_wait(
+				asio::redirect_error(recycled_awaitable, ec));
+		}
+
+		bool open;
+		{
+			std::lock_guard lock{_mutex};
+			open = !_closed || !_queue.empty();
+		}
+
+		co_return open;
+	}
+
+	// Called on the connection's executor once its socket is done with
+	void detach() { _transport = nullptr; }
+
+private:
+	bool full(std::size_t size) const {
+		return !_queue.empty() && ((_queue.size() >= _max_messages) ||
+								   (_queued_bytes + size > _max_bytes));
+	}
+
+	void notify(bool cancel_io) {
+		asio::post(_timer.get_executor(),
+				   [self = shared_from_this(), cancel_io] {
+					   self->_timer.cancel();
+					   if (cancel_io && self->_transport)
+						   self->_transport->cancel();
+				   });
+	}
+
+	// Used on the connection's executor only
+	tcp_stream *_transport;
+	asio::steady_timer _timer;
+
+	std::size_t _max_messages;
+	std::size_t _max_bytes;
+	slow_consumer_policy _policy;
+
+	std::mutex _mutex;
+	std::deque<websocket_message> _queue;
+	std::size_t _queued_bytes = 0;
+	bool _waiting = false;
+	bool _closed = false;
+};
+
+/*
+ * Transport of a WebSocket on a TLS connection offloaded to the kernel:
+ * frames are read through OpenSSL, but written to the socket as they are,
+ * to be encrypted by the kernel.
+ */
+class kernel_tls_layer {
+public:
+	using executor_type = ssl_stream::executor_type;
+
+	explicit kernel_tls_layer(ssl_stream &stream) : _stream{&stream} {}
+
+	executor_type get_executor() noexcept { return _stream->get_executor(); }
+
+	ssl_stream &next_layer() { return *_stream; }
+
+	template <class buffer_sequence, typename token_type>
+	auto async_read_some(const buffer_sequence &buffers, token_type &&token) {
+		return _stream->async_read_some(buffers,
+										std::forward<token_type>(token));
+	}
+
+	template <class buffer_sequence, typename token_type>
+	auto async_write_some(const buffer_sequence &buffers, token_type &&token) {
+		return beast::get_lowest_layer(*_stream).async_write_some(
+			buffers, std::forward<token_type>(token));
+	}
+
+	// Offloaded connections are closed without a close_notify
+	friend void teardown(beast::role_type role, kernel_tls_layer &layer,
+						 beast::error_code &ec) {
+		using beast::websocket::teardown;
+		teardown(role, beast::get_lowest_layer(*layer._stream), ec);
+	}
+
+	template <typename handler_type>
+	friend void async_teardown(beast::role_type role, kernel_tls_layer &layer,
+							   handler_type &&handler) {
+		using beast::websocket::async_teardown;
+		async_teardown(role, beast::get_lowest_layer(*layer._stream),
+					   std::forward<handler_type>(handler));
+	}
+
+private:
+	ssl_stream *_stream;
+};
+
+} // namespace websocket_internals
+
+template <class next_layer> class websocket_connection;
+
+/**
+ * Broadcasts messages to the WebSocket connections subscribed to it. A
+ * published message is queued for every subscriber by reference, so a
+ * subscriber costs a reference count rather than a copy of the message.
+ * How far subscribers may fall behind is limited by their
+ * websocket_options.
+ *
+ * Channels may be used from any thread. Messages published by one thread
+ * reach all subscribers in the order of publishing.
+ */
+class websocket_channel {
+public:
+	/**
+	 * Queues message for all subscribers.
+	 * @return the number of connections it is going to be sent to.
+	 */
+	std::size_t publish(const websocket_message &message) {
+		std::lock_guard lock{_mutex};
+		std::size_t queued = 0;
+		for (const auto &subscriber : _subscribers)
+			if (subscriber->push(message))
+				++queued;
+
+		return queued;
+	}
+
+	std::size_t subscribers() const {
+		std::lock_guard lock{_mutex};
+		return _subscribers.size();
+	}
+
+private:
+	template <class> friend class websocket_connection;
+
+	using outbox_ptr = std::shared_ptr<websocket_internals::outbox>;
+
+	void subscribe(outbox_ptr subscriber) {
+		std::lock_guard lock{_mutex};
+		_subscribers.push_back(std::move(subscriber));
+	}
+
+	void unsubscribe(const outbox_ptr &subscriber) {
+		std::lock_guard lock{_mutex};
+		for (auto &entry : _subscribers)
+			if (entry == subscriber) {
+				entry = std::move(_subscribers.back());
+				_subscribers.pop_back();
+				break;
+			}
+	}
+
+	mutable std::mutex _mutex;
+	std::vector<outbox_ptr> _subscribers;
+};
+
+using websocket_channel_ptr = std::shared_ptr<websocket_channel>;
+
+/**
+ * WebSocket connection handed to the handler of a websocket_responder once
+ * the opening handshake is done. Messages are sent from a queue, written
+ * by a coroutine of the connection's own, so sending never waits for the
+ * client; the handler is left to read. The connection is closed when the
+ * handler returns.
+ */
+template <class next_layer> class websocket_connection {
+public:
+	using stream_type = beast::websocket::stream<next_layer>;
+
+	websocket_connection(const websocket_connection<next_layer> &) = delete;
+	websocket_connection(websocket_connection<next_layer> &&) = delete;
+
+	websocket_connection<next_layer> &
+	operator=(const websocket_connection<next_layer> &) = delete;
+
+	websocket_connection<next_layer> &
+	operator=(websocket_connection<next_layer> &&) = delete;
+
+	stream_type &stream() { return _stream; }
+
+	// The upgrade request
+	const webdonkey::request &request() const { return _request; }
+
+	/**
+	 * Queues message for sending. May be called from any thread.
+	 * @return false if it was dropped, see slow_consumer_policy.
+	 */
+	bool send(const websocket_message &message) {
+		return _outbox->push(message);
+	}
+
+	/**
+	 * Subscribes the connection to channel for as long as it is open.
+	 * Called from the handler.
+	 */
+	void subscribe(const websocket_channel_ptr &channel) {
+		channel->subscribe(_outbox);
+		_channels.push_back(channel);
+	}
+
+	/**
+	 * Reads the next message from the client into buffer.
+	 * @return false once the client has closed the connection.
+	 */
+	awaitable<bool> read(beast::flat_buffer &buffer) {
+		beast::error_code ec;
+		co_await _stream.async_read(
+			buffer, asio::redirect_error(recycled_awaitable, ec));
+		if (ec == beast::websocket::error::closed)
+			co_return false;
+
+		if (ec)
+			throw boost::system::system_error{ec};
+
+		co_return true;
+	}
+
+	/**
+	 * Discards messages from the client until it closes the connection,
+	 * for handlers which only send. Pings are answered meanwhile.
+	 */
+	awaitable<void> read_until_closed() {
+		beast::flat_buffer buffer;
+		for (;;) {
+			const bool open = co_await read(buffer);
+			if (!open)
+				break;
+
+			buffer.consume(buffer.size());
+		}
+	}
+
+private:
+	template <typename> friend class websocket_responder;
+
+	template <class transport>
+	websocket_connection(transport &stream, const webdonkey::request &req,
+						 const websocket_options &options) :
+		_stream{stream}, _request{req}, _options{options},
+		_outbox{std::make_shared<websocket_internals::outbox>(
+			beast::get_lowest_layer(stream), options)},
+		_joined{stream.get_executor()} {}
+
+	template <typename handler_type>
+	awaitable<void> run(const handler_type &handler);
+
+	awaitable<void> write_queued() {
+		for (;;) {
+			std::optional<websocket_message> message = _outbox->pop();
+			if (!message) {
+				const bool open = co_await _outbox->wait();
+				if (!open)
+					break;
+
+				continue;
+			}
+
+			_stream.binary(message->binary());
+			beast::error_code ec;
+			co_await _stream.async_write(
+				message->buffer(),
+				asio::redirect_error(recycled_awaitable, ec));
+			if (ec) {
+				_outbox->abort();
+				break;
+			}
+		}
+	}
+
+	stream_type _stream;
+	const webdonkey::request &_request;
+	websocket_options _options;
+	std::shared_ptr<websocket_internals::outbox> _outbox;
+	std::vector<websocket_channel_ptr> _channels;
+	asio::steady_timer _joined;
+	bool _writing = false;
+};
+
+template <class next_layer>
+template <typename handler_type>
+awaitable<void>
+websocket_connection<next_layer>::run(const handler_type &handler) {
+	// The WebSocket timeouts take over from those of the stream
+	beast::get_lowest_layer(_stream).expires_never();
+	beast::websocket::stream_base::timeout timeout{
+		_options.handshake_timeout, _options.idle_timeout, true};
+	_stream.set_option(timeout);
+	_stream.read_message_max(_options.max_message_size);
+
+	// Messages go out whole, straight from their shared buffers
+	_stream.auto_fragment(false);
+
+	co_await _stream.async_accept(_request, recycled_awaitable);
+
+	_writing = true;
+	asio::co_spawn(_stream.get_executor(), write_queued(),
+				   [this](std::exception_ptr) {
+					   _writing = false;
+					   _joined.cancel();
+				   });
+
+	std::exception_ptr failure;
+	try {
+		co_await handler(*this);
+	} catch (boost::system::system_error &) {
+		// The connection failed or was dropped as a slow consumer
+	} catch (...) {
+		failure = std::current_exception();
+	}
+
+	for (const websocket_channel_ptr &channel : _channels)
+		channel->unsubscribe(_outbox);
+
+	// Draining the queue and closing may take no longer than a handshake
+	asio::steady_timer deadline{_stream.get_executor()};
+	deadline.expires_after(_options.handshake_timeout);
+	deadline.async_wait([outbox = _outbox](beast::error_code ec) {
+		if (!ec)
+			outbox->abort();
+	});
+
+	_outbox->close();
+	while (_writing) {
+		_joined.expires_at(asio::steady_timer::time_point::max());
+		beast::error_code ec;
+		co_await _joined.async_wait(
+			asio::redirect_error(recycled_awaitable, ec));
+	}
+
+	if (_stream.is_open()) {
+		beast::websocket::close_reason reason{
+			beast::websocket::close_code::normal};
+		beast::error_code ec;
+		co_await _stream.async_close(
+			reason, asio::redirect_error(recycled_awaitable, ec));
+	}
+
+	deadline.cancel();
+	_outbox->detach();
+	if (failure)
+		std::rethrow_exception(failure);
+}
+
+/**
+ * Upgrades requests for the route itself to WebSocket connections, which
+ * are handed to handler, a coroutine taking a websocket_connection<T>&;
+ * a generic one serves connections of all kinds. No HTTP requests are
+ * served on the connection afterwards, and it is closed once the handler
+ * returns.
+ *
+ * Plain TCP, TLS and kernel TLS connections can be upgraded. Requests
+ * other than upgrades are answered with 426 Upgrade Required, as are
+ * requests on HTTP/2 streams, which cannot be upgraded.
+ */
+template <typename handler_type> class websocket_responder {
+public:
+	explicit websocket_responder(handler_type handler,
+								 websocket_options options = {}) :
+		_handler{std::move(handler)}, _options{std::move(options)} {}
+
+	template <class socket_stream>
+	awaitable<expected_response> operator()(request_context<socket_stream> &ctx,
+											std::string_view target) const {
+		if (!target.empty() && !target.starts_with('?'))
+			co_return std::unexpected{
+				protocol_error{beast::http::status::not_found, ""}};
+
+		if constexpr (std::is_same_v<socket_stream, http2_stream>) {
+			co_return upgrade_required(ctx.request());
+		} else {
+			if (!beast::websocket::is_upgrade(ctx.request()))
+				co_return upgrade_required(ctx.request());
+
+			// Clients must await the handshake before sending any frames
+			if (ctx.buffer().size() > 0)
+				co_return std::unexpected{protocol_error{
+					beast::http::status::bad_request, "", false}};
+
+			// Answers to pipelined requests precede the handshake
+			co_await ctx.flush();
+			ctx.force_keep_alive(false);
+			ctx.record_status(beast::http::status::switching_protocols);
+
+			/*
+			 * The writer of the connection runs alongside the handler, so
+			 * both are run on the executor of the socket.
+			 */
+			auto executor =
+				beast::get_lowest_layer(ctx.stream()).get_executor();
+			if constexpr (std::is_same_v<socket_stream, ssl_stream>) {
+				if (kernel_tls(ctx.stream())) {
+					co_await asio::co_spawn(
+						executor,
+						session<websocket_internals::kernel_tls_layer>(
+							ctx.stream(), ctx.request()),
+						recycled_awaitable);
+					co_return http_response{};
+				}
+			}
+
+			co_await asio::co_spawn(
+				executor, session<socket_stream &>(ctx.stream(), ctx.request()),
+				recycled_awaitable);
+			co_return http_response{};
+		}
+	}
+
+private:
+	/*
+	 * 426 naming the protocol to upgrade to, RFC 9110, section 15.5.22.
+	 * HTTP/2 streams leave out the upgrade fields.
+	 */
+	static http_response upgrade_required(const webdonkey::request &req) {
+		empty_response res{beast::http::status::upgrade_required,
+						   req.version()};
+		res.set(beast::http::field::upgrade, "websocket");
+		res.set(beast::http::field::connection, "Upgrade");
+		res.keep_alive(req.keep_alive());
+		res.prepare_payload();
+		return res;
+	}
+
+	template <class next_layer, class socket_stream>
+	awaitable<void> session(socket_stream &stream,
+							const webdonkey::request &req) const {
+		websocket_connection<next_layer> connection{stream, req, _options};
+		co_await connection.run(_handler);
+	}
+
+	handler_type _handler;
+	websocket_options _options;
+};
+
+} // namespace webdonkey
+
+#endif /* LIB_WEBDONKEY_WEBSOCKET_HPP_ */
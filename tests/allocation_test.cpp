@@ -0,0 +1,185 @@
+/*
+ * allocation_test.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ *
+ * Heap allocations per request on a keep-alive connection. operator new is
+ * replaced for the whole test program, counting per thread; other suites
+ * are not affected.
+ */
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <webdonkey/http.hpp>
+
+namespace {
+
+thread_local std::uint64_t allocations = 0;
+
+} // namespace
+
+void *operator new(std::size_t size) {
+	++allocations;
+	if (void *p = std::malloc(size == 0 ? 1 : size))
+		return p;
+
+	throw std::bad_alloc{};
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete[](void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+using namespace webdonkey;
+
+namespace {
+
+using string_response = beast::http::response<beast::http::string_body>;
+
+/*
+ * A keep-alive connection over loopback, served on the test thread, so
+ * that allocations of the server are counted.
+ */
+class connection_fixture {
+public:
+	static constexpr std::string_view request_text =
+		"GET /index.html HTTP/1.1\r\nHost: localhost\r\n"
+		"User-Agent: allocation_test\r\nAccept: */*\r\n\r\n";
+
+	template <typename responder_type>
+	explicit connection_fixture(responder_type responder) {
+		tcp::acceptor acceptor{
+			_io, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+		_client.connect(acceptor.local_endpoint());
+		acceptor.accept(_server);
+		asio::co_spawn(_io, http(_server, responder), asio::detached);
+
+		// Responses are all alike; the first one tells their size
+		asio::write(_client, asio::buffer(request_text));
+		std::string head;
+		while (head.find("\r\n\r\n") == std::string::npos) {
+			_io.poll();
+			head.append(_chunk.data(), receive());
+		}
+
+		BOOST_TEST(head.starts_with("HTTP/1.1 200 OK\r\n"));
+		const std::size_t header_size = head.find("\r\n\r\n") + 4;
+		const std::size_t length_at = head.find("Content-Length: ") + 16;
+		_response_size = header_size + std::stoul(head.substr(length_at));
+		for (std::size_t received = head.size(); received < _response_size;) {
+			_io.poll();
+			received += receive();
+		}
+	}
+
+	~connection_fixture() {
+		_client.close();
+		_io.run();
+	}
+
+	// Sends a request and waits for the response, allocating nothing
+	void round_trip() {
+		asio::write(_client, asio::buffer(request_text));
+		for (std::size_t received = 0; received < _response_size;) {
+			_io.poll();
+			received += receive();
+		}
+	}
+
+	/**
+	 * @return allocations per request, on average over n requests.
+	 */
+	double allocations_per_request(std::size_t n) {
+		const std::uint64_t start = allocations;
+		for (std::size_t i = 0; i < n; ++i)
+			round_trip();
+
+		return static_cast<double>(allocations - start) / n;
+	}
+
+private:
+	std::size_t receive() {
+		if (_client.available() == 0)
+			return 0;
+
+		return _client.read_some(asio::buffer(_chunk));
+	}
+
+	asio::io_context _io;
+	tcp::socket _client{_io};
+	tcp::socket _server{_io};
+	std::array<char, 4096> _chunk;
+	std::size_t _response_size = 0;
+};
+
+string_response hello_response() {
+	string_response res{beast::http::status::ok, 11};
+	res.set(beast::http::field::content_type, "text/html");
+	res.body() = "<html><body>Hello</body></html>";
+	res.prepare_payload();
+	return res;
+}
+
+/*
+ * Requests are not served without allocating: Asio allocates use_awaitable
+ * coroutine frames and functions posted through any_io_executor itself,
+ * from caches which nested coroutines overflow. What is checked is that
+ * the count is the same for every request, at most the one measured with
+ * Boost 1.74, so that a change adding allocations to the request path
+ * fails.
+ */
+void check_steady_state(connection_fixture &connection,
+						double max_allocations) {
+	connection.allocations_per_request(100);
+	const double first = connection.allocations_per_request(1000);
+	const double second = connection.allocations_per_request(1000);
+	BOOST_TEST_MESSAGE("allocations per request: " << first << ", "
+												   << second);
+	BOOST_TEST(first <= max_allocations);
+	BOOST_TEST(second == first);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(allocation_tests)
+
+BOOST_AUTO_TEST_CASE(written_response) {
+	string_response response = hello_response();
+	connection_fixture connection{
+		[&](request_context<tcp_stream> &ctx) -> awaitable<http_response> {
+			co_await ctx.write(response);
+			co_return nullptr;
+		}};
+	check_steady_state(connection, 11);
+}
+
+BOOST_AUTO_TEST_CASE(returned_response) {
+	const string_response response = hello_response();
+	connection_fixture connection{
+		[&](request_context<tcp_stream> &) -> awaitable<http_response> {
+			co_return string_response{response};
+		}};
+	check_steady_state(connection, 16);
+}
+
+BOOST_AUTO_TEST_CASE(canned) {
+	const canned_response response{hello_response()};
+	connection_fixture connection{
+		[&](request_context<tcp_stream> &ctx) -> awaitable<http_response> {
+			co_return response(ctx.request());
+		}};
+	check_steady_state(connection, 13);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,184 @@
+/*
+ * canned_response_test.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <webdonkey/canned_response.hpp>
+
+using namespace webdonkey;
+
+namespace {
+
+using request = beast::http::request<beast::http::empty_body>;
+using response = beast::http::response<beast::http::string_body>;
+
+request make_request(beast::http::verb method = beast::http::verb::get,
+					 unsigned version = 11) {
+	return request{method, "/", version};
+}
+
+// The unsent part of message, as written
+std::string text_of(const canned_message &message) {
+	std::array<asio::const_buffer, canned_message::max_buffers> buffers;
+	const std::size_t count = message.prepare(buffers);
+
+	std::string text;
+	for (std::size_t i = 0; i < count; ++i)
+		text.append(static_cast<const char *>(buffers[i].data()),
+					buffers[i].size());
+
+	return text;
+}
+
+response parse(const std::string &text, bool head = false) {
+	beast::http::response_parser<beast::http::string_body> parser;
+	parser.skip(head);
+	parser.eager(true);
+
+	beast::error_code ec;
+	const std::size_t used = parser.put(asio::buffer(text), ec);
+	BOOST_TEST(!ec, ec.message());
+	BOOST_TEST(used == text.size());
+	BOOST_TEST(parser.is_done());
+	return parser.release();
+}
+
+canned_response not_found() {
+	response message{beast::http::status::not_found, 11};
+	message.set(beast::http::field::server, "webdonkey");
+	message.set(beast::http::field::content_type, "text/plain");
+	message.set(beast::http::field::date, "stale");
+	message.set(beast::http::field::connection, "close");
+	message.body() = "Not found";
+	message.prepare_payload();
+	return canned_response{message};
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(canned_response_tests)
+
+BOOST_AUTO_TEST_CASE(keep_alive_response) {
+	const canned_message message = not_found()(make_request());
+	const std::string text = text_of(message);
+	BOOST_TEST(text.starts_with("HTTP/1.1 404 Not Found\r\n"
+								"Server: webdonkey\r\n"
+								"Content-Type: text/plain\r\n"
+								"Date: "));
+
+	response parsed = parse(text);
+	BOOST_TEST(parsed.result() == beast::http::status::not_found);
+	BOOST_TEST(parsed.keep_alive());
+	BOOST_TEST(parsed[beast::http::field::date].size() == 29u);
+	BOOST_TEST(parsed[beast::http::field::date] != "stale");
+	BOOST_TEST(parsed[beast::http::field::content_length] == "9");
+	BOOST_TEST(parsed.count(beast::http::field::connection) == 0u);
+	BOOST_TEST(parsed.body() == "Not found");
+}
+
+BOOST_AUTO_TEST_CASE(connection_field) {
+	request closing = make_request();
+	closing.keep_alive(false);
+	response parsed = parse(text_of(not_found()(closing)));
+	BOOST_TEST(parsed[beast::http::field::connection] == "close");
+
+	request old = make_request(beast::http::verb::get, 10);
+	old.keep_alive(true);
+	parsed = parse(text_of(not_found()(old)));
+	BOOST_TEST(parsed[beast::http::field::connection] == "keep-alive");
+
+	parsed = parse(text_of(
+		not_found()(make_request(beast::http::verb::get, 10))));
+	BOOST_TEST(parsed[beast::http::field::connection] == "close");
+}
+
+BOOST_AUTO_TEST_CASE(head_response) {
+	const std::string text =
+		text_of(not_found()(make_request(beast::http::verb::head)));
+	BOOST_TEST(text.ends_with("\r\n\r\n"));
+
+	response parsed = parse(text, true);
+	BOOST_TEST(parsed[beast::http::field::content_length] == "9");
+	BOOST_TEST(parsed.body().empty());
+}
+
+BOOST_AUTO_TEST_CASE(per_response_fields) {
+	canned_fields fields;
+	fields.status = beast::http::status::moved_permanently;
+	fields.location = "https://example.com/";
+	fields.body = "Moved";
+	response parsed =
+		parse(text_of(not_found()(make_request(), std::move(fields))));
+	BOOST_TEST(parsed.result() == beast::http::status::moved_permanently);
+	BOOST_TEST(parsed.reason() == "Moved Permanently");
+	BOOST_TEST(parsed[beast::http::field::location] == "https://example.com/");
+	BOOST_TEST(parsed[beast::http::field::content_length] == "5");
+	BOOST_TEST(parsed.body() == "Moved");
+
+	// The canned response itself is unchanged
+	parsed = parse(text_of(not_found()(make_request())));
+	BOOST_TEST(parsed.result() == beast::http::status::not_found);
+	BOOST_TEST(parsed.count(beast::http::field::location) == 0u);
+	BOOST_TEST(parsed.body() == "Not found");
+}
+
+BOOST_AUTO_TEST_CASE(shared_content) {
+	auto owner = std::make_shared<const std::string>("cached content");
+	canned_fields fields;
+	fields.content = asio::buffer(*owner);
+	fields.content_owner = owner;
+	const canned_message message =
+		not_found()(make_request(), std::move(fields));
+
+	// Sent from the owner's memory, which the message keeps alive
+	std::array<asio::const_buffer, canned_message::max_buffers> buffers;
+	const std::size_t count = message.prepare(buffers);
+	BOOST_TEST(buffers[count - 1].data() == owner->data());
+	BOOST_TEST(owner.use_count() == 2);
+
+	response parsed = parse(text_of(message));
+	BOOST_TEST(parsed.body() == "cached content");
+}
+
+BOOST_AUTO_TEST_CASE(responses_without_content) {
+	canned_fields fields;
+	fields.status = beast::http::status::not_modified;
+	const std::string text =
+		text_of(not_found()(make_request(), std::move(fields)));
+	BOOST_TEST(text.starts_with("HTTP/1.1 304 Not Modified\r\n"));
+	BOOST_TEST(text.find("Content-Length") == std::string::npos);
+	BOOST_TEST(text.ends_with("\r\n\r\n"));
+}
+
+BOOST_AUTO_TEST_CASE(partial_writes) {
+	canned_message message = not_found()(make_request());
+	const std::string whole = text_of(message);
+	std::string written;
+	for (std::size_t step = 1; !message.is_done(); step = step * 2 + 1) {
+		const std::string rest = text_of(message);
+		BOOST_TEST(whole.ends_with(rest));
+
+		const std::size_t n = std::min(step, rest.size());
+		written.append(rest, 0, n);
+		message.consume(n);
+	}
+
+	BOOST_TEST(written == whole);
+	BOOST_TEST(text_of(message).empty());
+}
+
+BOOST_AUTO_TEST_CASE(empty_body) {
+	canned_response no_content{beast::http::response<beast::http::empty_body>{
+		beast::http::status::no_content, 11}};
+	BOOST_TEST(no_content.status() == beast::http::status::no_content);
+
+	const std::string text = text_of(no_content(make_request()));
+	BOOST_TEST(text.starts_with("HTTP/1.1 204 No Content\r\nDate: "));
+	BOOST_TEST(text.find("Content-Length") == std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
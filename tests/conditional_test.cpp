@@ -0,0 +1,137 @@
+/*
+ * conditional_test.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <webdonkey/conditional.hpp>
+
+using namespace webdonkey;
+
+namespace {
+
+using range_list = std::vector<std::pair<std::uint64_t, std::uint64_t>>;
+
+// Ranges as pairs, which Boost.Test can print
+std::optional<range_list> ranges(std::string_view value, std::uint64_t size) {
+	std::optional<std::vector<byte_range>> parsed = parse_ranges(value, size);
+	if (!parsed)
+		return std::nullopt;
+
+	range_list result;
+	for (const byte_range &range : parsed.value())
+		result.emplace_back(range.first, range.last);
+
+	return result;
+}
+
+beast::http::fields request_with(beast::http::field name,
+								 std::string_view value) {
+	beast::http::fields fields;
+	fields.set(name, value);
+	return fields;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(conditional_tests)
+
+BOOST_AUTO_TEST_CASE(single_ranges) {
+	BOOST_TEST(ranges("bytes=0-99", 1000).value() == (range_list{{0, 99}}));
+	BOOST_TEST(ranges("bytes=100-", 1000).value() == (range_list{{100, 999}}));
+	BOOST_TEST(ranges("bytes=-100", 1000).value() == (range_list{{900, 999}}));
+
+	// Units are case-insensitive
+	BOOST_TEST(ranges("Bytes=0-0", 10).value() == (range_list{{0, 0}}));
+}
+
+BOOST_AUTO_TEST_CASE(ranges_are_clamped) {
+	BOOST_TEST(ranges("bytes=990-2000", 1000).value() ==
+			   (range_list{{990, 999}}));
+	BOOST_TEST(ranges("bytes=-5000", 1000).value() == (range_list{{0, 999}}));
+}
+
+BOOST_AUTO_TEST_CASE(multiple_ranges) {
+	BOOST_TEST(ranges("bytes=0-9, 20-29,\t-5", 100).value() ==
+			   (range_list{{0, 9}, {20, 29}, {95, 99}}));
+
+	// Empty list elements are allowed
+	BOOST_TEST(ranges("bytes=,0-9,,", 100).value() == (range_list{{0, 9}}));
+}
+
+BOOST_AUTO_TEST_CASE(unsatisfiable_ranges) {
+	BOOST_TEST(ranges("bytes=1000-", 1000).value().empty());
+	BOOST_TEST(ranges("bytes=-0", 1000).value().empty());
+	BOOST_TEST(ranges("bytes=0-", 0).value().empty());
+
+	// Unsatisfiable ranges are dropped from a list
+	BOOST_TEST(ranges("bytes=5000-6000,0-0", 1000).value() ==
+			   (range_list{{0, 0}}));
+}
+
+BOOST_AUTO_TEST_CASE(malformed_ranges) {
+	for (std::string_view value :
+		 {"", "bytes", "bytes=", "bytes=,", "bytes= , ", "items=0-1",
+		  "bytes=1", "bytes=a-b", "bytes=5-1", "bytes=1-2x", "bytes=--1",
+		  "bytes=0-1,2", "bytes=-"})
+		BOOST_TEST(!ranges(value, 1000).has_value(), "\"" << value << "\"");
+}
+
+BOOST_AUTO_TEST_CASE(if_none_match) {
+	const std::string_view etag = "\"abc\"";
+	BOOST_TEST(etag_matches("\"abc\"", etag));
+	BOOST_TEST(etag_matches("\"x\", \"abc\"", etag));
+	BOOST_TEST(etag_matches("*", etag));
+
+	// Comparison is weak
+	BOOST_TEST(etag_matches("W/\"abc\"", etag));
+	BOOST_TEST(etag_matches("\"abc\"", "W/\"abc\""));
+
+	BOOST_TEST(!etag_matches("\"abcd\"", etag));
+	BOOST_TEST(!etag_matches("", etag));
+	BOOST_TEST(!etag_matches(" , ", etag));
+}
+
+BOOST_AUTO_TEST_CASE(not_modified_precedence) {
+	const std::time_t modified = 1700000000;
+	const std::string date = http_date(modified);
+	BOOST_TEST(parse_http_date(date).value() == modified);
+
+	BOOST_TEST(not_modified(
+		request_with(beast::http::field::if_modified_since, date), "\"a\"",
+		modified));
+	BOOST_TEST(!not_modified(
+		request_with(beast::http::field::if_modified_since, date), "\"a\"",
+		modified + 1));
+
+	// If-None-Match takes precedence over If-Modified-Since
+	beast::http::fields both =
+		request_with(beast::http::field::if_modified_since, date);
+	both.set(beast::http::field::if_none_match, "\"b\"");
+	BOOST_TEST(!not_modified(both, "\"a\"", modified));
+
+	BOOST_TEST(!not_modified(beast::http::fields{}, "\"a\"", modified));
+}
+
+BOOST_AUTO_TEST_CASE(if_range) {
+	const std::time_t modified = 1700000000;
+	BOOST_TEST(range_applies(beast::http::fields{}, "\"a\"", modified));
+	BOOST_TEST(range_applies(
+		request_with(beast::http::field::if_range, "\"a\""), "\"a\"",
+		modified));
+
+	// Entity tags are compared strongly
+	BOOST_TEST(!range_applies(
+		request_with(beast::http::field::if_range, "\"a\""), "W/\"a\"",
+		modified));
+	BOOST_TEST(!range_applies(
+		request_with(beast::http::field::if_range, http_date(modified - 1)),
+		"\"a\"", modified));
+	BOOST_TEST(range_applies(
+		request_with(beast::http::field::if_range, http_date(modified)),
+		"\"a\"", modified));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
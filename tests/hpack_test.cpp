@@ -0,0 +1,243 @@
+/*
+ * hpack_test.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ *
+ * Decoding follows the examples of RFC 7541, appendix C.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+#include <webdonkey/hpack.hpp>
+
+using namespace webdonkey;
+
+namespace {
+
+using field_list = std::vector<std::pair<std::string, std::string>>;
+
+std::string from_hex(std::string_view hex) {
+	std::string bytes;
+	for (std::size_t i = 0; i + 1 < hex.size(); i += 2)
+		bytes.push_back(static_cast<char>(
+			std::stoi(std::string{hex.substr(i, 2)}, nullptr, 16)));
+
+	return bytes;
+}
+
+std::optional<field_list> decode(hpack_decoder &decoder,
+								 std::string_view block) {
+	field_list fields;
+	if (!decoder.decode(block, [&](std::string_view name,
+								   std::string_view value) {
+			fields.emplace_back(name, value);
+		}))
+		return std::nullopt;
+
+	return fields;
+}
+
+std::optional<field_list> decode_hex(hpack_decoder &decoder,
+									 std::string_view hex) {
+	return decode(decoder, from_hex(hex));
+}
+
+const field_list first_request = {{":method", "GET"},
+								  {":scheme", "http"},
+								  {":path", "/"},
+								  {":authority", "www.example.com"}};
+
+const field_list second_request = {{":method", "GET"},
+								   {":scheme", "http"},
+								   {":path", "/"},
+								   {":authority", "www.example.com"},
+								   {"cache-control", "no-cache"}};
+
+const field_list third_request = {{":method", "GET"},
+								  {":scheme", "https"},
+								  {":path", "/index.html"},
+								  {":authority", "www.example.com"},
+								  {"custom-key", "custom-value"}};
+
+const field_list first_response = {
+	{":status", "302"},
+	{"cache-control", "private"},
+	{"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+	{"location", "https://www.example.com"}};
+
+const field_list second_response = {
+	{":status", "307"},
+	{"cache-control", "private"},
+	{"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+	{"location", "https://www.example.com"}};
+
+const field_list third_response = {
+	{":status", "200"},
+	{"cache-control", "private"},
+	{"date", "Mon, 21 Oct 2013 20:13:22 GMT"},
+	{"location", "https://www.example.com"},
+	{"content-encoding", "gzip"},
+	{"set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1"}};
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(hpack_tests)
+
+// RFC 7541, C.2
+BOOST_AUTO_TEST_CASE(literal_representations) {
+	hpack_decoder decoder;
+	BOOST_TEST(decode_hex(decoder, "400a637573746f6d2d6b65790d637573746f6d2d"
+								   "686561646572")
+				   .value() == (field_list{{"custom-key", "custom-header"}}));
+	BOOST_TEST(decode_hex(decoder, "040c2f73616d706c652f70617468").value() ==
+			   (field_list{{":path", "/sample/path"}}));
+	BOOST_TEST(decode_hex(decoder, "100870617373776f726406736563726574")
+				   .value() == (field_list{{"password", "secret"}}));
+
+	// Only the first field was indexed
+	BOOST_TEST(decode_hex(decoder, "be").value() ==
+			   (field_list{{"custom-key", "custom-header"}}));
+	BOOST_TEST(!decode_hex(decoder, "bf").has_value());
+}
+
+// RFC 7541, C.3
+BOOST_AUTO_TEST_CASE(requests) {
+	hpack_decoder decoder;
+	BOOST_TEST(decode_hex(decoder, "828684410f7777772e6578616d706c652e636f6d")
+				   .value() == first_request);
+	BOOST_TEST(decode_hex(decoder, "828684be58086e6f2d6361636865").value() ==
+			   second_request);
+	BOOST_TEST(decode_hex(decoder, "828785bf400a637573746f6d2d6b65790c637573"
+								   "746f6d2d76616c7565")
+				   .value() == third_request);
+}
+
+// RFC 7541, C.4
+BOOST_AUTO_TEST_CASE(huffman_requests) {
+	hpack_decoder decoder;
+	BOOST_TEST(decode_hex(decoder, "828684418cf1e3c2e5f23a6ba0ab90f4ff")
+				   .value() == first_request);
+	BOOST_TEST(decode_hex(decoder, "828684be5886a8eb10649cbf").value() ==
+			   second_request);
+	BOOST_TEST(decode_hex(decoder, "828785bf408825a849e95ba97d7f8925a849e95b"
+								   "b8e8b4bf")
+				   .value() == third_request);
+}
+
+// RFC 7541, C.5; the dynamic table holds 256 bytes, so entries are evicted
+BOOST_AUTO_TEST_CASE(responses_with_eviction) {
+	hpack_decoder decoder{256};
+	BOOST_TEST(decode_hex(decoder,
+						  "4803333032580770726976617465611d4d6f6e2c203231204f"
+						  "637420323031332032303a31333a323120474d546e17687474"
+						  "70733a2f2f7777772e6578616d706c652e636f6d")
+				   .value() == first_response);
+	BOOST_TEST(decode_hex(decoder, "4803333037c1c0bf").value() ==
+			   second_response);
+	BOOST_TEST(decode_hex(decoder,
+						  "88c1611d4d6f6e2c203231204f637420323031332032303a31"
+						  "333a323220474d54c05a04677a69707738666f6f3d4153444a"
+						  "4b48514b425a584f5157454f50495541585157454f49553b20"
+						  "6d61782d6167653d333630303b2076657273696f6e3d31")
+				   .value() == third_response);
+
+	// Only the three entries added last fit
+	BOOST_TEST(decode_hex(decoder, "bebfc0").value() ==
+			   (field_list{third_response[5], third_response[4],
+						   third_response[2]}));
+	BOOST_TEST(!decode_hex(decoder, "c1").has_value());
+}
+
+// RFC 7541, C.6
+BOOST_AUTO_TEST_CASE(huffman_responses_with_eviction) {
+	hpack_decoder decoder{256};
+	BOOST_TEST(decode_hex(decoder,
+						  "488264025885aec3771a4b6196d07abe941054d444a8200595"
+						  "040b8166e082a62d1bff6e919d29ad171863c78f0b97c8e9ae"
+						  "82ae43d3")
+				   .value() == first_response);
+	BOOST_TEST(decode_hex(decoder, "4883640effc1c0bf").value() ==
+			   second_response);
+	BOOST_TEST(decode_hex(decoder,
+						  "88c16196d07abe941054d444a8200595040b8166e084a62d1b"
+						  "ffc05a839bd9ab77ad94e7821dd7f2e6c7b335dfdfcd5b3960"
+						  "d5af27087f3672c1ab270fb5291f9587316065c003ed4ee5b1"
+						  "063d5007")
+				   .value() == third_response);
+}
+
+BOOST_AUTO_TEST_CASE(table_size_updates) {
+	hpack_decoder decoder;
+	BOOST_TEST(decode_hex(decoder, "400a637573746f6d2d6b65790d637573746f6d2d"
+								   "686561646572")
+				   .has_value());
+
+	// Shrinking the table to zero empties it
+	BOOST_TEST(decode_hex(decoder, "2082").value() ==
+			   (field_list{{":method", "GET"}}));
+	BOOST_TEST(!decode_hex(decoder, "be").has_value());
+
+	// Nothing is indexed while the table holds zero bytes
+	BOOST_TEST(decode_hex(decoder, "400a637573746f6d2d6b65790d637573746f6d2d"
+								   "686561646572")
+				   .has_value());
+	BOOST_TEST(!decode_hex(decoder, "be").has_value());
+
+	// Up to the announced limit, 4096 bytes, in two updates
+	BOOST_TEST(decode_hex(decoder, "203fe11f").value().empty());
+	BOOST_TEST(decode_hex(decoder, "400a637573746f6d2d6b65790d637573746f6d2d"
+								   "686561646572")
+				   .has_value());
+	BOOST_TEST(decode_hex(decoder, "be").value() ==
+			   (field_list{{"custom-key", "custom-header"}}));
+
+	// Above the limit
+	BOOST_TEST(!decode_hex(decoder, "3fe21f").has_value());
+}
+
+BOOST_AUTO_TEST_CASE(table_size_update_after_field) {
+	hpack_decoder decoder;
+	BOOST_TEST(!decode_hex(decoder, "8220").has_value());
+}
+
+BOOST_AUTO_TEST_CASE(malformed_blocks) {
+	const std::pair<std::string_view, std::string_view> blocks[] = {
+		{"80", "index 0"},
+		{"ff00", "index beyond the tables"},
+		{"ff", "truncated integer"},
+		{"ffffffffffff7f", "integer overflow"},
+		{"4005", "name shorter than its length"},
+		{"400161", "value missing"},
+		{"0081ff", "Huffman padding longer than 7 bits"},
+		{"008100", "Huffman padding not of ones"},
+		{"0083ffffff", "EOS symbol"}};
+
+	for (auto [hex, problem] : blocks) {
+		hpack_decoder decoder;
+		BOOST_TEST(!decode_hex(decoder, hex).has_value(), problem);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(encoder_round_trip) {
+	std::string block;
+	hpack_encoder::status(block, 200);
+	hpack_encoder::status(block, 418);
+	hpack_encoder::field(block, "Content-Type", "text/html");
+	hpack_encoder::field(block, "X-Custom", "a value");
+	hpack_encoder::field(block, "Content-Length", "");
+
+	hpack_decoder decoder;
+	BOOST_TEST(decode(decoder, block).value() ==
+			   (field_list{{":status", "200"},
+						   {":status", "418"},
+						   {"content-type", "text/html"},
+						   {"x-custom", "a value"},
+						   {"content-length", ""}}));
+
+	// The encoder never adds to the peer's dynamic table
+	BOOST_TEST(!decode_hex(decoder, "be").has_value());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,546 @@
+/*
+ * http2_test.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ *
+ * http2_session does no I/O of its own, so frames are fed to it and its
+ * output is parsed back here.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+#include <webdonkey/http2.hpp>
+
+using namespace webdonkey;
+namespace h2 = webdonkey::http2_internals;
+
+namespace {
+
+struct frame {
+	std::uint8_t type;
+	std::uint8_t flags;
+	std::uint32_t stream;
+	std::string payload;
+};
+
+std::string encode(std::uint8_t type, std::uint8_t flags, std::uint32_t stream,
+				   std::string_view payload = {}) {
+	std::string bytes(h2::frame_header_size, '\0');
+	auto p = reinterpret_cast<unsigned char *>(bytes.data());
+	p[0] = static_cast<unsigned char>(payload.size() >> 16);
+	p[1] = static_cast<unsigned char>(payload.size() >> 8);
+	p[2] = static_cast<unsigned char>(payload.size());
+	p[3] = type;
+	p[4] = flags;
+	h2::put_u32(p + 5, stream);
+	bytes.append(payload);
+	return bytes;
+}
+
+std::string u32(std::uint32_t value) {
+	std::string bytes(4, '\0');
+	h2::put_u32(reinterpret_cast<unsigned char *>(bytes.data()), value);
+	return bytes;
+}
+
+std::string setting(std::uint16_t id, std::uint32_t value) {
+	return std::string{static_cast<char>(id >> 8), static_cast<char>(id)} +
+		   u32(value);
+}
+
+// A GET of path, with HPACK literals only
+std::string request_block(std::string_view method, std::string_view path,
+						  std::string_view extra_name = {},
+						  std::string_view extra_value = {}) {
+	std::string block;
+	hpack_encoder::field(block, ":method", method);
+	hpack_encoder::field(block, ":scheme", "https");
+	hpack_encoder::field(block, ":authority", "example.com");
+	hpack_encoder::field(block, ":path", path);
+	if (!extra_name.empty())
+		hpack_encoder::field(block, extra_name, extra_value);
+
+	return block;
+}
+
+struct session_fixture {
+	asio::io_context io;
+	http2_options options;
+	std::unique_ptr<http2_session> session;
+
+	session_fixture() { options.max_control_replies = 10; }
+
+	// Starts the session and completes the client's preface
+	void open(std::string_view settings = {}) {
+		session = std::make_unique<http2_session>(io.get_executor(), options);
+		session->start();
+		output();
+		send(std::string{http2_preface} + encode(h2::settings, 0, 0, settings));
+	}
+
+	std::size_t send(const std::string &bytes) {
+		return session->receive(asio::buffer(bytes));
+	}
+
+	std::vector<frame> output() {
+		beast::flat_buffer buffer;
+		session->take_output(buffer);
+		std::string bytes = beast::buffers_to_string(buffer.data());
+
+		std::vector<frame> frames;
+		auto p = reinterpret_cast<const unsigned char *>(bytes.data());
+		for (std::size_t pos = 0; pos < bytes.size();) {
+			const std::size_t length =
+				(std::size_t{p[pos]} << 16) | (std::size_t{p[pos + 1]} << 8) |
+				p[pos + 2];
+			frames.push_back(
+				frame{p[pos + 3], p[pos + 4], h2::read_u32(p + pos + 5),
+					  bytes.substr(pos + h2::frame_header_size, length)});
+			pos += h2::frame_header_size + length;
+		}
+
+		return frames;
+	}
+
+	// The error code of the GOAWAY sent, or -1
+	std::int64_t goaway_code() {
+		for (const frame &sent : output())
+			if (sent.type == h2::goaway)
+				return h2::read_u32(reinterpret_cast<const unsigned char *>(
+					sent.payload.data() + 4));
+
+		return -1;
+	}
+
+	std::string read_request(http2_session::stream_ptr &stream) {
+		std::string text;
+		char chunk[256];
+		beast::error_code ec;
+		std::size_t transferred = 0;
+		while (stream->read(asio::buffer(chunk), ec, transferred) && !ec &&
+			   (transferred > 0))
+			text.append(chunk, transferred);
+
+		return text;
+	}
+
+	void respond(http2_session::stream_ptr &stream, std::string_view text) {
+		beast::error_code ec;
+		std::size_t transferred = 0;
+		while (!text.empty() &&
+			   stream->write(asio::buffer(text), ec, transferred) && !ec)
+			text.remove_prefix(transferred);
+	}
+};
+
+std::uint32_t error_of(const frame &reset) {
+	return h2::read_u32(
+		reinterpret_cast<const unsigned char *>(reset.payload.data()));
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(http2_tests, session_fixture)
+
+BOOST_AUTO_TEST_CASE(server_preface) {
+	options.connection_window = 1024 * 1024;
+	session = std::make_unique<http2_session>(io.get_executor(), options);
+	session->start();
+	std::vector<frame> frames = output();
+	BOOST_TEST_REQUIRE(frames.size() == 2u);
+	BOOST_TEST(frames[0].type == h2::settings);
+	BOOST_TEST(frames[0].payload ==
+			   setting(h2::max_concurrent_streams,
+					   options.max_concurrent_streams) +
+				   setting(h2::initial_window_size, options.stream_window) +
+				   setting(h2::max_header_list_size,
+						   options.max_header_list_size));
+	BOOST_TEST(frames[1].type == h2::window_update);
+	BOOST_TEST(frames[1].payload ==
+			   u32(options.connection_window - h2::default_window));
+}
+
+BOOST_AUTO_TEST_CASE(client_preface) {
+	open();
+	std::vector<frame> frames = output();
+	BOOST_TEST_REQUIRE(frames.size() == 1u);
+	BOOST_TEST(frames[0].type == h2::settings);
+	BOOST_TEST(frames[0].flags == h2::ack);
+}
+
+BOOST_AUTO_TEST_CASE(bad_preface) {
+	session = std::make_unique<http2_session>(io.get_executor(), options);
+	send("GET / HTTP/1.1\r\n\r\n");
+	BOOST_TEST(goaway_code() == h2::protocol_error);
+	BOOST_TEST(session->closing());
+}
+
+BOOST_AUTO_TEST_CASE(preface_without_settings) {
+	session = std::make_unique<http2_session>(io.get_executor(), options);
+	send(std::string{http2_preface} +
+		 encode(h2::ping, 0, 0, std::string(8, 'p')));
+	BOOST_TEST(goaway_code() == h2::protocol_error);
+}
+
+BOOST_AUTO_TEST_CASE(partial_frames) {
+	open();
+	output();
+	const std::string ping = encode(h2::ping, 0, 0, "12345678");
+	BOOST_TEST(send(ping.substr(0, 5)) == 0u);
+	BOOST_TEST(send(ping.substr(0, 12)) == 0u);
+	BOOST_TEST(send(ping + ping.substr(0, 3)) == ping.size());
+	BOOST_TEST(output().size() == 1u);
+}
+
+BOOST_AUTO_TEST_CASE(ping) {
+	open();
+	output();
+	send(encode(h2::ping, 0, 0, "12345678"));
+	std::vector<frame> frames = output();
+	BOOST_TEST_REQUIRE(frames.size() == 1u);
+	BOOST_TEST(frames[0].type == h2::ping);
+	BOOST_TEST(frames[0].flags == h2::ack);
+	BOOST_TEST(frames[0].payload == "12345678");
+
+	// Acknowledgements are not acknowledged
+	send(encode(h2::ping, h2::ack, 0, "12345678"));
+	BOOST_TEST(output().empty());
+
+	send(encode(h2::ping, 0, 0, "1234567"));
+	BOOST_TEST(goaway_code() == h2::frame_size_error);
+}
+
+BOOST_AUTO_TEST_CASE(frame_too_large) {
+	open();
+	output();
+	send(encode(h2::data, 0, 1, std::string(h2::default_frame_size + 1, 'x')));
+	BOOST_TEST(goaway_code() == h2::frame_size_error);
+}
+
+BOOST_AUTO_TEST_CASE(unknown_frames_are_ignored) {
+	open();
+	output();
+	send(encode(0xfa, 0, 0, "anything"));
+	BOOST_TEST(output().empty());
+	BOOST_TEST(!session->closing());
+}
+
+BOOST_AUTO_TEST_CASE(get_request) {
+	open();
+	output();
+	send(encode(h2::headers, h2::end_headers | h2::end_stream, 1,
+				request_block("GET", "/index.html", "Accept", "*/*")));
+	http2_session::stream_ptr stream = session->accept();
+	BOOST_TEST_REQUIRE(stream != nullptr);
+	BOOST_TEST(stream->id() == 1u);
+	BOOST_TEST(stream->request_done());
+	BOOST_TEST(read_request(stream) == "GET /index.html HTTP/1.1\r\n"
+									   "host: example.com\r\n"
+									   "accept: */*\r\n"
+									   "connection: close\r\n\r\n");
+	BOOST_TEST(session->accept() == nullptr);
+
+	respond(stream, "HTTP/1.1 200 OK\r\n"
+					"Content-Type: text/plain\r\n"
+					"Connection: close\r\n"
+					"Content-Length: 5\r\n\r\n"
+					"hello");
+	std::vector<frame> frames = output();
+	BOOST_TEST_REQUIRE(frames.size() == 2u);
+	BOOST_TEST(frames[0].type == h2::headers);
+	BOOST_TEST(frames[0].flags == h2::end_headers);
+	BOOST_TEST(frames[0].stream == 1u);
+
+	std::vector<std::string> fields;
+	hpack_decoder decoder;
+	BOOST_TEST(decoder.decode(frames[0].payload, [&](std::string_view name,
+													 std::string_view value) {
+		fields.push_back(std::string{name} + ": " + std::string{value});
+	}));
+
+	// Connection-specific fields are dropped
+	BOOST_TEST(fields == (std::vector<std::string>{":status: 200",
+												   "content-type: text/plain",
+												   "content-length: 5"}),
+			   boost::test_tools::per_element());
+
+	BOOST_TEST(frames[1].type == h2::data);
+	BOOST_TEST(frames[1].flags == h2::end_stream);
+	BOOST_TEST(frames[1].payload == "hello");
+	BOOST_TEST(stream->response_done());
+}
+
+BOOST_AUTO_TEST_CASE(request_body) {
+	open();
+	output();
+	send(encode(h2::headers, h2::end_headers, 1,
+				request_block("POST", "/upload", "content-length", "6")));
+	http2_session::stream_ptr stream = session->accept();
+	BOOST_TEST_REQUIRE(stream != nullptr);
+
+	// Padded: a pad length of 2, then two bytes of padding
+	send(encode(h2::data, h2::padded, 1, std::string{"\x02" "abc", 4} + "pp"));
+	send(encode(h2::data, h2::end_stream, 1, "def"));
+	BOOST_TEST(stream->request_done());
+	BOOST_TEST(read_request(stream) == "POST /upload HTTP/1.1\r\n"
+									   "host: example.com\r\n"
+									   "content-length: 6\r\n"
+									   "connection: close\r\n\r\n"
+									   "abcdef");
+}
+
+BOOST_AUTO_TEST_CASE(chunked_request_body) {
+	open();
+	output();
+	send(encode(h2::headers, h2::end_headers, 1, request_block("PUT", "/f")));
+	http2_session::stream_ptr stream = session->accept();
+	BOOST_TEST_REQUIRE(stream != nullptr);
+	send(encode(h2::data, h2::end_stream, 1, "0123456789abcdef0"));
+	BOOST_TEST(read_request(stream) == "PUT /f HTTP/1.1\r\n"
+									   "host: example.com\r\n"
+									   "transfer-encoding: chunked\r\n"
+									   "connection: close\r\n\r\n"
+									   "11\r\n0123456789abcdef0\r\n0\r\n\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(content_length_mismatch) {
+	open();
+	output();
+	send(encode(h2::headers, h2::end_headers, 1,
+				request_block("POST", "/", "content-length", "2")));
+	http2_session::stream_ptr stream = session->accept();
+	BOOST_TEST_REQUIRE(stream != nullptr);
+	send(encode(h2::data, h2::end_stream, 1, "abc"));
+	BOOST_TEST(stream->reset());
+
+	std::vector<frame> frames = output();
+	BOOST_TEST_REQUIRE(frames.size() == 1u);
+	BOOST_TEST(frames[0].type == h2::rst_stream);
+	BOOST_TEST(error_of(frames[0]) == h2::protocol_error);
+}
+
+BOOST_AUTO_TEST_CASE(malformed_requests) {
+	open();
+	output();
+
+	// No :path
+	std::string block;
+	hpack_encoder::field(block, ":method", "GET");
+	hpack_encoder::field(block, ":scheme", "https");
+	send(encode(h2::headers, h2::end_headers | h2::end_stream, 1, block));
+
+	// Connection-specific field
+	send(encode(h2::headers, h2::end_headers | h2::end_stream, 3,
+				request_block("GET", "/", "connection", "keep-alive")));
+	BOOST_TEST(session->accept() == nullptr);
+
+	std::vector<frame> frames = output();
+	BOOST_TEST_REQUIRE(frames.size() == 2u);
+	for (const frame &reset : frames) {
+		BOOST_TEST(reset.type == h2::rst_stream);
+		BOOST_TEST(error_of(reset) == h2::protocol_error);
+	}
+
+	// Stream ids must increase
+	send(encode(h2::headers, h2::end_headers | h2::end_stream, 3,
+				request_block("GET", "/")));
+	BOOST_TEST(goaway_code() == h2::protocol_error);
+}
+
+BOOST_AUTO_TEST_CASE(compression_error) {
+	open();
+	output();
+	send(encode(h2::headers, h2::end_headers | h2::end_stream, 1, "\x80"));
+	BOOST_TEST(goaway_code() == h2::compression_error);
+}
+
+BOOST_AUTO_TEST_CASE(continuation) {
+	open();
+	output();
+	const std::string block = request_block("GET", "/split");
+	send(encode(h2::headers, h2::end_stream, 1, block.substr(0, 10)));
+	send(encode(h2::continuation, 0, 1, block.substr(10, 5)));
+	BOOST_TEST(session->accept() == nullptr);
+	send(encode(h2::continuation, h2::end_headers, 1, block.substr(15)));
+	BOOST_TEST(session->accept() != nullptr);
+
+	// Nothing may come between HEADERS and CONTINUATION
+	send(encode(h2::headers, h2::end_stream, 3, block.substr(0, 10)));
+	send(encode(h2::ping, 0, 0, "12345678"));
+	BOOST_TEST(goaway_code() == h2::protocol_error);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_streams) {
+	options.max_concurrent_streams = 1;
+	open();
+	output();
+	send(encode(h2::headers, h2::end_headers | h2::end_stream, 1,
+				request_block("GET", "/a")));
+	send(encode(h2::headers, h2::end_headers | h2::end_stream, 3,
+				request_block("GET", "/b")));
+	BOOST_TEST(session->accept() != nullptr);
+	BOOST_TEST(session->accept() == nullptr);
+
+	std::vector<frame> frames = output();
+	BOOST_TEST_REQUIRE(frames.size() == 1u);
+	BOOST_TEST(frames[0].type == h2::rst_stream);
+	BOOST_TEST(frames[0].stream == 3u);
+	BOOST_TEST(error_of(frames[0]) == h2::refused_stream);
+}
+
+BOOST_AUTO_TEST_CASE(send_flow_control) {
+	// The client's stream windows start at 10 bytes
+	open(setting(h2::initial_window_size, 10));
+	output();
+	send(encode(h2::headers, h2::end_headers | h2::end_stream, 1,
+				request_block("GET", "/")));
+	http2_session::stream_ptr stream = session->accept();
+	BOOST_TEST_REQUIRE(stream != nullptr);
+
+	respond(stream, "HTTP/1.1 200 OK\r\nContent-Length: 25\r\n\r\n"
+					"0123456789abcdefghijklmno");
+	std::vector<frame> frames = output();
+	BOOST_TEST_REQUIRE(frames.size() == 2u);
+	BOOST_TEST(frames[1].type == h2::data);
+	BOOST_TEST(frames[1].payload == "0123456789");
+	BOOST_TEST(frames[1].flags == 0);
+
+	// Stream credit
+	send(encode(h2::window_update, 0, 1, u32(10)));
+	stream->drain();
+	frames = output();
+	BOOST_TEST_REQUIRE(frames.size() == 1u);
+	BOOST_TEST(frames[0].payload == "abcdefghij");
+
+	// A larger initial window applies to open streams too
+	send(encode(h2::settings, 0, 0, setting(h2::initial_window_size, 15)));
+	stream->drain();
+	frames = output();
+	BOOST_TEST_REQUIRE(frames.size() == 2u);
+	BOOST_TEST(frames[0].type == h2::settings);
+	BOOST_TEST(frames[1].payload == "klmno");
+	BOOST_TEST(frames[1].flags == h2::end_stream);
+	BOOST_TEST(stream->response_done());
+}
+
+BOOST_AUTO_TEST_CASE(connection_send_window) {
+	open(setting(h2::initial_window_size, 100000));
+	output();
+	send(encode(h2::headers, h2::end_headers | h2::end_stream, 1,
+				request_block("GET", "/")));
+	http2_session::stream_ptr stream = session->accept();
+	BOOST_TEST_REQUIRE(stream != nullptr);
+
+	// The connection window is the default 65535 bytes
+	const std::string body(70000, 'x');
+	respond(stream, "HTTP/1.1 200 OK\r\nContent-Length: 70000\r\n\r\n" + body);
+	std::size_t sent = 0;
+	for (const frame &data : output())
+		if (data.type == h2::data)
+			sent += data.payload.size();
+	BOOST_TEST(sent == h2::default_window);
+
+	send(encode(h2::window_update, 0, 0, u32(10000)));
+	stream->drain();
+	sent = 0;
+	for (const frame &data : output())
+		if (data.type == h2::data)
+			sent += data.payload.size();
+	BOOST_TEST(sent == 70000 - h2::default_window);
+	BOOST_TEST(stream->response_done());
+}
+
+BOOST_AUTO_TEST_CASE(window_update_errors) {
+	open();
+	output();
+	send(encode(h2::headers, h2::end_headers | h2::end_stream, 1,
+				request_block("GET", "/")));
+	BOOST_TEST_REQUIRE(session->accept() != nullptr);
+
+	send(encode(h2::window_update, 0, 1, u32(0)));
+	std::vector<frame> frames = output();
+	BOOST_TEST_REQUIRE(frames.size() == 1u);
+	BOOST_TEST(frames[0].type == h2::rst_stream);
+	BOOST_TEST(error_of(frames[0]) == h2::protocol_error);
+
+	send(encode(h2::window_update, 0, 0, u32(0x7fffffff)));
+	BOOST_TEST(goaway_code() == h2::flow_control_error);
+}
+
+BOOST_AUTO_TEST_CASE(receive_flow_control) {
+	options.stream_window = 16;
+	options.connection_window = 100;
+	open();
+	output();
+	send(encode(h2::headers, h2::end_headers, 1, request_block("POST", "/")));
+	http2_session::stream_ptr stream = session->accept();
+	BOOST_TEST_REQUIRE(stream != nullptr);
+
+	// Reading half the stream window returns it to the client
+	send(encode(h2::data, 0, 1, std::string(8, 'a')));
+	read_request(stream);
+	std::vector<frame> frames = output();
+	BOOST_TEST_REQUIRE(frames.size() == 1u);
+	BOOST_TEST(frames[0].type == h2::window_update);
+	BOOST_TEST(frames[0].stream == 1u);
+	BOOST_TEST(frames[0].payload == u32(8));
+
+	// More than the stream window
+	send(encode(h2::data, 0, 1, std::string(17, 'b')));
+	frames = output();
+	BOOST_TEST_REQUIRE(frames.size() == 1u);
+	BOOST_TEST(frames[0].type == h2::rst_stream);
+	BOOST_TEST(error_of(frames[0]) == h2::flow_control_error);
+	BOOST_TEST(stream->reset());
+
+	// More than the connection window
+	send(encode(h2::headers, h2::end_headers, 3, request_block("POST", "/")));
+	send(encode(h2::data, 0, 3, std::string(100, 'c')));
+	BOOST_TEST(goaway_code() == h2::flow_control_error);
+}
+
+BOOST_AUTO_TEST_CASE(reset_by_client) {
+	open();
+	output();
+	send(encode(h2::headers, h2::end_headers, 1, request_block("POST", "/")));
+	http2_session::stream_ptr stream = session->accept();
+	BOOST_TEST_REQUIRE(stream != nullptr);
+	send(encode(h2::rst_stream, 0, 1, u32(h2::cancel)));
+	BOOST_TEST(stream->reset());
+	BOOST_TEST(output().empty());
+
+	// The request header arrived before the reset and is still read
+	BOOST_TEST(read_request(stream).starts_with("POST / HTTP/1.1\r\n"));
+	beast::error_code ec;
+	std::size_t transferred = 0;
+	char chunk[16];
+	BOOST_TEST(stream->read(asio::buffer(chunk), ec, transferred));
+	BOOST_TEST(ec == asio::error::connection_reset);
+}
+
+BOOST_AUTO_TEST_CASE(control_frame_flood) {
+	options.max_control_replies = 3;
+
+	// The client's SETTINGS take the first reply
+	open();
+	BOOST_TEST(output().size() == 1u);
+	for (int i = 0; i < 3; ++i)
+		send(encode(h2::ping, 0, 0, "12345678"));
+
+	std::vector<frame> frames = output();
+	BOOST_TEST_REQUIRE(frames.size() == 3u);
+	BOOST_TEST(frames[0].type == h2::ping);
+	BOOST_TEST(frames[1].type == h2::ping);
+	BOOST_TEST(frames[2].type == h2::goaway);
+	BOOST_TEST(h2::read_u32(reinterpret_cast<const unsigned char *>(
+				   frames[2].payload.data() + 4)) == h2::enhance_your_calm);
+
+	// Nothing more is processed
+	BOOST_TEST(session->closing());
+	send(encode(h2::ping, 0, 0, "12345678"));
+	BOOST_TEST(output().empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
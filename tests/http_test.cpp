@@ -0,0 +1,127 @@
+/*
+ * http_test.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/test/unit_test.hpp>
+#include <random>
+#include <string>
+#include <thread>
+#include <webdonkey/http.hpp>
+
+using namespace webdonkey;
+
+namespace {
+
+/**
+ * Sends a POST of body over loopback and spools it with options.
+ */
+spooled_body spool(const std::string &body, const spool_options &options) {
+	asio::io_context io;
+	tcp::acceptor acceptor{io,
+						   tcp::endpoint{asio::ip::address_v4::loopback(), 0}};
+	tcp::socket client{io};
+	client.connect(acceptor.local_endpoint());
+	tcp_stream server{acceptor.accept()};
+
+	std::thread sender{[&] {
+		const std::string header = "POST /upload HTTP/1.1\r\n"
+								   "Host: localhost\r\n"
+								   "Content-Length: " +
+								   std::to_string(body.size()) + "\r\n\r\n";
+		asio::write(client, asio::buffer(header));
+		asio::write(client, asio::buffer(body));
+	}};
+
+	spooled_body spooled;
+	std::exception_ptr failure;
+	std::thread::id resumed_on;
+	request_context<tcp_stream> ctx{server};
+	asio::co_spawn(
+		io,
+		[&]() -> awaitable<void> {
+			co_await ctx.read_header();
+			spooled = co_await ctx.spool_body(options);
+			resumed_on = std::this_thread::get_id();
+		},
+		[&](std::exception_ptr error) { failure = error; });
+
+	io.run();
+	sender.join();
+	if (failure)
+		std::rethrow_exception(failure);
+
+	// The connection's coroutine goes on where it was
+	BOOST_TEST((resumed_on == std::this_thread::get_id()));
+	return spooled;
+}
+
+std::string random_bytes(std::size_t size) {
+	std::mt19937 generator;
+	std::string bytes(size, '\0');
+	for (char &c : bytes)
+		c = static_cast<char>(generator());
+
+	return bytes;
+}
+
+std::string file_content(const spooled_body &body) {
+	std::string content(body.size, '\0');
+	beast::error_code ec;
+	std::size_t read = 0;
+	while ((read < content.size()) && !ec)
+		read += body.file->read(content.data() + read, content.size() - read,
+								ec);
+
+	BOOST_TEST(!ec);
+	return content;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(http_tests)
+
+BOOST_AUTO_TEST_CASE(spool_in_memory) {
+	const std::string body = random_bytes(1000);
+	spooled_body spooled = spool(body, spool_options{});
+	BOOST_TEST(!spooled.on_disk());
+	BOOST_TEST(spooled.size == body.size());
+	BOOST_TEST((spooled.memory == body));
+}
+
+BOOST_AUTO_TEST_CASE(spool_to_file) {
+	const std::string body = random_bytes(300 * 1024);
+	spool_options options;
+	options.memory_limit = 1024;
+	spooled_body spooled = spool(body, options);
+	BOOST_TEST(spooled.on_disk());
+	BOOST_TEST(spooled.memory.empty());
+	BOOST_TEST(spooled.size == body.size());
+	BOOST_TEST((file_content(spooled) == body));
+}
+
+BOOST_AUTO_TEST_CASE(spool_to_file_on_executor) {
+	asio::thread_pool pool{1};
+	const std::string body = random_bytes(300 * 1024);
+	spool_options options;
+	options.memory_limit = 1024;
+	options.file_executor = pool.get_executor();
+	spooled_body spooled = spool(body, options);
+	BOOST_TEST(spooled.on_disk());
+	BOOST_TEST(spooled.size == body.size());
+	BOOST_TEST((file_content(spooled) == body));
+}
+
+BOOST_AUTO_TEST_CASE(spool_directory_missing) {
+	spool_options options;
+	options.memory_limit = 0;
+	options.directory = "/nonexistent/webdonkey";
+	BOOST_CHECK_THROW(spool("body", options), boost::system::system_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
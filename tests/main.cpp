@@ -0,0 +1,13 @@
+/*
+ * main.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ *
+ * Unit tests of the library. Every other file of this directory holds one
+ * test suite, <header>_tests for the header it checks; run a single suite
+ * with webdonkey_tests --run_test=<header>_tests.
+ */
+
+#define BOOST_TEST_MODULE webdonkey
+#include <boost/test/included/unit_test.hpp>
@@ -0,0 +1,170 @@
+/*
+ * router_test.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <webdonkey/router.hpp>
+
+using namespace webdonkey;
+
+namespace {
+
+/**
+ * Routes requests to responders recording which of them answered, with the
+ * rest of the target and the captured parameters.
+ */
+struct router_fixture {
+	asio::io_context io;
+	tcp_stream stream{io};
+	request_context<tcp_stream> ctx{stream};
+	router<tcp_stream> routes;
+	std::string answered;
+
+	auto responder(std::string name) {
+		return [this, name](request_context<tcp_stream> &ctx,
+							std::string_view rest) -> expected_response {
+			answered = name + "|" + std::string{rest};
+			for (std::string_view param : {"id", "name", "rest"})
+				if (!ctx.params().get(param).empty())
+					answered += "|" + std::string{param} + "=" +
+								std::string{ctx.params().get(param)};
+
+			return http_response{};
+		};
+	}
+
+	auto declining(beast::http::status status) {
+		return [status](request_context<tcp_stream> &,
+						std::string_view) -> expected_response {
+			return std::unexpected{protocol_error{status, ""}};
+		};
+	}
+
+	std::string route(std::string_view target) {
+		answered.clear();
+		ctx.reset();
+		expected_response response = routes(ctx, target);
+		if (!response.has_value())
+			return std::to_string(static_cast<int>(response.error().status));
+
+		return answered;
+	}
+};
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(router_tests, router_fixture)
+
+BOOST_AUTO_TEST_CASE(exact_routes) {
+	routes.add("/", responder("root"))
+		.add("/users", responder("users"))
+		.add("/user", responder("user"));
+
+	BOOST_TEST(route("/") == "root|");
+	BOOST_TEST(route("/users") == "users|");
+	BOOST_TEST(route("/user") == "user|");
+	BOOST_TEST(route("/users?page=2") == "users|?page=2");
+	BOOST_TEST(route("/use") == "404");
+	BOOST_TEST(route("/users/") == "404");
+	BOOST_TEST(route("") == "404");
+}
+
+BOOST_AUTO_TEST_CASE(prefix_routes) {
+	routes.add("/static/*", responder("static"))
+		.add("/static/app.js", responder("app"))
+		.add("*", responder("fallback"));
+
+	BOOST_TEST(route("/static/css/site.css") == "static|css/site.css");
+	BOOST_TEST(route("/static/") == "static|");
+	BOOST_TEST(route("/static/app.js") == "app|");
+
+	// Prefixes see the query as part of the rest
+	BOOST_TEST(route("/static/app.js.map?v=1") == "static|app.js.map?v=1");
+	BOOST_TEST(route("/static") == "fallback|/static");
+	BOOST_TEST(route("/") == "fallback|/");
+}
+
+BOOST_AUTO_TEST_CASE(captures) {
+	routes.add("/users/{id}", responder("user"))
+		.add("/users/{id}/files/*", responder("files"))
+		.add("/users/me", responder("me"));
+
+	BOOST_TEST(route("/users/42") == "user||id=42");
+	BOOST_TEST(route("/users/42?x") == "user|?x|id=42");
+	BOOST_TEST(route("/users/42/files/a/b") == "files|a/b|id=42");
+
+	// Literal edges win over captures
+	BOOST_TEST(route("/users/me") == "me|");
+	BOOST_TEST(route("/users/men") == "user||id=men");
+
+	// Captures are non-empty and stop at '/'
+	BOOST_TEST(route("/users/") == "404");
+	BOOST_TEST(route("/users/42/") == "404");
+}
+
+BOOST_AUTO_TEST_CASE(backtracking) {
+	routes.add("/users/me/{name}", responder("mine"))
+		.add("/users/{id}/avatar", responder("avatar"))
+		.add("/users/*", responder("users"));
+
+	BOOST_TEST(route("/users/me/x") == "mine||name=x");
+
+	// The literal "me" leads to a dead end; the capture is tried next
+	BOOST_TEST(route("/users/me/avatar") == "mine||name=avatar");
+	BOOST_TEST(route("/users/7/avatar") == "avatar||id=7");
+	BOOST_TEST(route("/users/7/banner") == "users|7/banner");
+}
+
+BOOST_AUTO_TEST_CASE(recoverable_errors) {
+	routes.add("/a", declining(beast::http::status::not_found))
+		.add("*", responder("fallback"));
+	BOOST_TEST(route("/a") == "fallback|/a");
+
+	router<tcp_stream> failing;
+	failing.add("/a", declining(beast::http::status::method_not_allowed));
+	routes = failing;
+	BOOST_TEST(route("/a") == "405");
+	BOOST_TEST(route("/b") == "404");
+}
+
+BOOST_AUTO_TEST_CASE(unrecoverable_errors) {
+	routes
+		.add("/a",
+			 [](request_context<tcp_stream> &,
+				std::string_view) -> expected_response {
+				 return std::unexpected{protocol_error{
+					 beast::http::status::forbidden, "", false}};
+			 })
+		.add("*", responder("fallback"));
+	BOOST_TEST(route("/a") == "403");
+}
+
+BOOST_AUTO_TEST_CASE(conflicts) {
+	routes.add("/users/{id}", responder("user"))
+		.add("/static/*", responder("static"));
+
+	BOOST_CHECK_THROW(routes.add("/users/{id}", responder("again")),
+					  route_conflict);
+	BOOST_CHECK_THROW(routes.add("/users/{name}/x", responder("renamed")),
+					  route_conflict);
+	BOOST_CHECK_THROW(routes.add("/static/*", responder("again")),
+					  route_conflict);
+
+	// Exact and prefix routes of the same path coexist
+	routes.add("/static/", responder("index"));
+	BOOST_TEST(route("/static/") == "index|");
+	BOOST_TEST(route("/users/1") == "user||id=1");
+}
+
+BOOST_AUTO_TEST_CASE(malformed_patterns) {
+	for (std::string_view pattern :
+		 {"/users/{id", "/users/{", "/users/{}", "/a/{b{c}", "/a/{b/c}"})
+		BOOST_CHECK_THROW(routes.add(pattern, responder("bad")),
+						  route_parse_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
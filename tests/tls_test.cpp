@@ -0,0 +1,241 @@
+/*
+ * tls_test.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Sergii Kutnii
+ *
+ * Kernel TLS offload needs the Linux tls module, so it is not run here.
+ * What it relies on is checked against OpenSSL instead: the write keys
+ * derived by derive_key_block() must decrypt the records OpenSSL sends.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <openssl/x509.h>
+#include <string>
+#include <vector>
+#include <webdonkey/tls.hpp>
+
+using namespace webdonkey;
+
+namespace {
+
+void use_generated_certificate(ssl::context &ctx) {
+	EVP_PKEY *key = EVP_EC_gen("P-256");
+	X509 *cert = X509_new();
+	BOOST_TEST_REQUIRE(key != nullptr);
+	BOOST_TEST_REQUIRE(cert != nullptr);
+
+	X509_set_version(cert, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+	X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+	X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 60 * 60);
+	X509_set_pubkey(cert, key);
+	X509_sign(cert, key, EVP_sha256());
+
+	BOOST_TEST(SSL_CTX_use_certificate(ctx.native_handle(), cert) == 1);
+	BOOST_TEST(SSL_CTX_use_PrivateKey(ctx.native_handle(), key) == 1);
+	X509_free(cert);
+	EVP_PKEY_free(key);
+}
+
+// Moves whatever from has written to the input of to
+void transfer(SSL *from, SSL *to) {
+	char chunk[4096];
+	int n = 0;
+	while ((n = BIO_read(SSL_get_wbio(from), chunk, sizeof(chunk))) > 0)
+		BIO_write(SSL_get_rbio(to), chunk, n);
+}
+
+std::string take_output(SSL *ssl) {
+	std::string output;
+	char chunk[4096];
+	int n = 0;
+	while ((n = BIO_read(SSL_get_wbio(ssl), chunk, sizeof(chunk))) > 0)
+		output.append(chunk, n);
+
+	return output;
+}
+
+/**
+ * A TLS 1.2 connection in memory, between SSL engines whose records are
+ * passed on by hand.
+ */
+struct connection {
+	SSL *server;
+	SSL *client;
+
+	connection(ssl::context &server_ctx, ssl::context &client_ctx,
+			   SSL_SESSION *resumed = nullptr) :
+		server{SSL_new(server_ctx.native_handle())},
+		client{SSL_new(client_ctx.native_handle())} {
+		SSL_set_bio(server, BIO_new(BIO_s_mem()), BIO_new(BIO_s_mem()));
+		SSL_set_bio(client, BIO_new(BIO_s_mem()), BIO_new(BIO_s_mem()));
+		SSL_set_accept_state(server);
+		SSL_set_connect_state(client);
+		if (resumed != nullptr)
+			SSL_set_session(client, resumed);
+
+		bool server_done = false;
+		bool client_done = false;
+		for (int round = 0; (round < 10) && !(server_done && client_done);
+			 ++round) {
+			client_done = SSL_do_handshake(client) == 1;
+			transfer(client, server);
+			server_done = SSL_do_handshake(server) == 1;
+			transfer(server, client);
+		}
+
+		BOOST_TEST_REQUIRE(server_done);
+		BOOST_TEST_REQUIRE(client_done);
+	}
+
+	connection(const connection &) = delete;
+	connection &operator=(const connection &) = delete;
+
+	// Sessions of connections not shut down cannot be resumed
+	~connection() {
+		SSL_shutdown(client);
+		SSL_shutdown(server);
+		SSL_free(server);
+		SSL_free(client);
+	}
+};
+
+/*
+ * Decrypts an AES-GCM application data record with the server write key
+ * and IV from the derived key block, as the kernel would encrypt it.
+ */
+std::optional<std::string> decrypt(SSL *ssl, const std::string &record,
+								   std::uint64_t sequence) {
+	const SSL_CIPHER *cipher = SSL_get_current_cipher(ssl);
+	const EVP_CIPHER *aead =
+		EVP_get_cipherbynid(SSL_CIPHER_get_cipher_nid(cipher));
+	const std::size_t key_size = EVP_CIPHER_key_length(aead);
+	static constexpr std::size_t salt_size = 4;
+	static constexpr std::size_t nonce_size = 8;
+	static constexpr std::size_t tag_size = 16;
+
+	// AEAD ciphers have no MAC keys
+	std::vector<unsigned char> block(2 * key_size + 2 * salt_size);
+	BOOST_TEST_REQUIRE(tls_internals::derive_key_block(
+		ssl, SSL_CIPHER_get_handshake_digest(cipher), block.data(),
+		block.size()));
+	const unsigned char *key = block.data() + key_size;
+	const unsigned char *salt = block.data() + 2 * key_size + salt_size;
+
+	// Header, explicit nonce, ciphertext, tag
+	auto bytes = reinterpret_cast<const unsigned char *>(record.data());
+	BOOST_TEST_REQUIRE(record.size() > 5 + nonce_size + tag_size);
+	BOOST_TEST(bytes[0] == 23);
+	const std::size_t length = (std::size_t{bytes[3]} << 8) | bytes[4];
+	BOOST_TEST_REQUIRE(record.size() == 5 + length);
+	const std::size_t text_size = length - nonce_size - tag_size;
+
+	unsigned char iv[salt_size + nonce_size];
+	std::memcpy(iv, salt, salt_size);
+	std::memcpy(iv + salt_size, bytes + 5, nonce_size);
+
+	// Sequence number, type, version and length of the plain text
+	unsigned char aad[13];
+	for (int i = 7; i >= 0; --i) {
+		aad[i] = static_cast<unsigned char>(sequence & 0xff);
+		sequence >>= 8;
+	}
+	std::memcpy(aad + 8, bytes, 3);
+	aad[11] = static_cast<unsigned char>(text_size >> 8);
+	aad[12] = static_cast<unsigned char>(text_size);
+
+	std::string text(text_size, '\0');
+	auto out = reinterpret_cast<unsigned char *>(text.data());
+	int n = 0;
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	const bool decrypted =
+		(EVP_DecryptInit_ex(ctx, aead, nullptr, nullptr, nullptr) == 1) &&
+		(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, sizeof(iv),
+							 nullptr) == 1) &&
+		(EVP_DecryptInit_ex(ctx, nullptr, nullptr, key, iv) == 1) &&
+		(EVP_DecryptUpdate(ctx, nullptr, &n, aad, sizeof(aad)) == 1) &&
+		(EVP_DecryptUpdate(ctx, out, &n, bytes + 5 + nonce_size,
+						   static_cast<int>(text_size)) == 1) &&
+		(EVP_CIPHER_CTX_ctrl(
+			 ctx, EVP_CTRL_GCM_SET_TAG, tag_size,
+			 const_cast<unsigned char *>(bytes + 5 + length - tag_size)) ==
+		 1) &&
+		(EVP_DecryptFinal_ex(ctx, out + n, &n) == 1);
+	EVP_CIPHER_CTX_free(ctx);
+
+	if (!decrypted)
+		return std::nullopt;
+
+	return text;
+}
+
+struct tls_fixture {
+	ssl::context server_ctx{ssl::context::tls_server};
+	ssl::context client_ctx{ssl::context::tls_client};
+
+	tls_fixture() {
+		use_generated_certificate(server_ctx);
+		enable_session_resumption(server_ctx);
+		client_ctx.set_verify_mode(ssl::verify_none);
+		client_ctx.set_options(ssl::context::no_tlsv1_3);
+	}
+
+	void check_key_block(const char *ciphers) {
+		SSL_CTX_set_cipher_list(client_ctx.native_handle(), ciphers);
+		SSL_SESSION *session = nullptr;
+		for (bool resumed : {false, true}) {
+			connection tls{server_ctx, client_ctx, session};
+			BOOST_TEST(SSL_session_reused(tls.server) == (resumed ? 1 : 0));
+			BOOST_TEST(SSL_version(tls.server) == TLS1_2_VERSION);
+
+			// The server's Finished was record 0 under the write keys
+			static constexpr std::string_view message = "Sent by OpenSSL";
+			BOOST_TEST(SSL_write(tls.server, message.data(),
+								 static_cast<int>(message.size())) ==
+					   static_cast<int>(message.size()));
+			const std::string record = take_output(tls.server);
+			BOOST_TEST(decrypt(tls.server, record, 1).value_or("") == message);
+
+			// A wrong sequence number fails authentication
+			BOOST_TEST(!decrypt(tls.server, record, 2).has_value());
+
+			// Both ends derive the same block
+			std::vector<unsigned char> server_block(72), client_block(72);
+			const EVP_MD *digest = SSL_CIPHER_get_handshake_digest(
+				SSL_get_current_cipher(tls.server));
+			BOOST_TEST(tls_internals::derive_key_block(
+				tls.server, digest, server_block.data(), server_block.size()));
+			BOOST_TEST(tls_internals::derive_key_block(
+				tls.client, digest, client_block.data(), client_block.size()));
+			BOOST_TEST(server_block == client_block);
+
+			SSL_SESSION_free(session);
+			session = SSL_get1_session(tls.client);
+		}
+
+		SSL_SESSION_free(session);
+	}
+};
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(tls_tests, tls_fixture)
+
+BOOST_AUTO_TEST_CASE(key_block_aes_128_gcm) {
+	check_key_block("ECDHE-ECDSA-AES128-GCM-SHA256");
+}
+
+BOOST_AUTO_TEST_CASE(key_block_aes_256_gcm) {
+	check_key_block("ECDHE-ECDSA-AES256-GCM-SHA384");
+}
+
+BOOST_AUTO_TEST_CASE(offload_is_opt_in) {
+#if defined(WEBDONKEY_KERNEL_TLS)
+	BOOST_TEST(kernel_tls_built);
+#else
+	BOOST_TEST(!kernel_tls_built);
+#endif
+}
+
+BOOST_AUTO_TEST_SUITE_END()